@@ -96,11 +96,13 @@ CClassifierCascade::CClassifierCascade()
   m_trainset_exhausted(false),
   m_template_width(-1),
   m_template_height(-1),
-  m_image_area_ratio(-1)
+  m_image_area_ratio(-1),
+  m_keep_statistics(false)
 {
   m_classifiers.reserve(20);
   m_lyr_false_positive_rates.reserve(20);
   m_lyr_detection_rates.reserve(20);
+  ResetStatistics();
 }
 
 CClassifierCascade::CClassifierCascade(const CClassifierCascade& frm)
@@ -116,13 +118,17 @@ CClassifierCascade::CClassifierCascade(const CClassifierCascade& frm)
   m_classifiers(frm.m_classifiers),
   m_branch_classifiers(frm.m_branch_classifiers),
   m_branch_names(frm.m_branch_names),
+  m_tree_nodes(frm.m_tree_nodes),
+  m_tree_branch_hits(frm.m_tree_branch_hits),
   m_lyr_false_positive_rates(frm.m_lyr_false_positive_rates),
   m_lyr_detection_rates(frm.m_lyr_detection_rates),
   m_branch_lyr_false_positive_rates(frm.m_branch_lyr_false_positive_rates),
   m_branch_lyr_detection_rates(frm.m_branch_lyr_detection_rates),
   m_branch_false_positive_rates(frm.m_branch_false_positive_rates),
-  m_branch_detection_rates(frm.m_branch_detection_rates)
+  m_branch_detection_rates(frm.m_branch_detection_rates),
+  m_keep_statistics(frm.m_keep_statistics)
 {
+  ResetStatistics();
 }
 
 CClassifierCascade::CClassifierCascade(int template_width, int template_height, double image_area_ratio)
@@ -134,11 +140,13 @@ CClassifierCascade::CClassifierCascade(int template_width, int template_height,
   m_trainset_exhausted(false),
   m_template_width(template_width),
   m_template_height(template_height),
-  m_image_area_ratio(image_area_ratio)
+  m_image_area_ratio(image_area_ratio),
+  m_keep_statistics(false)
 {
   m_classifiers.reserve(20);
   m_lyr_false_positive_rates.reserve(20);
   m_lyr_detection_rates.reserve(20);
+  ResetStatistics();
 }
 
 CClassifierCascade::~CClassifierCascade()
@@ -158,12 +166,16 @@ CClassifierCascade& CClassifierCascade::operator=(const CClassifierCascade& frm)
   m_classifiers = frm.m_classifiers;
   m_branch_classifiers = frm.m_branch_classifiers;
   m_branch_names = frm.m_branch_names;
+  m_tree_nodes = frm.m_tree_nodes;
+  m_tree_branch_hits = frm.m_tree_branch_hits;
   m_lyr_false_positive_rates = frm.m_lyr_false_positive_rates;
   m_lyr_detection_rates = frm.m_lyr_detection_rates;
   m_branch_lyr_false_positive_rates = frm.m_branch_lyr_false_positive_rates;
   m_branch_lyr_detection_rates = frm.m_branch_lyr_detection_rates;
   m_branch_false_positive_rates = frm.m_branch_false_positive_rates;
   m_branch_detection_rates = frm.m_branch_detection_rates;
+  m_keep_statistics = frm.m_keep_statistics;
+  ResetStatistics();
 
   return *this;
 }
@@ -180,6 +192,7 @@ CStrongClassifier& CClassifierCascade::AddStrongClassifier()
   m_classifiers[num_clsfs-1] = CStrongClassifier(); // make sure it's an empty strong classifier
   m_lyr_false_positive_rates[num_clsfs-1] = 1.0;
   m_lyr_detection_rates[num_clsfs-1] = 1.0;
+  ResetStatistics();
   return m_classifiers[num_clsfs-1];
 }
 
@@ -200,6 +213,7 @@ CStrongClassifier& CClassifierCascade::AddStrongClassifier(int branch, double fp
     m_classifiers[num_clsfs-1] = CStrongClassifier(); // make sure it's an empty strong classifier
     m_lyr_false_positive_rates[num_clsfs-1] = fpr;
     m_lyr_detection_rates[num_clsfs-1] = dr;
+    ResetStatistics();
     return m_classifiers[num_clsfs-1];
 
   } else if (m_structure_type==CASCADE_TYPE_FAN) {
@@ -216,6 +230,7 @@ CStrongClassifier& CClassifierCascade::AddStrongClassifier(int branch, double fp
     m_branch_classifiers[branch][num_clsfs-1] = CStrongClassifier(); // make sure it's an empty strong classifier
     m_branch_lyr_false_positive_rates[branch][num_clsfs-1] = fpr;
     m_branch_lyr_detection_rates[branch][num_clsfs-1] = dr;
+    ResetStatistics();
     return m_branch_classifiers[branch][num_clsfs-1];
 
   } else {
@@ -230,6 +245,7 @@ int CClassifierCascade::RemoveLastStrongClassifier()
   ASSERT(m_structure_type==CASCADE_TYPE_SEQUENTIAL);
   ASSERT((int)m_classifiers.size());
   m_classifiers.pop_back();
+  ResetStatistics();
   return (int)m_classifiers.size();
 }
 
@@ -307,9 +323,8 @@ ostream& CClassifierCascade::output(ostream& os) const {
   } else if (m_structure_type==CClassifierCascade::CASCADE_TYPE_FAN) {
     os << "fan, ";
   } else if (m_structure_type==CClassifierCascade::CASCADE_TYPE_TREE) {
-    os << "tree, ";
-    ASSERT(0);
-    throw ITException("not implemented yet");
+    // the tree is not stored, it can be recreated with ConvertFanToTree
+    os << "fan, ";
   } else {
     ASSERT(0);
   }
@@ -319,7 +334,8 @@ ostream& CClassifierCascade::output(ostream& os) const {
      << ", dr:" << m_last_detection_rate
      << ", " << (m_trainset_exhausted?"exhausted":"successful")
      << ")" << endl;
-  if (m_structure_type==CClassifierCascade::CASCADE_TYPE_FAN) {
+  if (m_structure_type==CClassifierCascade::CASCADE_TYPE_FAN
+      || m_structure_type==CClassifierCascade::CASCADE_TYPE_TREE) {
     os << (int) m_branch_classifiers.size() << " branches." << endl;
     os << "COMMON BRANCH" << endl;
   }
@@ -380,7 +396,18 @@ bool CClassifierCascade::Evaluate(const CIntegralImage& image,
     return matches.size()>0;
 
   } else if (m_structure_type==CASCADE_TYPE_TREE) {
-    throw ITException("not implemented yet");
+    ASSERT(matches.size()==0);
+    int num_branches = (int) m_branch_classifiers.size();
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      m_tree_branch_hits[brcnt] = 0;
+    }
+    EvaluateTreeNode(0, image);
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      if (m_tree_branch_hits[brcnt]) {
+        matches.push_back(m_branch_names[brcnt]);
+      }
+    }
+    return matches.size()>0;
 
   } else {
     ASSERT(0);
@@ -423,7 +450,18 @@ bool CClassifierCascade::EvaluateDebug(const CIntegralImage& image,
     return matches.size()>0;
 
   } else if (m_structure_type==CASCADE_TYPE_TREE) {
-    throw ITException("not implemented yet");
+    ASSERT(matches.size()==0);
+    int num_branches = (int) m_branch_classifiers.size();
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      m_tree_branch_hits[brcnt] = 0;
+    }
+    EvaluateTreeNode(0, image);
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      if (m_tree_branch_hits[brcnt]) {
+        matches.push_back(m_branch_names[brcnt]);
+      }
+    }
+    return matches.size()>0;
 
   } else {
     ASSERT(0);
@@ -437,36 +475,117 @@ bool CClassifierCascade::Evaluate(
   double mean, double stddev, int left, int top,
   CStringVector& matches) const
 {
-  for (CSClsfVector::const_iterator it=m_classifiers.begin();
-       it!=m_classifiers.end();
-       it++) {
-    bool is_pos = it->Evaluate(image, mean, stddev, left, top);
+  CIntVector match_ids;
+  bool is_pos = Evaluate(image, mean, stddev, left, top, match_ids);
+  for (int mcnt=0; mcnt<(int)match_ids.size(); mcnt++) {
+    matches.push_back(GetMatchName(match_ids[mcnt]));
+  }
+  return is_pos;
+}
+
+/* "matches" receives the branch numbers of all matching branches,
+* or 0 for a sequential cascade; GetMatchName turns them into names
+*/
+bool CClassifierCascade::Evaluate(
+  const CIntegralImage& image,
+  double mean, double stddev, int left, int top,
+  CIntVector& matches) const
+{
+  bool keep_statistics = m_keep_statistics;
+  if (keep_statistics) {
+    m_num_evaluated++;
+    if (m_num_evaluated>=CASCADE_MAX_STATISTICS) {
+      HalveStatistics();
+    }
+  }
+  int num_common = (int) m_classifiers.size();
+  for (int stcnt=0; stcnt<num_common; stcnt++) {
+    if (keep_statistics) m_stage_evals[stcnt]++;
+    bool is_pos = 
+      m_classifiers[stcnt].Evaluate(image, mean, stddev, left, top);
     if (!is_pos) return false;
   }
 
   // what structure?
   if (m_structure_type==CASCADE_TYPE_SEQUENTIAL) {
-    matches.push_back(m_name);
+    matches.push_back(0);
     return true;
 
   } else if (m_structure_type==CASCADE_TYPE_FAN) {
+    ASSERT(matches.size()==0);
+    EvaluateFan(image, mean, stddev, left, top, matches);
+    return matches.size()>0;
+
+  } else if (m_structure_type==CASCADE_TYPE_TREE) {
     ASSERT(matches.size()==0);
     int num_branches = (int) m_branch_classifiers.size();
     for (int brcnt=0; brcnt<num_branches; brcnt++) {
-      bool is_pos = true;
-      for (CSClsfVector::const_iterator it=m_branch_classifiers[brcnt].begin();
-           it!=m_branch_classifiers[brcnt].end(); it++) {
-        is_pos = it->Evaluate(image, mean, stddev, left, top);
-        if (!is_pos) break;
-      }
-      if (is_pos) {
-        matches.push_back(m_branch_names[brcnt]);
+      m_tree_branch_hits[brcnt] = 0;
+    }
+    EvaluateTreeNode(0, image, mean, stddev, left, top);
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      if (m_tree_branch_hits[brcnt]) {
+        matches.push_back(brcnt);
       }
     }
     return matches.size()>0;
 
-  } else if (m_structure_type==CASCADE_TYPE_TREE) {
-    throw ITException("not implemented yet");
+  } else {
+    ASSERT(0);
+    return 0;
+  }
+}
+
+/* like Evaluate, but also returns how far the window got through the
+* cascade: the fraction of strong classifiers it passed on the branch
+* on which it got furthest.  That is 1.0 if and only if there are
+* matches.  Fan and tree cascades are evaluated one branch after the
+* other, so this is meant for a few candidate windows, not for scanning.
+*/
+double CClassifierCascade::EvaluateConfidence(
+  const CIntegralImage& image,
+  double mean, double stddev, int left, int top,
+  CIntVector& matches) const
+{
+  int num_common = (int) m_classifiers.size();
+  int num_passed = 0;
+  for (; num_passed<num_common; num_passed++) {
+    if (!m_classifiers[num_passed].Evaluate(image, mean, stddev, left, top)) {
+      break;
+    }
+  }
+
+  if (m_structure_type==CASCADE_TYPE_SEQUENTIAL) {
+    if (num_passed<num_common) {
+      return (double) num_passed/(double) num_common;
+    }
+    matches.push_back(0);
+    return 1.0;
+
+  } else if (m_structure_type==CASCADE_TYPE_FAN
+             || m_structure_type==CASCADE_TYPE_TREE) {
+    // the tree only refers to the branch classifiers, so both
+    // types can be evaluated along the branches
+    double confidence = 0.0;
+    int num_branches = (int) m_branch_classifiers.size();
+    for (int brcnt=0; brcnt<num_branches; brcnt++) {
+      const CSClsfVector& stages = m_branch_classifiers[brcnt];
+      int num_stages = (int) stages.size();
+      int stcnt = 0;
+      if (num_passed==num_common) {
+        while (stcnt<num_stages
+               && stages[stcnt].Evaluate(image, mean, stddev, left, top)) {
+          stcnt++;
+        }
+        if (stcnt==num_stages) {
+          matches.push_back(brcnt);
+        }
+      }
+      double branch_confidence = 
+        (double) (num_passed+stcnt)/(double) (num_common+num_stages);
+      confidence = max(confidence, branch_confidence);
+    }
+    return confidence;
 
   } else {
     ASSERT(0);
@@ -474,6 +593,53 @@ bool CClassifierCascade::Evaluate(
   }
 }
 
+// fan branches are evaluated in groups of this size, with one bit
+// per branch that is still alive
+#define FAN_BRANCH_GROUP_SIZE 32
+
+/* rather than walking down one branch after the other, evaluate
+* the first strong classifier of all branches, then the second one
+* of those branches that are still alive, and so on.  Branches that
+* pass all their strong classifiers are reported in branch order.
+*/
+void CClassifierCascade::EvaluateFan(
+  const CIntegralImage& image,
+  double mean, double stddev, int left, int top,
+  CIntVector& matches) const
+{
+  int num_branches = (int) m_branch_classifiers.size();
+  for (int first=0; first<num_branches; first+=FAN_BRANCH_GROUP_SIZE) {
+    int num_group = min(FAN_BRANCH_GROUP_SIZE, num_branches-first);
+    unsigned int alive = 
+      num_group==FAN_BRANCH_GROUP_SIZE ? ~0u : (1u<<num_group)-1;
+    unsigned int passed = 0;
+
+    for (int stcnt=0; alive; stcnt++) {
+      for (int bit=0; bit<num_group; bit++) {
+        unsigned int mask = 1u<<bit;
+        if (!(alive & mask)) continue;
+        const CSClsfVector& stages = m_branch_classifiers[first+bit];
+        if (stcnt==(int)stages.size()) {
+          passed |= mask;
+          alive &= ~mask;
+        } else {
+          if (m_keep_statistics) m_branch_stage_evals[first+bit][stcnt]++;
+          if (!stages[stcnt].Evaluate(image, mean, stddev, left, top)) {
+            alive &= ~mask;
+          }
+        }
+      }
+    }
+
+    for (int bit=0; passed; bit++) {
+      if (passed & (1u<<bit)) {
+        matches.push_back(first+bit);
+        passed &= ~(1u<<bit);
+      }
+    }
+  }
+}
+
 void CClassifierCascade::ScaleFeaturesEvenly(double scale_x, double scale_y,
         int scaled_template_width, int scaled_template_height) const
 {
@@ -483,7 +649,8 @@ void CClassifierCascade::ScaleFeaturesEvenly(double scale_x, double scale_y,
     it->ScaleFeaturesEvenly(scale_x, scale_y,
                             scaled_template_width, scaled_template_height);
   }
-  if (m_structure_type==CASCADE_TYPE_FAN) {
+  if (m_structure_type==CASCADE_TYPE_FAN
+      || m_structure_type==CASCADE_TYPE_TREE) {
     for (int brcnt=0; brcnt<(int)m_branch_classifiers.size(); brcnt++) {
       CSClsfVector& mutable_classifers = 
         (CSClsfVector&) m_branch_classifiers[brcnt];
@@ -498,6 +665,236 @@ void CClassifierCascade::ScaleFeaturesEvenly(double scale_x, double scale_y,
   }
 }
 
+/* reflects all features horizontally within the template, so that
+* the cascade finds the mirror images of the objects that it was
+* trained on, for example left hands instead of right hands.  The
+* structure of the cascade and its statistics stay the same.
+*/
+void CClassifierCascade::Mirror()
+{
+  for (CSClsfVector::iterator it=m_classifiers.begin(); 
+       it!=m_classifiers.end(); it++) {
+    it->Mirror();
+  }
+  for (int brcnt=0; brcnt<(int)m_branch_classifiers.size(); brcnt++) {
+    CSClsfVector& classifiers = m_branch_classifiers[brcnt];
+    for (CSClsfVector::iterator it=classifiers.begin(); 
+         it!=classifiers.end(); it++) {
+      it->Mirror();
+    }
+  }
+}
+
+/* the expected cost of evaluating one window, in units of
+* CStrongClassifier::GetComputeCost: the cost of each strong classifier
+* weighted by how often windows get to it.  That is measured by
+* Evaluate once it saw enough windows, otherwise the false positive
+* rates from training are used.  *pMeasured tells which one it was.
+*/
+double CClassifierCascade::GetExpectedCost(bool* pMeasured/*=NULL*/) const
+{
+  bool measured = m_num_evaluated>=CASCADE_MIN_STATISTICS;
+  if (pMeasured) *pMeasured = measured;
+
+  double cost = 0;
+  int num_common = (int) m_classifiers.size();
+  if (measured) {
+    for (int stcnt=0; stcnt<num_common; stcnt++) {
+      cost += m_stage_evals[stcnt]*m_classifiers[stcnt].GetComputeCost();
+    }
+    for (int brcnt=0; brcnt<(int)m_branch_classifiers.size(); brcnt++) {
+      const CSClsfVector& stages = m_branch_classifiers[brcnt];
+      for (int stcnt=0; stcnt<(int)stages.size(); stcnt++) {
+        cost += m_branch_stage_evals[brcnt][stcnt]*stages[stcnt].GetComputeCost();
+      }
+    }
+    return cost/m_num_evaluated;
+  }
+
+  // a window gets to a strong classifier with the product of the
+  // false positive rates of the ones before it
+  double reach = 1.0;
+  for (int stcnt=0; stcnt<num_common; stcnt++) {
+    cost += reach*m_classifiers[stcnt].GetComputeCost();
+    reach *= m_lyr_false_positive_rates[stcnt];
+  }
+  if (m_structure_type==CASCADE_TYPE_FAN) {
+    for (int brcnt=0; brcnt<(int)m_branch_classifiers.size(); brcnt++) {
+      const CSClsfVector& stages = m_branch_classifiers[brcnt];
+      double branch_reach = reach;
+      for (int stcnt=0; stcnt<(int)stages.size(); stcnt++) {
+        cost += branch_reach*stages[stcnt].GetComputeCost();
+        branch_reach *= m_branch_lyr_false_positive_rates[brcnt][stcnt];
+      }
+    }
+  } else if (m_structure_type==CASCADE_TYPE_TREE) {
+    // shared strong classifiers are evaluated once, the node's
+    // branch has the same ones before it
+    for (int node=1; node<(int)m_tree_nodes.size(); node++) {
+      const CCascadeTreeNode& tn = m_tree_nodes[node];
+      double node_reach = reach;
+      for (int stcnt=0; stcnt<tn.stage; stcnt++) {
+        node_reach *= m_branch_lyr_false_positive_rates[tn.branch][stcnt];
+      }
+      cost += node_reach*m_branch_classifiers[tn.branch][tn.stage].GetComputeCost();
+    }
+  }
+  return cost;
+}
+
+/* how many of the GetNumEvaluated windows Evaluate passed to the
+* strong classifier; branch -1 for the common ones.  A tree counts
+* shared strong classifiers in the first branch that has them.
+*/
+double CClassifierCascade::GetNumStageEvaluated(int branch, int stage) const
+{
+  if (branch==-1) {
+    ASSERT(stage<(int)m_stage_evals.size());
+    return m_stage_evals[stage];
+  }
+  ASSERT(branch<(int)m_branch_stage_evals.size());
+  ASSERT(stage<(int)m_branch_stage_evals[branch].size());
+  return m_branch_stage_evals[branch][stage];
+}
+
+/* whether Evaluate counts the windows that reach each strong
+* classifier, for GetExpectedCost and GetNumStageEvaluated.  Off by
+* default: the counters are written for every window, and cascades
+* that are scanned by several threads at once must not keep them.
+* Turning it off forgets the statistics.
+*/
+void CClassifierCascade::SetKeepStatistics(bool keep/*=true*/)
+{
+  m_keep_statistics = keep;
+  if (!keep) {
+    ResetStatistics();
+  }
+}
+
+/* forget the evaluation statistics, and size them for the current
+* structure; needs to be called whenever strong classifiers are
+* added or removed
+*/
+void CClassifierCascade::ResetStatistics() const
+{
+  m_num_evaluated = 0;
+  m_stage_evals.assign(m_classifiers.size(), 0.0);
+  int num_branches = (int) m_branch_classifiers.size();
+  m_branch_stage_evals.resize(num_branches);
+  for (int brcnt=0; brcnt<num_branches; brcnt++) {
+    m_branch_stage_evals[brcnt].assign(m_branch_classifiers[brcnt].size(),
+                                       0.0);
+  }
+}
+
+void CClassifierCascade::HalveStatistics() const
+{
+  m_num_evaluated /= 2.0;
+  for (int stcnt=0; stcnt<(int)m_stage_evals.size(); stcnt++) {
+    m_stage_evals[stcnt] /= 2.0;
+  }
+  for (int brcnt=0; brcnt<(int)m_branch_stage_evals.size(); brcnt++) {
+    CDoubleVector& evals = m_branch_stage_evals[brcnt];
+    for (int stcnt=0; stcnt<(int)evals.size(); stcnt++) {
+      evals[stcnt] /= 2.0;
+    }
+  }
+}
+
+/* turn a fan cascade into a tree cascade: branches that start with
+* the same strong classifiers share those, so that they are evaluated
+* only once per window.  The branches themselves are kept as they are,
+* the tree merely refers to them.  The conversion is only done if at
+* least min_shared strong classifiers can be shared; returns that number.
+* Other cascade types are left alone.
+*/
+int CClassifierCascade::ConvertFanToTree(int min_shared/*=0*/)
+{
+  if (m_structure_type!=CASCADE_TYPE_FAN) {
+    return 0;
+  }
+
+  CCascadeTreeNodeVector nodes;
+  nodes.push_back(CCascadeTreeNode());
+  int num_shared = 0;
+
+  int num_branches = (int) m_branch_classifiers.size();
+  for (int brcnt=0; brcnt<num_branches; brcnt++) {
+    int parent = 0;
+    int num_stages = (int) m_branch_classifiers[brcnt].size();
+    for (int stcnt=0; stcnt<num_stages; stcnt++) {
+      const CStrongClassifier& stage = m_branch_classifiers[brcnt][stcnt];
+
+      int node = -1;
+      const CIntVector& children = nodes[parent].children;
+      for (int chcnt=0; chcnt<(int)children.size(); chcnt++) {
+        const CCascadeTreeNode& child = nodes[children[chcnt]];
+        if (m_branch_classifiers[child.branch][child.stage]==stage) {
+          node = children[chcnt];
+          break;
+        }
+      }
+      if (node==-1) {
+        node = (int) nodes.size();
+        nodes.push_back(CCascadeTreeNode(brcnt, stcnt));
+        nodes[parent].children.push_back(node);
+      } else {
+        num_shared++;
+      }
+      parent = node;
+    }
+    nodes[parent].ending_branches.push_back(brcnt);
+  }
+  VERBOSE3(3, "cascade %s: %d branches share %d strong classifiers",
+           m_name.c_str(), num_branches, num_shared);
+
+  if (num_shared<min_shared) {
+    return num_shared;
+  }
+  m_tree_nodes = nodes;
+  m_tree_branch_hits.resize(num_branches);
+  m_structure_type = CASCADE_TYPE_TREE;
+  ResetStatistics();
+  return num_shared;
+}
+
+void CClassifierCascade::EvaluateTreeNode(int node, 
+                                          const CIntegralImage& image) const
+{
+  const CCascadeTreeNode& tn = m_tree_nodes[node];
+  if (tn.branch!=-1) {
+    bool is_pos = m_branch_classifiers[tn.branch][tn.stage].Evaluate(image);
+    if (!is_pos) return;
+  }
+  for (int ecnt=0; ecnt<(int)tn.ending_branches.size(); ecnt++) {
+    m_tree_branch_hits[tn.ending_branches[ecnt]] = 1;
+  }
+  for (int chcnt=0; chcnt<(int)tn.children.size(); chcnt++) {
+    EvaluateTreeNode(tn.children[chcnt], image);
+  }
+}
+
+void CClassifierCascade::EvaluateTreeNode(int node, 
+                                          const CIntegralImage& image,
+                                          double mean, double stddev,
+                                          int left, int top) const
+{
+  const CCascadeTreeNode& tn = m_tree_nodes[node];
+  if (tn.branch!=-1) {
+    if (m_keep_statistics) m_branch_stage_evals[tn.branch][tn.stage]++;
+    bool is_pos = 
+      m_branch_classifiers[tn.branch][tn.stage].Evaluate(image, mean, stddev,
+                                                         left, top);
+    if (!is_pos) return;
+  }
+  for (int ecnt=0; ecnt<(int)tn.ending_branches.size(); ecnt++) {
+    m_tree_branch_hits[tn.ending_branches[ecnt]] = 1;
+  }
+  for (int chcnt=0; chcnt<(int)tn.children.size(); chcnt++) {
+    EvaluateTreeNode(tn.children[chcnt], image, mean, stddev, left, top);
+  }
+}
+
 // return a copy to name(s)
 CStringVector CClassifierCascade::GetNames() const
 {
@@ -506,7 +903,8 @@ CStringVector CClassifierCascade::GetNames() const
     sv.push_back(m_name);
     return sv;
 
-  } else if (m_structure_type==CASCADE_TYPE_FAN) {
+  } else if (m_structure_type==CASCADE_TYPE_FAN
+             || m_structure_type==CASCADE_TYPE_TREE) {
     return m_branch_names;
   
   } else {
@@ -514,6 +912,23 @@ CStringVector CClassifierCascade::GetNames() const
   }
 }
 
+// name of a match that Evaluate returned; the match numbers are
+// the indices into GetNames()
+const string& CClassifierCascade::GetMatchName(int match) const
+{
+  if (m_structure_type==CASCADE_TYPE_SEQUENTIAL) {
+    if (match!=0) {
+      throw ITException("match number out of range");
+    }
+    return m_name;
+  } else {
+    if (match<0 || match>=(int)m_branch_names.size()) {
+      throw ITException("match number out of range");
+    }
+    return m_branch_names[match];
+  }
+}
+
 int CClassifierCascade::GetNumStrongClassifiers(int branch/*=-1*/) const
 {
   if (branch==-1) {
@@ -522,7 +937,8 @@ int CClassifierCascade::GetNumStrongClassifiers(int branch/*=-1*/) const
     if (m_structure_type==CASCADE_TYPE_SEQUENTIAL) {
       throw ITException("no such branch for sequential type");
 
-    } else if (m_structure_type==CASCADE_TYPE_FAN) {
+    } else if (m_structure_type==CASCADE_TYPE_FAN
+               || m_structure_type==CASCADE_TYPE_TREE) {
       if (branch<0 || branch>=(int)m_branch_classifiers.size()) {
         throw ITException("branch number out of range");
       }
@@ -535,3 +951,21 @@ int CClassifierCascade::GetNumStrongClassifiers(int branch/*=-1*/) const
   }
 }
 
+/** stage num of the given branch, or of the common stages if branch
+* is -1
+*/
+CStrongClassifier& 
+CClassifierCascade::GetStrongClassifier(int branch, int num)
+{
+  if (branch==-1) {
+    return m_classifiers[num];
+  }
+  if (m_structure_type==CASCADE_TYPE_SEQUENTIAL) {
+    throw ITException("no such branch for sequential type");
+  }
+  if (branch<0 || branch>=(int)m_branch_classifiers.size()) {
+    throw ITException("branch number out of range");
+  }
+  return m_branch_classifiers[branch][num];
+}
+
@@ -75,6 +75,29 @@ typedef vector<CSClsfVector> CSClsfMatrix;
 
 typedef vector<string> CStringVector;
 
+// one node of a tree cascade: the strong classifier is one of the
+// branch classifiers, the one of the first branch that has it
+class CCascadeTreeNode {
+ public:
+  CCascadeTreeNode() : branch(-1), stage(-1) {}
+  CCascadeTreeNode(int _branch, int _stage)
+    : branch(_branch), stage(_stage) {}
+
+  int                       branch, stage;  // -1 for the root node
+  CIntVector                children;
+  CIntVector                ending_branches;
+};
+
+typedef vector<CCascadeTreeNode> CCascadeTreeNodeVector;
+
+// GetExpectedCost uses the measured evaluation statistics once this
+// many windows were evaluated, the training false positive rates before
+// (or without SetKeepStatistics);
+// the statistics are halved whenever they reach the maximum so that
+// they follow changes in the scene
+#define CASCADE_MIN_STATISTICS 1000.0
+#define CASCADE_MAX_STATISTICS 1000000.0
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // class CClassifierCascade
@@ -106,6 +129,12 @@ class CClassifierCascade {
   bool Evaluate(const CIntegralImage& image,
 		double mean_adjust, double stddev, int left, int top,
                 CStringVector& matches) const;
+  bool Evaluate(const CIntegralImage& image,
+		double mean_adjust, double stddev, int left, int top,
+                CIntVector& matches) const;
+  double EvaluateConfidence(const CIntegralImage& image,
+                            double mean_adjust, double stddev,
+                            int left, int top, CIntVector& matches) const;
 #pragma warning (default: 4786)
 #ifdef WITH_TRAINING
   bool Evaluate(const ExampleList::const_iterator example) const;
@@ -134,6 +163,14 @@ class CClassifierCascade {
 
   void ScaleFeaturesEvenly(double scale_x, double scale_y,
         int scaled_template_width, int scaled_template_height) const;
+  void Mirror();
+  double GetExpectedCost(bool* pMeasured=NULL) const;
+  void SetKeepStatistics(bool keep=true);
+  bool IsKeepingStatistics() const { return m_keep_statistics; }
+  double GetNumEvaluated() const { return m_num_evaluated; }
+  double GetNumStageEvaluated(int branch, int stage) const;
+  void ResetStatistics() const;
+  int ConvertFanToTree(int min_shared=0);
   //  void ParseFrom(istream& is);
   void ParseFrom(const string& filename);
   int RemoveLastStrongClassifier(); // returns number of remaining ones
@@ -144,6 +181,7 @@ class CClassifierCascade {
   int GetTemplateWidth() const { return m_template_width; }
   int GetTemplateHeight() const { return m_template_height; }
   int GetNumStrongClassifiers(int branch=-1) const;
+  int GetNumBranches() const { return (int)m_branch_classifiers.size(); }
   double GetTotalFalsePositiveRate() const
     { return m_total_false_positive_rate; }
   double GetFalsePositiveRate(int clsf) const;
@@ -155,14 +193,24 @@ class CClassifierCascade {
     { return m_classifiers[num]; }
   const CStrongClassifier& GetStrongClassifier(int num) const
     { return m_classifiers[num]; }
+  CStrongClassifier& GetStrongClassifier(int branch, int num);
   void SetFalsePositiveRate(int clsf, double fpr);
   void SetDetectionRate(int clsf, double dr);
   void SetExhausted(bool exhausted) { m_trainset_exhausted = exhausted; }
   CStringVector GetNames() const; // return a copy
+  const string& GetMatchName(int match) const;
 
   ostream& output(ostream& os) const;
 
 protected:
+  void EvaluateFan(const CIntegralImage& image,
+                   double mean_adjust, double stddev, int left, int top,
+                   CIntVector& matches) const;
+  void EvaluateTreeNode(int node, const CIntegralImage& image) const;
+  void EvaluateTreeNode(int node, const CIntegralImage& image,
+                        double mean_adjust, double stddev, 
+                        int left, int top) const;
+  void HalveStatistics() const;
   /*
   void RealParseFrom(istream& is);
   void ParseSomeStrongClassifiers(istream& is, int offset,
@@ -176,6 +224,10 @@ protected:
   CSClsfVector		    m_classifiers;
   CSClsfMatrix		    m_branch_classifiers;
   CStringVector             m_branch_names;
+  // tree structure: m_tree_nodes[0] is the root and has no classifier,
+  // the others point into m_branch_classifiers
+  CCascadeTreeNodeVector    m_tree_nodes;
+  mutable CIntVector        m_tree_branch_hits;
   int			    m_template_width, m_template_height;
   double			    m_image_area_ratio; // width over height
 
@@ -190,6 +242,13 @@ protected:
   CDoubleMatrix		    m_branch_lyr_detection_rates;
   bool                      m_trainset_exhausted;
 
+  // evaluation statistics: how many windows Evaluate saw, and how
+  // often it evaluated each strong classifier; only kept if asked for
+  bool                      m_keep_statistics;
+  mutable double            m_num_evaluated;
+  mutable CDoubleVector     m_stage_evals;
+  mutable CDoubleMatrix     m_branch_stage_evals;
+
   friend int yyparse();
   
 };
@@ -175,11 +175,13 @@ CWeakClassifier& CWeakClassifier::operator=(const CWeakClassifier& frm)
   return *this;
 }
 
+/* the training error does not take part, only what Evaluate uses
+*/
 bool CWeakClassifier::operator==(const CWeakClassifier& from) const
 {
-  if (feature==NULL && from.feature==NULL) return true;
   if (threshold!=from.threshold) return false;
   if (sign_lt!=from.sign_lt) return false;
+  if (feature==NULL && from.feature==NULL) return true;
   if (feature==NULL || from.feature==NULL) return false;
   
   return feature->Equals(*from.feature);
@@ -230,6 +232,30 @@ bool CWeakClassifier::Evaluate(const CIntegralImage& image, double mean, double
   }
 }
 
+/* same as above, but the feature is computed from integral image
+* elements that the strong classifier has looked up already
+*/
+bool CWeakClassifier::Evaluate(const II_TYPE* corner_values, const int* corner_index, double mean, double stddev) const
+{
+  ASSERT(feature);
+
+  double feature_value = 
+    feature->ComputeFromCorners(corner_values, corner_index, mean);
+  feature_value /= stddev;
+
+#if defined(II_TYPE_INT) || defined(II_TYPE_UINT)
+  feature_value /= stddev;
+  feature_value *= 127.5;
+  feature_value += 127.5;
+#endif
+
+  if (sign_lt) {
+    return feature_value<threshold;
+  } else {
+    return feature_value>=threshold;
+  }
+}
+
 #ifdef WITH_TRAINING
 bool CWeakClassifier::Evaluate(const ExampleList::const_iterator example) const
 {
@@ -330,6 +356,25 @@ void CWeakClassifier::ScaleFeatureEvenly(double scale_x, double scale_y,
 		       scaled_template_width, scaled_template_height);
 }
 
+/* mirrors the feature; if that negates the feature values, the
+* threshold and the comparison are flipped as well.  The classifier
+* then decides as before on the mirrored image, except for values
+* that are exactly at the threshold.
+*/
+void CWeakClassifier::Mirror()
+{
+  ASSERT(feature);
+  bool negated = feature->Mirror();
+  if (negated) {
+#if defined(II_TYPE_INT) || defined(II_TYPE_UINT)
+    threshold = 255.0-threshold;
+#else
+    threshold = -threshold;
+#endif
+    sign_lt = !sign_lt;
+  }
+}
+
 int CWeakClassifier::GetComputeCost() const
 {
   ASSERT(feature);
@@ -348,7 +393,14 @@ CStrongClassifier::CStrongClassifier(const CStrongClassifier& from)
 	m_alphas_thresh(from.m_alphas_thresh),
 	m_sum_alphas(from.m_sum_alphas),
   m_pClassifiers(NULL),
-  m_alphas(NULL)
+  m_alphas(NULL),
+  m_corners(NULL),
+  m_num_corners(0),
+  m_corner_index(NULL),
+  m_corner_index_start(NULL),
+  m_corner_values(NULL),
+  m_corner_hash(NULL),
+  m_corner_hash_mask(0)
 {
   if (m_num_hyps) {
   	m_pClassifiers = new CWeakClassifier*[m_num_hyps];
@@ -368,7 +420,14 @@ CStrongClassifier::CStrongClassifier()
 	m_alphas_thresh(0.5),
   m_pClassifiers(NULL),
   m_alphas(NULL),
-	m_sum_alphas(0.0)
+	m_sum_alphas(0.0),
+  m_corners(NULL),
+  m_num_corners(0),
+  m_corner_index(NULL),
+  m_corner_index_start(NULL),
+  m_corner_values(NULL),
+  m_corner_hash(NULL),
+  m_corner_hash_mask(0)
 {
 }
 
@@ -382,6 +441,21 @@ CStrongClassifier::~CStrongClassifier()
 	m_pClassifiers = NULL;
   delete[] m_alphas;
   m_alphas = NULL;
+  UnshareCorners();
+}
+
+/* true if both accept exactly the same windows: the same weak
+* classifiers with the same weights, and the same threshold
+*/
+bool CStrongClassifier::operator==(const CStrongClassifier& from) const
+{
+  if (m_num_hyps!=from.m_num_hyps) return false;
+  if (m_alphas_thresh!=from.m_alphas_thresh) return false;
+  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+    if (m_alphas[hcnt]!=from.m_alphas[hcnt]) return false;
+    if (!(*m_pClassifiers[hcnt]==*from.m_pClassifiers[hcnt])) return false;
+  }
+  return true;
 }
 
 CStrongClassifier& CStrongClassifier::operator=(const CStrongClassifier& from)
@@ -434,6 +508,7 @@ CStrongClassifier::AddWeakClassifier(CWeakClassifier* pClassifier, double alpha)
 	m_pClassifiers[hcnt]=new CWeakClassifier(*pClassifier);
 	m_alphas[hcnt]=alpha;
 	m_sum_alphas+=alpha;
+	UnshareCorners();
 }
 
 int
@@ -444,6 +519,7 @@ CStrongClassifier::RemoveLastWeakClassifier()
     delete m_pClassifiers[m_num_hyps];
     m_pClassifiers[m_num_hyps] = NULL;
     m_sum_alphas -= m_alphas[m_num_hyps];
+    UnshareCorners();
     return m_num_hyps;
   } else {
     return m_num_hyps;
@@ -531,10 +607,21 @@ bool CStrongClassifier::Evaluate(const CIntegralImage& image) const
 bool CStrongClassifier::Evaluate(const CIntegralImage& image, double mean, double stddev, int left, int top) const
 {
 	double sum=0.0;
-	for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
-	  sum += 
-	    m_alphas[hcnt] 
-	    * m_pClassifiers[hcnt]->Evaluate(image, mean, stddev, left, top);
+	if (m_corner_values) {
+	  LookupCorners(image, left, top);
+	  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+	    sum += 
+	      m_alphas[hcnt] 
+	      * m_pClassifiers[hcnt]->Evaluate(m_corner_values, 
+	                                       m_corner_index+m_corner_index_start[hcnt],
+	                                       mean, stddev);
+	  }
+	} else {
+	  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+	    sum += 
+	      m_alphas[hcnt] 
+	      * m_pClassifiers[hcnt]->Evaluate(image, mean, stddev, left, top);
+	  }
 	}
 	ASSERT(m_alphas_thresh); // this should be greater than zero, otherwise
 	// the strong classifier doesn't do any classification.
@@ -549,10 +636,21 @@ void CStrongClassifier::EvaluateThreshs(const CIntegralImage& image,
 					const CDoubleVector& threshs) const
 {
   double sum=0.0;
-  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
-    sum += 
-      m_alphas[hcnt] 
-      * m_pClassifiers[hcnt]->Evaluate(image, mean, stddev, left, top);
+  if (m_corner_values) {
+    LookupCorners(image, left, top);
+    for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+      sum += 
+        m_alphas[hcnt] 
+        * m_pClassifiers[hcnt]->Evaluate(m_corner_values, 
+                                         m_corner_index+m_corner_index_start[hcnt],
+                                         mean, stddev);
+    }
+  } else {
+    for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+      sum += 
+        m_alphas[hcnt] 
+        * m_pClassifiers[hcnt]->Evaluate(image, mean, stddev, left, top);
+    }
   }
 
   // do the classification for each threshold
@@ -574,6 +672,116 @@ void CStrongClassifier::ScaleFeaturesEvenly(double scale_x, double scale_y,
                                              scaled_template_width, 
 					     scaled_template_height);
   }
+  ShareCorners();
+}
+
+void CStrongClassifier::Mirror()
+{
+  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+    m_pClassifiers[hcnt]->Mirror();
+  }
+  UnshareCorners();
+}
+
+/* many features of one strong classifier read the same integral
+* image elements, especially after scaling when boxes of different
+* features line up with each other.  Collect all elements that the
+* scaled features read, store each of them only once, and remember
+* for every feature where to find its elements.  Evaluate will then
+* look up each element once per window.  This is done for every
+* scale, hence the buffers are allocated only the first time (their
+* size depends on the features only) and duplicates are found with
+* a hash table rather than by sorting.
+*/
+void CStrongClassifier::ShareCorners()
+{
+  if (m_num_hyps==0) {
+    return;
+  }
+
+  CCornerOffset feature_corners[IT_MAX_FEATURE_CORNERS];
+  if (m_corner_index_start==NULL) {
+    m_corner_index_start = new int[m_num_hyps+1];
+    int num_all_corners = 0;
+    for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+      m_corner_index_start[hcnt] = num_all_corners;
+      num_all_corners +=
+        m_pClassifiers[hcnt]->GetFeature().GetScaledCorners(feature_corners);
+    }
+    m_corner_index_start[m_num_hyps] = num_all_corners;
+    m_corners = new CCornerOffset[num_all_corners];
+    m_corner_index = new int[num_all_corners];
+    m_corner_values = new II_TYPE[num_all_corners];
+    int hash_size = 1;
+    while (hash_size<2*num_all_corners) hash_size *= 2;
+    m_corner_hash = new int[hash_size];
+    m_corner_hash_mask = hash_size-1;
+    for (int slot=0; slot<hash_size; slot++) {
+      m_corner_hash[slot] = -1;
+    }
+  }
+
+  m_num_corners = 0;
+  for (int hcnt=0; hcnt<m_num_hyps; hcnt++) {
+    int num_feature_corners =
+      m_pClassifiers[hcnt]->GetFeature().GetScaledCorners(feature_corners);
+    ASSERT(num_feature_corners<=IT_MAX_FEATURE_CORNERS);
+    ASSERT(m_corner_index_start[hcnt]+num_feature_corners
+           ==m_corner_index_start[hcnt+1]);
+    for (int fcnt=0; fcnt<num_feature_corners; fcnt++) {
+      const CCornerOffset& corner = feature_corners[fcnt];
+      unsigned int slot = 
+        ((unsigned int) corner.row*73856093u 
+         ^ (unsigned int) corner.col*19349663u) & m_corner_hash_mask;
+      while (m_corner_hash[slot]!=-1) {
+        const CCornerOffset& other = m_corners[m_corner_hash[slot]];
+        if (other.col==corner.col && other.row==corner.row) break;
+        slot = (slot+1) & m_corner_hash_mask;
+      }
+      if (m_corner_hash[slot]==-1) {
+        m_corner_hash[slot] = m_num_corners;
+        m_corners[m_num_corners] = corner;
+        m_num_corners++;
+      }
+      m_corner_index[m_corner_index_start[hcnt]+fcnt] = m_corner_hash[slot];
+    }
+  }
+
+  // empty the hash table for the next scale
+  for (int slot=0; slot<=m_corner_hash_mask; slot++) {
+    m_corner_hash[slot] = -1;
+  }
+
+  VERBOSE3(5, "CStrongClassifier: %d weak classifiers read %d elements, %d unique",
+           m_num_hyps, m_corner_index_start[m_num_hyps], m_num_corners);
+}
+
+/* must be called whenever the set of weak classifiers changes;
+* Evaluate falls back to computing each feature on its own until
+* the features get scaled again
+*/
+void CStrongClassifier::UnshareCorners()
+{
+  delete[] m_corners;
+  m_corners = NULL;
+  m_num_corners = 0;
+  delete[] m_corner_index;
+  m_corner_index = NULL;
+  delete[] m_corner_index_start;
+  m_corner_index_start = NULL;
+  delete[] m_corner_values;
+  m_corner_values = NULL;
+  delete[] m_corner_hash;
+  m_corner_hash = NULL;
+  m_corner_hash_mask = 0;
+}
+
+void CStrongClassifier::LookupCorners(const CIntegralImage& image, int left, int top) const
+{
+  for (int ccnt=0; ccnt<m_num_corners; ccnt++) {
+    m_corner_values[ccnt] = 
+      image.GetElement(left+m_corners[ccnt].col, top+m_corners[ccnt].row);
+  }
 }
 
 int CStrongClassifier::GetComputeCost() const
@@ -91,12 +91,15 @@ class CWeakClassifier {
   bool Evaluate(const CIntegralImage& image) const;
   bool Evaluate(const CIntegralImage& image, 
                 double mean_adjust, double stddev, int left, int top) const;
+  bool Evaluate(const II_TYPE* corner_values, const int* corner_index,
+                double mean_adjust, double stddev) const;
 #ifdef WITH_TRAINING
   bool Evaluate(const ExampleList::const_iterator example) const;
 #endif // WITH_TRAINING
   void ScaleFeatureEvenly(double scale_x, double scale_y,
                           int scaled_template_width, 
                           int scaled_template_height);
+  void Mirror();
   bool IsValid() const;
   void CopyFrom(const CWeakClassifier& frm, 
                 const CIntegralFeature& feature);
@@ -141,6 +144,7 @@ class CStrongClassifier {
   ~CStrongClassifier();
   
   CStrongClassifier& operator=(const CStrongClassifier& from);
+  bool operator==(const CStrongClassifier& from) const;
   
   void AddWeakClassifier(CWeakClassifier* pClassifier, double alpha);
   int RemoveLastWeakClassifier();
@@ -157,6 +161,7 @@ class CStrongClassifier {
   void ScaleFeaturesEvenly(double scale_x, double scale_y,
                            int scaled_template_width, 
                            int scaled_template_height);
+  void Mirror();
   void ParseFrom(istream& is, int template_width, int template_height);
   int GetComputeCost() const;
   
@@ -166,12 +171,28 @@ class CStrongClassifier {
   
   friend ostream& operator<<(ostream& os, const CStrongClassifier& clsf);
   
+ private:
+  void ShareCorners();
+  void UnshareCorners();
+  void LookupCorners(const CIntegralImage& image, int left, int top) const;
+
  private:
   CWeakClassifier**	                m_pClassifiers;
   int					m_num_hyps; 
   double*				m_alphas;
   double				m_sum_alphas;
   double				m_alphas_thresh;
+
+  // integral image elements that are read by the scaled features,
+  // each one only once; m_corner_index holds the features' indices
+  // into m_corner_values, starting at m_corner_index_start[hcnt]
+  CCornerOffset*                        m_corners;
+  int                                   m_num_corners;
+  int*                                  m_corner_index;
+  int*                                  m_corner_index_start;
+  II_TYPE*                              m_corner_values;
+  int*                                  m_corner_hash;
+  int                                   m_corner_hash_mask;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,641 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// Eval.cpp: it_eval, scans a directory of images with a cascade or
+// the detection cascades of a conductor and reports speed and matches.
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+
+#include "cubicles.hpp"
+#include "Cascade.h"
+#include "Scanner.h"
+#include "IntegralImage.h"
+#include "WorkerPool.h"
+#include "Exceptions.h"
+#include <stdio.h>
+#include <float.h>
+#include <fstream>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#ifdef _DEBUG
+#ifdef USE_MFC
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif // USE_MFC
+#endif // _DEBUG
+
+
+// a cascade with the scanner that it_eval uses for it; the scan
+// area of cascades from a conductor is relative to the image size
+class CEvalCascade {
+public:
+  CEvalCascade() 
+    : mirrored(false), post_process(false), relative_area(false),
+      left(0), top(0), right(1), bottom(1) {};
+
+  string             filename;
+  bool               mirrored;
+  bool               post_process;
+  bool               relative_area;
+  double             left, top, right, bottom;
+  CClassifierCascade cascade;
+  CImageScanner      scanner;   // without post-processing
+  CIntVector         stage_branches, stage_nums;  // all strong classifiers
+};
+
+typedef vector<CEvalCascade> CEvalCascadeVector;
+
+// outcome of scanning one image, with the statistics of each cascade
+class CEvalImage {
+public:
+  CEvalImage() 
+    : width(0), height(0), load_ms(0), scan_ms(0), num_windows(0) {};
+
+  string             filename;
+  string             error;        // why it could not be scanned
+  int                width, height;
+  double             load_ms, scan_ms;
+  int                num_windows;  // of all cascades
+  CIntVector         cascade_windows;
+  CScanMatchVector   matches;
+  CIntVector         match_cascades;
+  CDoubleMatrix      reached;      // per cascade and strong classifier:
+                                   // how many windows it evaluated
+  CDoubleMatrix      accepted;     // per cascade and name
+};
+
+typedef vector<CEvalImage> CEvalImageVector;
+
+class CEvalJob {
+public:
+  const CEvalCascadeVector* pCascades;
+  CEvalImageVector*         pImages;
+};
+
+
+double Now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec*1000.0 + (double)tv.tv_usec/1000.0;
+}
+
+/** remember all strong classifiers of the cascade in evaluation order:
+* the common ones first, then those of each branch
+*/
+void ListStages(CEvalCascade& ec)
+{
+  const CClassifierCascade& cascade = ec.cascade;
+  for (int branch=-1; branch<cascade.GetNumBranches(); branch++) {
+    for (int stage=0; stage<cascade.GetNumStrongClassifiers(branch); stage++) {
+      ec.stage_branches.push_back(branch);
+      ec.stage_nums.push_back(stage);
+    }
+  }
+}
+
+void LoadCascade(const string& filename, CEvalCascade& ec)
+{
+  ec.filename = filename;
+  ec.cascade.ParseFrom(filename.c_str());
+  ec.cascade.ConvertFanToTree(1);
+  ec.cascade.SetKeepStatistics();
+  ListStages(ec);
+}
+
+/** the detection cascades of a VisionConductor file, with their scan
+* areas and parameters, and their mirrored copies if the conductor asks
+* for them.  Like in handvu, cascade paths are relative to the
+* conductor's directory.
+*/
+void ReadConductor(const string& filename, CEvalCascadeVector& cascades)
+{
+  ifstream file(filename.c_str());
+  if (!file) {
+    throw ITEFileNotFound(filename);
+  }
+  string path;
+  string::size_type slash = filename.find_last_of('/');
+  if (slash!=string::npos) {
+    path = filename.substr(0, slash+1);
+  }
+  const char* it_data = getenv("IT_DATA");
+
+  bool mirror = false;
+  int num = -1;
+  string line;
+  while (num==-1 && file) {
+    getline_crlf(file, line);
+    if (line=="" || line[0]=='#') continue;
+    if (line=="detection mirror: yes") {
+      mirror = true;
+    }
+    sscanf(line.c_str(), "%d detection cascades", &num);
+  }
+  if (num==-1) {
+    throw ITEFile(filename, "no detection cascades found");
+  }
+
+  for (int cs=0; cs<num; cs++) {
+    string lines[4];
+    for (int lcnt=0; lcnt<4; lcnt++) {
+      do {
+        getline_crlf(file, lines[lcnt]);
+      } while (file && (lines[lcnt]=="" || lines[lcnt][0]=='#'));
+      if (!file) {
+        throw ITEFile(filename, "unexpected end of file");
+      }
+    }
+    string cascade_filename = lines[0];
+    if (cascade_filename.find("$IT_DATA")!=string::npos) {
+      if (it_data==NULL) {
+        throw ITEFile(filename, "The file requests the environment variable "
+                      "$IT_DATA to be set.");
+      }
+      ReplaceAll(cascade_filename, "$IT_DATA", it_data);
+    } else if (cascade_filename[0]!='/') {
+      cascade_filename = path+cascade_filename;
+    }
+
+    CEvalCascade ec;
+    float left, top, right, bottom;
+    float start_scale, stop_scale, scale_inc_factor;
+    float translation_inc_x, translation_inc_y;
+    int post_process;
+    if (sscanf(lines[1].c_str(), 
+               "area: left %f, top %f, right %f, bottom %f", 
+               &left, &top, &right, &bottom)!=4
+        || sscanf(lines[2].c_str(), 
+                  "params scaling: start %f, stop %f, inc_factor %f",
+                  &start_scale, &stop_scale, &scale_inc_factor)!=3
+        || sscanf(lines[3].c_str(), 
+                  "params misc: translation_inc_x %f, translation_inc_y %f, post_process %d",
+                  &translation_inc_x, &translation_inc_y, &post_process)!=3)
+    {
+      throw ITEFile(filename, string("expected area and params after ")
+                    +lines[0]);
+    }
+    LoadCascade(cascade_filename, ec);
+    ec.relative_area = true;
+    ec.left = left;
+    ec.top = top;
+    ec.right = right;
+    ec.bottom = bottom;
+    ec.scanner.SetScanParameters(start_scale, stop_scale, scale_inc_factor,
+                                 translation_inc_x, translation_inc_y);
+    ec.post_process = (post_process==1);
+    cascades.push_back(ec);
+  }
+
+  if (mirror) {
+    for (int cs=0; cs<num; cs++) {
+      CEvalCascade ec(cascades[cs]);
+      ec.mirrored = true;
+      ec.cascade.Mirror();
+      cascades.push_back(ec);
+    }
+  }
+}
+
+/** the PGM and PPM files in the directory, sorted by name
+*/
+void ReadImageDirectory(const string& dirname, CEvalImageVector& images)
+{
+  DIR* dir = opendir(dirname.c_str());
+  if (dir==NULL) {
+    throw ITEFileNotFound(dirname);
+  }
+  CStringVector filenames;
+  struct dirent* entry;
+  while ((entry=readdir(dir))!=NULL) {
+    string name = entry->d_name;
+    if (name.length()<4) continue;
+    string ext = name.substr(name.length()-4);
+    for (int pos=0; pos<4; pos++) ext[pos] = (char) tolower(ext[pos]);
+    if (ext==".pgm" || ext==".ppm") {
+      filenames.push_back(dirname+"/"+name);
+    }
+  }
+  closedir(dir);
+  sort(filenames.begin(), filenames.end());
+
+  images.resize(filenames.size());
+  for (int imgcnt=0; imgcnt<(int)filenames.size(); imgcnt++) {
+    images[imgcnt].filename = filenames[imgcnt];
+  }
+}
+
+/** CWorkerPool task: load and scan one image.  Evaluate keeps
+* statistics and scales the features of the cascade, so every task
+* scans with its own copies.
+*/
+void EvalTask(void* arg, int task)
+{
+  CEvalJob* pJob = (CEvalJob*) arg;
+  const CEvalCascadeVector& cascades = *pJob->pCascades;
+  CEvalImage& ei = (*pJob->pImages)[task];
+
+  double start = Now();
+  CByteImage image;
+  try {
+    image.ImportFromPNM(ei.filename);
+  } catch (ITException& ite) {
+    ei.error = ite.GetMessage();
+    return;
+  }
+  ei.width = image.Width();
+  ei.height = image.Height();
+  double loaded = Now();
+  ei.load_ms = loaded-start;
+
+  CIntegralImage integral, squared_integral;
+  CIntegralImage::CreateSimpleNSquaredFrom(image, integral, squared_integral,
+                                           CRect(0, 0, ei.width, ei.height));
+  ei.cascade_windows.resize(cascades.size());
+  ei.reached.resize(cascades.size());
+  ei.accepted.resize(cascades.size());
+  for (int cs=0; cs<(int)cascades.size(); cs++) {
+    const CEvalCascade& ec = cascades[cs];
+    CClassifierCascade cascade(ec.cascade);
+    CImageScanner scanner(ec.scanner);
+    if (ec.relative_area) {
+      scanner.SetScanArea(CRect((int)(ec.left*ei.width), 
+                                (int)(ec.top*ei.height),
+                                (int)(ec.right*ei.width),
+                                (int)(ec.bottom*ei.height)));
+    }
+    CScanMatchVector matches;
+    scanner.Scan(cascade, integral, squared_integral, matches);
+
+    CScanPlanScaleVector plan;
+    scanner.GetScanPlan(cascade, ei.width, ei.height, plan);
+    int num_windows = 0;
+    for (int scl=0; scl<(int)plan.size(); scl++) {
+      num_windows += plan[scl].num_windows;
+    }
+    ei.cascade_windows[cs] = num_windows;
+    ei.num_windows += num_windows;
+
+    // the statistics are halved now and then, but all of them at once
+    int num_stages = (int) ec.stage_nums.size();
+    ei.reached[cs].assign(num_stages, 0.0);
+    double num_evaluated = cascade.GetNumEvaluated();
+    for (int scnt=0; scnt<num_stages && num_evaluated>0; scnt++) {
+      ei.reached[cs][scnt] = num_windows *
+        cascade.GetNumStageEvaluated(ec.stage_branches[scnt],
+                                     ec.stage_nums[scnt]) / num_evaluated;
+    }
+    ei.accepted[cs].assign(cascade.GetNames().size(), 0.0);
+    for (int mcnt=0; mcnt<(int)matches.size(); mcnt++) {
+      ei.accepted[cs][matches[mcnt].name_id]++;
+    }
+
+    if (ec.post_process) {
+      scanner.PostProcess(matches);
+    }
+    for (int mcnt=0; mcnt<(int)matches.size(); mcnt++) {
+      ei.matches.push_back(matches[mcnt]);
+      ei.match_cascades.push_back(cs);
+    }
+  }
+  ei.scan_ms = Now()-loaded;
+}
+
+string JsonString(const string& str)
+{
+  string json = "\"";
+  for (int pos=0; pos<(int)str.length(); pos++) {
+    unsigned char c = (unsigned char) str[pos];
+    if (c=='"' || c=='\\') {
+      json += '\\';
+      json += c;
+    } else if (c<0x20) {
+      char buf[8];
+      sprintf(buf, "\\u%04x", c);
+      json += buf;
+    } else {
+      json += c;
+    }
+  }
+  return json + "\"";
+}
+
+/** the fraction of the windows that reach each strong classifier, and
+* of those the fraction that pass it; the last strong classifier of a
+* branch passes the windows that were accepted with the branch's name
+*/
+void StageRates(const CEvalCascade& ec, const CDoubleVector& reached,
+                const CDoubleVector& accepted, int num_windows,
+                CDoubleVector& reach_rates, CDoubleVector& pass_rates)
+{
+  int num_stages = (int) reached.size();
+  reach_rates.assign(num_stages, -1.0);
+  pass_rates.assign(num_stages, -1.0);
+  for (int scnt=0; scnt<num_stages; scnt++) {
+    if (num_windows>0) {
+      reach_rates[scnt] = reached[scnt]/num_windows;
+    }
+    if (reached[scnt]<=0) continue;
+
+    int branch = ec.stage_branches[scnt];
+    double passed = -1;
+    if (scnt+1<num_stages && ec.stage_branches[scnt+1]==branch) {
+      passed = reached[scnt+1];
+    } else if (branch==-1 && scnt+1<num_stages) {
+      // the first strong classifier of every branch sees them
+      passed = 0;
+      for (int ocnt=scnt+1; ocnt<num_stages; ocnt++) {
+        if (ec.stage_nums[ocnt]==0) passed = max(passed, reached[ocnt]);
+      }
+    } else {
+      passed = accepted[branch==-1 ? 0 : branch];
+    }
+    pass_rates[scnt] = passed/reached[scnt];
+  }
+}
+
+void WriteJson(FILE* fp, const string& source, int num_threads,
+               const CEvalCascadeVector& cascades,
+               const CEvalImageVector& images,
+               const CDoubleMatrix& reached, const CDoubleMatrix& accepted,
+               const CIntVector& cascade_windows, 
+               int num_scanned, double num_windows, double total_ms)
+{
+  fprintf(fp, "{\n  \"source\": %s,\n  \"threads\": %d,\n",
+          JsonString(source).c_str(), num_threads);
+
+  fprintf(fp, "  \"cascades\": [\n");
+  for (int cs=0; cs<(int)cascades.size(); cs++) {
+    const CEvalCascade& ec = cascades[cs];
+    CStringVector names = ec.cascade.GetNames();
+    fprintf(fp, "    {\"id\": %d, \"file\": %s, \"mirrored\": %s, \"names\": [",
+            cs, JsonString(ec.filename).c_str(), ec.mirrored ? "true" : "false");
+    for (int ncnt=0; ncnt<(int)names.size(); ncnt++) {
+      fprintf(fp, "%s%s", ncnt ? ", " : "", JsonString(names[ncnt]).c_str());
+    }
+    fprintf(fp, "],\n     \"windows\": %d, \"stages\": [", cascade_windows[cs]);
+    CDoubleVector reach_rates, pass_rates;
+    StageRates(ec, reached[cs], accepted[cs], cascade_windows[cs],
+               reach_rates, pass_rates);
+    for (int scnt=0; scnt<(int)reach_rates.size(); scnt++) {
+      fprintf(fp, "%s\n       {\"branch\": %d, \"stage\": %d, \"reached\": %g, "
+              "\"pass_rate\": ", scnt ? "," : "",
+              ec.stage_branches[scnt], ec.stage_nums[scnt], reach_rates[scnt]);
+      if (pass_rates[scnt]<0) {
+        fprintf(fp, "null}");
+      } else {
+        fprintf(fp, "%g}", pass_rates[scnt]);
+      }
+    }
+    fprintf(fp, "]}%s\n", cs+1<(int)cascades.size() ? "," : "");
+  }
+  fprintf(fp, "  ],\n");
+
+  fprintf(fp, "  \"images\": [\n");
+  for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+    const CEvalImage& ei = images[imgcnt];
+    fprintf(fp, "    {\"file\": %s, ", JsonString(ei.filename).c_str());
+    if (ei.error!="") {
+      fprintf(fp, "\"error\": %s}", JsonString(ei.error).c_str());
+    } else {
+      fprintf(fp, "\"width\": %d, \"height\": %d, \"load_ms\": %.3f, "
+              "\"scan_ms\": %.3f, \"windows\": %d,\n     \"detections\": [",
+              ei.width, ei.height, ei.load_ms, ei.scan_ms, ei.num_windows);
+      for (int mcnt=0; mcnt<(int)ei.matches.size(); mcnt++) {
+        const CScanMatch& m = ei.matches[mcnt];
+        int cs = ei.match_cascades[mcnt];
+        fprintf(fp, "%s\n       {\"cascade\": %d, \"name\": %s, \"left\": %d, "
+                "\"top\": %d, \"right\": %d, \"bottom\": %d, \"scale\": %g}",
+                mcnt ? "," : "", cs,
+                JsonString(cascades[cs].cascade.GetMatchName(m.name_id)).c_str(),
+                m.left, m.top, m.right, m.bottom, m.scale);
+      }
+      fprintf(fp, "]}");
+    }
+    fprintf(fp, "%s\n", imgcnt+1<(int)images.size() ? "," : "");
+  }
+  fprintf(fp, "  ],\n");
+
+  double seconds = total_ms/1000.0;
+  fprintf(fp, "  \"summary\": {\"images\": %d, \"failed\": %d, "
+          "\"windows\": %.0f, \"seconds\": %.3f, \"images_per_sec\": %.3f, "
+          "\"windows_per_sec\": %.0f}\n}\n",
+          num_scanned, (int)images.size()-num_scanned, num_windows, seconds,
+          seconds>0 ? num_scanned/seconds : 0.0,
+          seconds>0 ? num_windows/seconds : 0.0);
+}
+
+void Usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [options] cascade|conductor image_dir output.json\n",
+          name);
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -threads n    scan on n threads (all processors)\n");
+  fprintf(stderr, "for a single cascade:\n");
+  fprintf(stderr, "  -scale_inc f  scale increment factor (1.25)\n");
+  fprintf(stderr, "  -trans_inc n  translation increment (1.0)\n");
+  fprintf(stderr, "  -post         post-process the matches\n");
+  fprintf(stderr, "Scans all binary PGM and PPM images in image_dir, with the\n");
+  fprintf(stderr, "cascade or with the detection cascades of a VisionConductor file.\n");
+}
+
+int main(int argc, char** argv)
+{
+  int num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  double scale_inc = 1.25;
+  double trans_inc = 1.0;
+  bool post_process = false;
+  int argcnt = 1;
+  for (; argcnt<argc && argv[argcnt][0]=='-'; argcnt++) {
+    string opt = argv[argcnt];
+    if (opt=="-post") {
+      post_process = true;
+      continue;
+    }
+    if (argcnt+1>=argc) {
+      Usage(argv[0]);
+      return 1;
+    }
+    if (opt=="-threads") {
+      num_threads = atoi(argv[++argcnt]);
+    } else if (opt=="-scale_inc") {
+      scale_inc = atof(argv[++argcnt]);
+    } else if (opt=="-trans_inc") {
+      trans_inc = atof(argv[++argcnt]);
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc-argcnt!=3) {
+    Usage(argv[0]);
+    return 1;
+  }
+  string source = argv[argcnt];
+  string image_dir = argv[argcnt+1];
+  string output = argv[argcnt+2];
+
+  try {
+    CEvalCascadeVector cascades;
+    {
+      ifstream is(source.c_str());
+      string line;
+      do {
+        getline_crlf(is, line);
+      } while (is && (line=="" || line[0]=='#'));
+      if (line.find("VisionConductor file")!=string::npos) {
+        is.close();
+        ReadConductor(source, cascades);
+      } else {
+        is.close();
+        cascades.resize(1);
+        LoadCascade(source, cascades[0]);
+        cascades[0].scanner.SetScanParameters(1.0, DBL_MAX, scale_inc,
+                                              trans_inc, trans_inc);
+        cascades[0].post_process = post_process;
+      }
+    }
+
+    CEvalImageVector images;
+    ReadImageDirectory(image_dir, images);
+    if (images.empty()) {
+      throw ITEFile(image_dir, "no PGM or PPM images found");
+    }
+
+    CWorkerPool pool;
+    pool.SetNumThreads(num_threads);
+    CEvalJob job;
+    job.pCascades = &cascades;
+    job.pImages = &images;
+    double start = Now();
+    pool.Run(EvalTask, &job, (int) images.size());
+    double total_ms = Now()-start;
+
+    // add up the statistics in the order of the images
+    int num_cascades = (int) cascades.size();
+    CDoubleMatrix reached(num_cascades), accepted(num_cascades);
+    CIntVector cascade_windows(num_cascades, 0);
+    int num_scanned = 0;
+    double num_windows = 0;
+    for (int cs=0; cs<num_cascades; cs++) {
+      reached[cs].assign(cascades[cs].stage_nums.size(), 0.0);
+      accepted[cs].assign(cascades[cs].cascade.GetNames().size(), 0.0);
+    }
+    for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+      const CEvalImage& ei = images[imgcnt];
+      if (ei.error!="") {
+        fprintf(stderr, "%s: %s\n", ei.filename.c_str(), ei.error.c_str());
+        continue;
+      }
+      num_scanned++;
+      num_windows += ei.num_windows;
+      for (int cs=0; cs<num_cascades; cs++) {
+        cascade_windows[cs] += ei.cascade_windows[cs];
+        for (int scnt=0; scnt<(int)reached[cs].size(); scnt++) {
+          reached[cs][scnt] += ei.reached[cs][scnt];
+        }
+        for (int ncnt=0; ncnt<(int)accepted[cs].size(); ncnt++) {
+          accepted[cs][ncnt] += ei.accepted[cs][ncnt];
+        }
+      }
+    }
+
+    FILE* fp = fopen(output.c_str(), "w");
+    if (fp==NULL) {
+      throw ITEFile(output, "can not open for writing");
+    }
+    WriteJson(fp, source, num_threads, cascades, images, 
+              reached, accepted, cascade_windows,
+              num_scanned, num_windows, total_ms);
+    fclose(fp);
+
+    double seconds = total_ms/1000.0;
+    printf("%d images (%d failed) on %d threads in %.3f s: "
+           "%.2f images/sec, %.0f windows/sec\n",
+           num_scanned, (int)images.size()-num_scanned, num_threads, seconds,
+           seconds>0 ? num_scanned/seconds : 0.0,
+           seconds>0 ? num_windows/seconds : 0.0);
+    for (int cs=0; cs<num_cascades; cs++) {
+      const CEvalCascade& ec = cascades[cs];
+      CDoubleVector reach_rates, pass_rates;
+      StageRates(ec, reached[cs], accepted[cs], cascade_windows[cs],
+                 reach_rates, pass_rates);
+      printf("\n%s%s: %d windows\n  branch  stage  reached     pass rate\n",
+             ec.filename.c_str(), ec.mirrored ? " (mirrored)" : "",
+             cascade_windows[cs]);
+      for (int scnt=0; scnt<(int)reach_rates.size(); scnt++) {
+        if (reach_rates[scnt]<=0) continue;  // shared in a tree
+        printf("  %6d  %5d  %10.3g  ", ec.stage_branches[scnt],
+               ec.stage_nums[scnt], reach_rates[scnt]);
+        if (pass_rates[scnt]<0) {
+          printf("-\n");
+        } else {
+          printf("%9.4f\n", pass_rates[scnt]);
+        }
+      }
+    }
+
+  } catch (ITException& ite) {
+    fprintf(stderr, "error: %s\n", ite.GetMessage().c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -81,6 +81,16 @@ using namespace Magick;
 #error at least IMG_LIB_NONE must be defined
 #endif
 
+#if !defined(WIN32)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // WIN32
+#include <ctype.h>
+#include <string.h>
+
 
 
 
@@ -582,7 +592,10 @@ void CByteImage::ImportFromFile(string filename) throw (ITEFile)
 
   if (img->nChannels==1) {
     ASSERT(m_pData);
-    memcpy(img->imageData, m_pData, m_width*m_height*sizeof(BYTE));
+    for (int row=0; row<m_height; row++) {
+      memcpy(m_pData+row*m_width, img->imageData+row*img->widthStep,
+             m_width*sizeof(BYTE));
+    }
 
   } else {
     throw ITEFile(filename, "can not import");
@@ -590,13 +603,132 @@ void CByteImage::ImportFromFile(string filename) throw (ITEFile)
   cvReleaseImage(&img);
 
 #elif defined(IMG_LIB_NONE)
-  throw ITEFile(filename, "file import functionality not available");
+  ImportFromPNM(filename);
 
 #else
 #error IMG_LIB not defined - you must at least define IMG_LIB_NONE explicitely
 #endif // IMG_LIB
 }
 
+/* parse the header of a binary PGM (P5) or PPM (P6) file; returns the
+* offset of the pixel data, or -1 if the file is not one of those or
+* too short for the pixels
+*/
+static int ParsePNMHeader(const BYTE* pFile, int size, int* pChannels,
+                          int* pWidth, int* pHeight, int* pMaxval)
+{
+  if (size<2 || pFile[0]!='P' || (pFile[1]!='5' && pFile[1]!='6')) {
+    return -1;
+  }
+  *pChannels = pFile[1]=='5' ? 1 : 3;
+  int values[3];
+  int pos = 2;
+  for (int vcnt=0; vcnt<3; vcnt++) {
+    // white space and comments
+    while (pos<size && (isspace(pFile[pos]) || pFile[pos]=='#')) {
+      if (pFile[pos]=='#') {
+        while (pos<size && pFile[pos]!='\n') pos++;
+      } else {
+        pos++;
+      }
+    }
+    if (pos>=size || !isdigit(pFile[pos])) {
+      return -1;
+    }
+    values[vcnt] = 0;
+    while (pos<size && isdigit(pFile[pos])) {
+      values[vcnt] = values[vcnt]*10+(pFile[pos]-'0');
+      if (values[vcnt]>1000000) return -1;
+      pos++;
+    }
+  }
+  // a single white space character separates header and pixels
+  if (pos>=size || !isspace(pFile[pos])) {
+    return -1;
+  }
+  pos++;
+  *pWidth = values[0];
+  *pHeight = values[1];
+  *pMaxval = values[2];
+  if (*pWidth<=0 || *pHeight<=0 || *pMaxval<=0 || *pMaxval>255) {
+    return -1;
+  }
+  if ((size-pos) / *pChannels / *pWidth < *pHeight) {
+    return -1;
+  }
+  return pos;
+}
+
+/* load a binary PGM or PPM image without an image library; the file
+* is mapped into memory rather than read.  Color images are converted
+* to gray levels like ImportFromFile does.
+*/
+void CByteImage::ImportFromPNM(string filename) throw (ITEFile)
+{
+  if (filename.compare("")==0) {
+    throw ITEFile("-", "no filename given");
+  }
+
+#ifdef WIN32
+  filename = ConvertPathToWindows(filename);
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp==NULL) {
+    throw ITEFileNotFound(filename);
+  }
+  CBYTEVector buffer;
+  BYTE chunk[4096];
+  size_t num_read;
+  while ((num_read=fread(chunk, 1, sizeof(chunk), fp))>0) {
+    buffer.insert(buffer.end(), chunk, chunk+num_read);
+  }
+  fclose(fp);
+  int size = (int) buffer.size();
+  const BYTE* pFile = size ? &buffer[0] : NULL;
+#else // WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd==-1) {
+    throw ITEFileNotFound(filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st)!=0 || st.st_size==0) {
+    close(fd);
+    throw ITEFile(filename, "can not read");
+  }
+  int size = (int) st.st_size;
+  void* pMap = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (pMap==MAP_FAILED) {
+    throw ITEFile(filename, "can not map into memory");
+  }
+  const BYTE* pFile = (const BYTE*) pMap;
+#endif // WIN32
+
+  int channels, width, height, maxval;
+  int offset = ParsePNMHeader(pFile, size, &channels, &width, &height,
+                              &maxval);
+  if (offset!=-1) {
+    Allocate(width, height);
+    const BYTE* pSrc = pFile+offset;
+    if (channels==1 && maxval==255) {
+      memcpy(m_pData, pSrc, width*height*sizeof(BYTE));
+    } else {
+      double scale = 255.0/maxval;
+      for (int pos=0; pos<width*height; pos++, pSrc+=channels) {
+        double val = channels==1 ? pSrc[0] :
+          0.212671*pSrc[0] + 0.715160*pSrc[1] + 0.072169*pSrc[2];
+        m_pData[pos] = (BYTE) min(255.0, val*scale);
+      }
+    }
+  }
+
+#ifndef WIN32
+  munmap(pMap, size);
+#endif // WIN32
+  if (offset==-1) {
+    throw ITEFile(filename, "not a binary PGM or PPM image");
+  }
+}
+
 void CByteImage::ExportToFile(string filename) throw (ITEFile)
 {
   if (filename.compare("")==0) {
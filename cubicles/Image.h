@@ -115,6 +115,7 @@ class CByteImage {
   void WriteToFile(FILE* fp);
   void ReadFromFile(FILE* fp);
   void ImportFromFile(string filename) throw (ITEFile);
+  void ImportFromPNM(string filename) throw (ITEFile);
   void ExportToFile(string filename) throw (ITEFile);
   void Rotate(double degrees, int xCenter, int yCenter);
   void Crop(const CRect& area);
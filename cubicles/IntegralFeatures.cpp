@@ -197,6 +197,30 @@ void CIntegralFeature::ScaleEvenly(II_TYPE scale_x, II_TYPE scale_y,
   m_global_scale = scale_x*scale_y;
 }
 
+void CIntegralFeature::SetCorner(CCornerOffset& corner, int col, int row)
+{
+  corner.col = col;
+  corner.row = row;
+}
+
+/* the columns of a feature are integral image elements, so a box
+* spans the pixels right of its left column up to and including its
+* right column.  Mirroring takes pixel x to m_template_width-1-x,
+* hence a box (left, right] to (MirrorCol(right), MirrorCol(left)].
+*/
+int CIntegralFeature::MirrorCol(int col) const
+{
+  return m_template_width-2-col;
+}
+
+/* for Equals; the features of a cascade are all scaled alike
+*/
+bool CIntegralFeature::SameTemplate(const CIntegralFeature& from) const
+{
+  return m_template_width==from.m_template_width
+    && m_template_height==from.m_template_height;
+}
+
 featnum CIntegralFeature::GetNumIncarnations() const
 {
   if (m_num_incarnations==IT_INVALID_FEATURE) {
@@ -287,8 +311,14 @@ CLeftRightIF::CLeftRightIF(istream& is, int template_width, int template_height)
   SetNonOverlap();
 }
 
+bool CLeftRightIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CLeftRightIF&) frm);
+}
+
 bool CLeftRightIF::Equals(const CLeftRightIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal = 
     (toprow == frm.toprow &&
      bottomrow == frm.bottomrow &&
@@ -359,6 +389,41 @@ II_TYPE CLeftRightIF::ComputeScaled(const CIntegralImage& image, II_TYPE mean, i
   return scaled_val-mean_adjust;
 }
 
+int CLeftRightIF::GetScaledCorners(CCornerOffset* corners) const
+{
+	SetCorner(corners[0], scaled_centercol, scaled_bottomrow);
+	SetCorner(corners[1], scaled_centercol, scaled_toprow);
+	SetCorner(corners[2], scaled_leftrect_leftcol, scaled_bottomrow);
+	SetCorner(corners[3], scaled_leftrect_leftcol, scaled_toprow);
+	SetCorner(corners[4], scaled_rightrect_rightcol, scaled_bottomrow);
+	SetCorner(corners[5], scaled_rightrect_rightcol, scaled_toprow);
+	return 6;
+}
+
+II_TYPE CLeftRightIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+	II_TYPE botcen = values[index[0]];
+	II_TYPE topcen = values[index[1]];
+
+	II_TYPE val_leftrect = 
+		botcen
+		- values[index[2]]
+		- topcen
+		+ values[index[3]];
+
+	II_TYPE val_rightrect = 
+		values[index[4]]
+		- botcen
+		- values[index[5]]
+		+ topcen;
+
+	II_TYPE val = val_leftrect-val_rightrect;
+	II_TYPE scaled_val = val/m_global_scale;
+	II_TYPE mean_adjust = m_non_overlap*mean;
+
+	return scaled_val-mean_adjust;
+}
+
 void CLeftRightIF::Scale(II_TYPE scale_x, II_TYPE scale_y)
 {
   if (toprow==-1) {
@@ -501,6 +566,20 @@ void CLeftRightIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations=m_stop_after_num_incarnations=num;
 }
 
+/* the left box becomes the right one and vice versa, so the
+* mirrored feature computes the negated value
+*/
+bool CLeftRightIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_leftcol = MirrorCol(rightrect_rightcol);
+  rightrect_rightcol = MirrorCol(leftrect_leftcol);
+  leftrect_leftcol = mirrored_leftcol;
+  centercol = MirrorCol(centercol);
+  SetNonOverlap();
+  return true;
+}
+
 /*
 void CLeftRightIF::Transform(const CFeatureTransformer& transformer)
 {
@@ -607,8 +686,14 @@ CUpDownIF::CUpDownIF(istream& is, int templateWidth, int templateHeight)
   SetNonOverlap();
 }
 
+bool CUpDownIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CUpDownIF&) frm);
+}
+
 bool CUpDownIF::Equals(const CUpDownIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal = 
     (toprect_toprow == frm.toprect_toprow &&
      centerrow == frm.centerrow &&
@@ -674,6 +759,41 @@ II_TYPE CUpDownIF::ComputeScaled(const CIntegralImage& image, II_TYPE mean, int
 	return scaled_val-mean_adjust;
 }
 
+int CUpDownIF::GetScaledCorners(CCornerOffset* corners) const
+{
+	SetCorner(corners[0], scaled_rightcol, scaled_centerrow);
+	SetCorner(corners[1], scaled_leftcol, scaled_centerrow);
+	SetCorner(corners[2], scaled_rightcol, scaled_toprect_toprow);
+	SetCorner(corners[3], scaled_leftcol, scaled_toprect_toprow);
+	SetCorner(corners[4], scaled_rightcol, scaled_bottomrect_bottomrow);
+	SetCorner(corners[5], scaled_leftcol, scaled_bottomrect_bottomrow);
+	return 6;
+}
+
+II_TYPE CUpDownIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+	II_TYPE ceri = values[index[0]];
+	II_TYPE cele = values[index[1]];
+
+	II_TYPE val_toprect = 
+		ceri
+		- cele
+		- values[index[2]]
+		+ values[index[3]];
+
+	II_TYPE val_bottomrect = 
+		values[index[4]]
+		- values[index[5]]
+		- ceri
+		+ cele;
+
+	II_TYPE val = val_toprect-val_bottomrect;
+	II_TYPE scaled_val = val/m_global_scale;
+	II_TYPE mean_adjust = m_non_overlap*mean;
+
+	return scaled_val-mean_adjust;
+}
+
 void CUpDownIF::Scale(II_TYPE scale_x, II_TYPE scale_y)
 {
 	if (leftcol==-1) {
@@ -815,6 +935,16 @@ void CUpDownIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations=m_stop_after_num_incarnations=num;
 }
 
+bool CUpDownIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_leftcol = MirrorCol(rightcol);
+  rightcol = MirrorCol(leftcol);
+  leftcol = mirrored_leftcol;
+  SetNonOverlap();
+  return false;
+}
+
 #ifdef USE_MFC
 void CUpDownIF::Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const
 {
@@ -907,8 +1037,14 @@ CLeftCenterRightIF::CLeftCenterRightIF(istream& is, int templateWidth, int templ
   SetNonOverlap();
 }
 
+bool CLeftCenterRightIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CLeftCenterRightIF&) frm);
+}
+
 bool CLeftCenterRightIF::Equals(const CLeftCenterRightIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal = 
     (toprow == frm.toprow &&
      bottomrow == frm.bottomrow &&
@@ -993,6 +1129,51 @@ II_TYPE CLeftCenterRightIF::ComputeScaled(const CIntegralImage& image, II_TYPE m
 	return scaled_val-mean_adjust;
 }
 
+int CLeftCenterRightIF::GetScaledCorners(CCornerOffset* corners) const
+{
+	SetCorner(corners[0], scaled_leftrect_rightcol, scaled_bottomrow);
+	SetCorner(corners[1], scaled_leftrect_rightcol, scaled_toprow);
+	SetCorner(corners[2], scaled_rightrect_leftcol, scaled_bottomrow);
+	SetCorner(corners[3], scaled_rightrect_leftcol, scaled_toprow);
+	SetCorner(corners[4], scaled_leftrect_leftcol, scaled_bottomrow);
+	SetCorner(corners[5], scaled_leftrect_leftcol, scaled_toprow);
+	SetCorner(corners[6], scaled_rightrect_rightcol, scaled_bottomrow);
+	SetCorner(corners[7], scaled_rightrect_rightcol, scaled_toprow);
+	return 8;
+}
+
+II_TYPE CLeftCenterRightIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+	II_TYPE botleri = values[index[0]];
+	II_TYPE topleri = values[index[1]];
+	II_TYPE botrile = values[index[2]];
+	II_TYPE toprile = values[index[3]];
+
+	II_TYPE val_leftrect = 
+		botleri
+		- values[index[4]]
+		- topleri
+		+ values[index[5]];
+
+	II_TYPE val_centerrect = 
+		botrile
+		- botleri
+		- toprile
+		+ topleri;
+	
+	II_TYPE val_rightrect = 
+		values[index[6]]
+		- botrile
+		- values[index[7]]
+		+ toprile;
+
+	II_TYPE val = val_leftrect-val_centerrect+val_rightrect;
+	II_TYPE scaled_val = val/m_global_scale;
+	II_TYPE mean_adjust = m_non_overlap*mean;
+
+	return scaled_val-mean_adjust;
+}
+
 void CLeftCenterRightIF::Scale(II_TYPE scale_x, II_TYPE scale_y)
 {
 	if (leftrect_leftcol==-1) {
@@ -1158,6 +1339,19 @@ void CLeftCenterRightIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations=m_stop_after_num_incarnations=num;
 }
 
+bool CLeftCenterRightIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_leftrect_leftcol = MirrorCol(rightrect_rightcol);
+  int mirrored_leftrect_rightcol = MirrorCol(rightrect_leftcol);
+  rightrect_leftcol = MirrorCol(leftrect_rightcol);
+  rightrect_rightcol = MirrorCol(leftrect_leftcol);
+  leftrect_leftcol = mirrored_leftrect_leftcol;
+  leftrect_rightcol = mirrored_leftrect_rightcol;
+  SetNonOverlap();
+  return false;
+}
+
 CIntegralFeature* CLeftCenterRightIF::Copy() const 
 {
   return new CLeftCenterRightIF(*this);
@@ -1267,8 +1461,14 @@ CSevenColumnsIF::CSevenColumnsIF(istream& is, int template_width, int template_h
   SetNonOverlap();
 }
 
+bool CSevenColumnsIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CSevenColumnsIF&) frm);
+}
+
 bool CSevenColumnsIF::Equals(const CSevenColumnsIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal = 
     (toprow == frm.toprow &&
      bottomrow == frm.bottomrow &&
@@ -1368,6 +1568,61 @@ II_TYPE CSevenColumnsIF::ComputeScaled(const CIntegralImage& image, II_TYPE mean
 	return scaled_val-mean_adjust;
 }
 
+int CSevenColumnsIF::GetScaledCorners(CCornerOffset* corners) const
+{
+	SetCorner(corners[0], scaled_col1_left, scaled_bottomrow);
+	SetCorner(corners[1], scaled_col1_left, scaled_toprow);
+	SetCorner(corners[2], scaled_col2_left, scaled_bottomrow);
+	SetCorner(corners[3], scaled_col2_left, scaled_toprow);
+	SetCorner(corners[4], scaled_col3_left, scaled_bottomrow);
+	SetCorner(corners[5], scaled_col3_left, scaled_toprow);
+	SetCorner(corners[6], scaled_col4_left, scaled_bottomrow);
+	SetCorner(corners[7], scaled_col4_left, scaled_toprow);
+	SetCorner(corners[8], scaled_col5_left, scaled_bottomrow);
+	SetCorner(corners[9], scaled_col5_left, scaled_toprow);
+	SetCorner(corners[10], scaled_col6_left, scaled_bottomrow);
+	SetCorner(corners[11], scaled_col6_left, scaled_toprow);
+	SetCorner(corners[12], scaled_col7_left, scaled_bottomrow);
+	SetCorner(corners[13], scaled_col7_left, scaled_toprow);
+	SetCorner(corners[14], scaled_col7_right, scaled_bottomrow);
+	SetCorner(corners[15], scaled_col7_right, scaled_toprow);
+	return 16;
+}
+
+II_TYPE CSevenColumnsIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+	II_TYPE bot_col1_left = values[index[0]];
+	II_TYPE top_col1_left = values[index[1]];
+	II_TYPE bot_col2_left = values[index[2]];
+	II_TYPE top_col2_left = values[index[3]];
+	II_TYPE bot_col3_left = values[index[4]];
+	II_TYPE top_col3_left = values[index[5]];
+	II_TYPE bot_col4_left = values[index[6]];
+	II_TYPE top_col4_left = values[index[7]];
+	II_TYPE bot_col5_left = values[index[8]];
+	II_TYPE top_col5_left = values[index[9]];
+	II_TYPE bot_col6_left = values[index[10]];
+	II_TYPE top_col6_left = values[index[11]];
+	II_TYPE bot_col7_left = values[index[12]];
+	II_TYPE top_col7_left = values[index[13]];
+	II_TYPE bot_col7_right= values[index[14]];
+	II_TYPE top_col7_right= values[index[15]];
+
+	II_TYPE val_col1 = bot_col2_left - bot_col1_left - top_col2_left + top_col1_left;
+	II_TYPE val_col2 = bot_col3_left - bot_col2_left - top_col3_left + top_col2_left;
+	II_TYPE val_col3 = bot_col4_left - bot_col3_left - top_col4_left + top_col3_left;
+	II_TYPE val_col4 = bot_col5_left - bot_col4_left - top_col5_left + top_col4_left;
+	II_TYPE val_col5 = bot_col6_left - bot_col5_left - top_col6_left + top_col5_left;
+	II_TYPE val_col6 = bot_col7_left - bot_col6_left - top_col7_left + top_col6_left;
+	II_TYPE val_col7 = bot_col7_right- bot_col7_left - top_col7_right+ top_col7_left;
+
+	II_TYPE val = val_col1-val_col2+val_col3-val_col4+val_col5-val_col6+val_col7;
+	II_TYPE scaled_val = val/m_global_scale;
+	II_TYPE mean_adjust = m_non_overlap*mean;
+
+	return scaled_val-mean_adjust;
+}
+
 void CSevenColumnsIF::Scale(II_TYPE scale_x, II_TYPE scale_y)
 {
 	if (toprow==-1) {
@@ -1637,6 +1892,32 @@ void CSevenColumnsIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations = m_stop_after_num_incarnations=num;
 }
 
+/* the columns swap places around the fourth one; since the first
+* and the last column have the same sign, so do all pairs
+*/
+bool CSevenColumnsIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_col1_left = MirrorCol(col7_right);
+  int mirrored_col2_left = MirrorCol(col7_left);
+  int mirrored_col3_left = MirrorCol(col6_left);
+  int mirrored_col4_left = MirrorCol(col5_left);
+  int mirrored_col5_left = MirrorCol(col4_left);
+  int mirrored_col6_left = MirrorCol(col3_left);
+  int mirrored_col7_left = MirrorCol(col2_left);
+  int mirrored_col7_right = MirrorCol(col1_left);
+  col1_left = mirrored_col1_left;
+  col2_left = mirrored_col2_left;
+  col3_left = mirrored_col3_left;
+  col4_left = mirrored_col4_left;
+  col5_left = mirrored_col5_left;
+  col6_left = mirrored_col6_left;
+  col7_left = mirrored_col7_left;
+  col7_right = mirrored_col7_right;
+  SetNonOverlap();
+  return false;
+}
+
 #ifdef USE_MFC
 void CSevenColumnsIF::Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const
 {
@@ -1740,8 +2021,14 @@ CDiagIF::CDiagIF(istream& is, int templateWidth, int templateHeight)
   SetNonOverlap();
 }
 
+bool CDiagIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CDiagIF&) frm);
+}
+
 bool CDiagIF::Equals(const CDiagIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal = 
     (toprect_toprow == frm.toprect_toprow &&
      centerrow == frm.centerrow &&
@@ -1842,6 +2129,59 @@ II_TYPE CDiagIF::ComputeScaled(const CIntegralImage& image, II_TYPE mean, int le
   return scaled_val-mean_adjust;
 }
 
+int CDiagIF::GetScaledCorners(CCornerOffset* corners) const
+{
+  SetCorner(corners[0], scaled_rightrect_rightcol, scaled_centerrow);
+  SetCorner(corners[1], scaled_leftrect_leftcol, scaled_centerrow);
+  SetCorner(corners[2], scaled_centercol, scaled_centerrow);
+  SetCorner(corners[3], scaled_centercol, scaled_toprect_toprow);
+  SetCorner(corners[4], scaled_centercol, scaled_bottomrect_bottomrow);
+  SetCorner(corners[5], scaled_leftrect_leftcol, scaled_toprect_toprow);
+  SetCorner(corners[6], scaled_rightrect_rightcol, scaled_toprect_toprow);
+  SetCorner(corners[7], scaled_leftrect_leftcol, scaled_bottomrect_bottomrow);
+  SetCorner(corners[8], scaled_rightrect_rightcol, scaled_bottomrect_bottomrow);
+  return 9;
+}
+
+II_TYPE CDiagIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+  II_TYPE ceri = values[index[0]];
+  II_TYPE cele = values[index[1]];
+  II_TYPE cecen = values[index[2]];
+  II_TYPE topcen = values[index[3]];
+  II_TYPE botcen = values[index[4]];
+  
+  II_TYPE val_topleft = 
+    cecen
+    - cele
+    - topcen
+    + values[index[5]];
+  
+  II_TYPE val_topright = 
+    ceri
+    - cecen
+    - values[index[6]]
+    + topcen;
+  
+  II_TYPE val_bottomleft = 
+    botcen
+    - values[index[7]]
+    - cecen
+    + cele;
+  
+  II_TYPE val_bottomright = 
+    values[index[8]]
+    - botcen
+    - ceri
+    + cecen;
+  
+  II_TYPE val = val_topleft-val_topright-val_bottomleft+val_bottomright;
+  II_TYPE scaled_val = val/m_global_scale;
+  II_TYPE mean_adjust = m_non_overlap*mean;
+
+  return scaled_val-mean_adjust;
+}
+
 void CDiagIF::ScaleX(II_TYPE scale_x)
 {
   if (leftrect_leftcol==-1) {
@@ -2049,6 +2389,20 @@ void CDiagIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations=m_stop_after_num_incarnations=num;
 }
 
+/* the left boxes become the right ones and vice versa, so the
+* mirrored feature computes the negated value
+*/
+bool CDiagIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_leftcol = MirrorCol(rightrect_rightcol);
+  rightrect_rightcol = MirrorCol(leftrect_leftcol);
+  leftrect_leftcol = mirrored_leftcol;
+  centercol = MirrorCol(centercol);
+  SetNonOverlap();
+  return true;
+}
+
 #ifdef USE_MFC
 void CDiagIF::Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const
 {
@@ -2175,8 +2529,14 @@ CFourBoxesIF::CFourBoxesIF(istream& is, int template_width, int template_height)
   SetNonOverlap();
 }
 
+bool CFourBoxesIF::Equals(const CIntegralFeature& frm) const
+{
+  return frm.GetShape()==GetShape() && Equals((const CFourBoxesIF&) frm);
+}
+
 bool CFourBoxesIF::Equals(const CFourBoxesIF& frm) const
 {
+  if (!SameTemplate(frm)) return false;
   bool equal =
     (b1_left == frm.b1_left &&  b1_top == frm.b1_top &&
      b1_right == frm.b1_right &&  b1_bottom == frm.b1_bottom &&
@@ -2290,6 +2650,58 @@ II_TYPE CFourBoxesIF::ComputeScaled(const CIntegralImage& image, II_TYPE mean, i
 	return scaled_val-mean_adjust;
 }
 
+int CFourBoxesIF::GetScaledCorners(CCornerOffset* corners) const
+{
+  SetCorner(corners[0], scaled_b1_right, scaled_b1_bottom);
+  SetCorner(corners[1], scaled_b1_left, scaled_b1_bottom);
+  SetCorner(corners[2], scaled_b1_right, scaled_b1_top);
+  SetCorner(corners[3], scaled_b1_left, scaled_b1_top);
+  SetCorner(corners[4], scaled_b2_right, scaled_b2_bottom);
+  SetCorner(corners[5], scaled_b2_left, scaled_b2_bottom);
+  SetCorner(corners[6], scaled_b2_right, scaled_b2_top);
+  SetCorner(corners[7], scaled_b2_left, scaled_b2_top);
+  SetCorner(corners[8], scaled_b3_right, scaled_b3_bottom);
+  SetCorner(corners[9], scaled_b3_left, scaled_b3_bottom);
+  SetCorner(corners[10], scaled_b3_right, scaled_b3_top);
+  SetCorner(corners[11], scaled_b3_left, scaled_b3_top);
+  SetCorner(corners[12], scaled_b4_right, scaled_b4_bottom);
+  SetCorner(corners[13], scaled_b4_left, scaled_b4_bottom);
+  SetCorner(corners[14], scaled_b4_right, scaled_b4_top);
+  SetCorner(corners[15], scaled_b4_left, scaled_b4_top);
+  return 16;
+}
+
+II_TYPE CFourBoxesIF::ComputeFromCorners(const II_TYPE* values, const int* index, II_TYPE mean) const
+{
+  // same order of summation as in ComputeScaled
+	II_TYPE val_b1 = 
+    values[index[0]]
+    - values[index[1]]
+    - values[index[2]]
+    + values[index[3]];
+	II_TYPE val_b2 = 
+    values[index[4]]
+    - values[index[5]]
+    - values[index[6]]
+    + values[index[7]];
+	II_TYPE val_b3 = 
+    values[index[8]]
+    - values[index[9]]
+    - values[index[10]]
+    + values[index[11]];
+	II_TYPE val_b4 = 
+    values[index[12]]
+    - values[index[13]]
+    - values[index[14]]
+    + values[index[15]];
+
+	II_TYPE val = val_b1+val_b2-val_b3-val_b4;
+	II_TYPE scaled_val = val/m_global_scale;
+	II_TYPE mean_adjust = m_non_overlap*mean;
+
+	return scaled_val-mean_adjust;
+}
+
 void CFourBoxesIF::ScaleX(II_TYPE scale_x)
 {
   if (b1_left==-1) {
@@ -2671,6 +3083,28 @@ void CFourBoxesIF::MakePartialFromCurrentForNumIncarnations(
   m_remaining_incarnations = m_stop_after_num_incarnations = num;
 }
 
+/* each box is mirrored in place, the boxes keep their signs
+*/
+bool CFourBoxesIF::Mirror()
+{
+  ASSERT(!m_is_partial);
+  int mirrored_left;
+  mirrored_left = MirrorCol(b1_right);
+  b1_right = MirrorCol(b1_left);
+  b1_left = mirrored_left;
+  mirrored_left = MirrorCol(b2_right);
+  b2_right = MirrorCol(b2_left);
+  b2_left = mirrored_left;
+  mirrored_left = MirrorCol(b3_right);
+  b3_right = MirrorCol(b3_left);
+  b3_left = mirrored_left;
+  mirrored_left = MirrorCol(b4_right);
+  b4_right = MirrorCol(b4_left);
+  b4_left = mirrored_left;
+  SetNonOverlap();
+  return false;
+}
+
 #ifdef USE_MFC
 void CFourBoxesIF::Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const
 {
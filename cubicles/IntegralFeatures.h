@@ -104,6 +104,15 @@ typedef unsigned long long int featnum;
 
 typedef vector<featnum> CFeatnumVector;
 
+// offset of one integral image element relative to the top left
+// corner of the scan window
+struct CCornerOffset {
+  int col, row;
+};
+
+// no feature reads more integral image elements than this
+#define IT_MAX_FEATURE_CORNERS 16
+
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -126,6 +135,10 @@ protected:
   virtual bool SetToNextIncarnation() = 0;   // true if has more incarnations
   virtual CIntegralFeature* Copy() const = 0;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num) = 0;
+  // Mirror reflects the feature about the vertical center line of
+  // the template; returns true if the mirrored feature computes the
+  // negated value of the original one on the mirrored image
+  virtual bool Mirror() = 0;
   static CIntegralFeature* CreateFrom(istream& is, 
                                       int template_width, int template_height);
   featnum GetNumIncarnations() const;
@@ -134,8 +147,26 @@ protected:
   void ScaleEvenly(II_TYPE scale_x, II_TYPE scale_y, 
                    int scaled_template_width, int scaled_template_height);
   int GetComputeCost() const {return m_cost;};
-  virtual bool Equals(const CIntegralFeature& /*from*/) const 
-    { return false; }
+  // GetScaledCorners writes the elements that ComputeScaled reads
+  // and returns their number (at most IT_MAX_FEATURE_CORNERS), in the
+  // order in which ComputeFromCorners expects them in "index";
+  // "values" holds the elements that were looked up for one window
+  virtual int GetScaledCorners(CCornerOffset* corners) const = 0;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const = 0;
+  // the "Same" and "Similar" variants of a shape only differ in
+  // their incarnations during training, they compute the same
+  enum Shape {
+    IF_LEFT_RIGHT = 0,
+    IF_UP_DOWN = 1,
+    IF_LEFT_CENTER_RIGHT = 2,
+    IF_SEVEN_COLUMNS = 3,
+    IF_DIAG = 4,
+    IF_FOUR_BOXES = 5
+  };
+  virtual Shape GetShape() const = 0;
+  // true if both compute the same value on every image
+  virtual bool Equals(const CIntegralFeature& from) const = 0;
   //virtual void Transform(const CFeatureTransformer& transformer) = 0;
 #ifdef USE_MFC
   virtual void Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const = 0;
@@ -151,6 +182,9 @@ protected:
   virtual void EvenOutScales(II_TYPE* pScale_x, II_TYPE* pScale_y, 
                              int scaled_template_width, 
                              int scaled_template_height) = 0;
+  static void SetCorner(CCornerOffset& corner, int col, int row);
+  bool SameTemplate(const CIntegralFeature& from) const;
+  int MirrorCol(int col) const;
   enum {
     COST_ADD = 0,
     COST_GET = 1
@@ -186,10 +220,16 @@ public:
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
+  virtual Shape GetShape() const { return IF_LEFT_RIGHT; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CLeftRightIF& from) const;
   //virtual void Transform(const CFeatureTransformer& transformer);
 #ifdef USE_MFC
@@ -234,10 +274,16 @@ public:
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
+  virtual Shape GetShape() const { return IF_UP_DOWN; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CUpDownIF& from) const;
 //virtual void Transform(const CFeatureTransformer& transformer);
 #ifdef USE_MFC
@@ -282,10 +328,16 @@ public:
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
+  virtual Shape GetShape() const { return IF_LEFT_CENTER_RIGHT; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CLeftCenterRightIF& from) const;
   //virtual void Transform(const CFeatureTransformer& transformer);
 #ifdef USE_MFC
@@ -333,10 +385,16 @@ class CSevenColumnsIF : public CIntegralFeature {
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
+  virtual Shape GetShape() const { return IF_SEVEN_COLUMNS; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CSevenColumnsIF& from) const;
 #ifdef USE_MFC
   virtual void Draw(CDC* pDC, int x_off, int y_off, int zoomfactor) const;
@@ -384,12 +442,18 @@ class CDiagIF : public CIntegralFeature {
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
   void ScaleX(II_TYPE scale_x);
   void ScaleY(II_TYPE scale_y);
+  virtual Shape GetShape() const { return IF_DIAG; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CDiagIF& from) const;
   //virtual void Transform(const CFeatureTransformer& transformer);
 #ifdef USE_MFC
@@ -433,12 +497,18 @@ class CFourBoxesIF : public CIntegralFeature {
   virtual II_TYPE Compute(const CIntegralImage& image) const;
   virtual II_TYPE ComputeScaled(const CIntegralImage& image, 
                                II_TYPE mean, int left, int top) const;
+  virtual int GetScaledCorners(CCornerOffset* corners) const;
+  virtual II_TYPE ComputeFromCorners(const II_TYPE* values, 
+                                     const int* index, II_TYPE mean) const;
   virtual void SetToFirstIncarnation();
   virtual bool SetToNextIncarnation();
   virtual CIntegralFeature* Copy() const;
   virtual void MakePartialFromCurrentForNumIncarnations(featnum num);
+  virtual bool Mirror();
   void ScaleX(II_TYPE scale_x);
   void ScaleY(II_TYPE scale_y);
+  virtual Shape GetShape() const { return IF_FOUR_BOXES; }
+  virtual bool Equals(const CIntegralFeature& from) const;
   virtual bool Equals(const CFourBoxesIF& from) const;
   //virtual voiad Transform(const CFeatureTransformer& transformer);
 #ifdef USE_MFC
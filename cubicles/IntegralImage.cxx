@@ -220,21 +220,20 @@ void CIntegralImageT<TYPE>::CreateFrom(const CByteImage& image, bool normalize)
   }
 }
 
-/* allocates data structures and generates the integral matrix from
- * a gray image with TYPE-size elements.
+/* allocates data structures for CreateSimpleNSquaredFrom, without
+ * initializing them
  */
 template<class TYPE>
-void CIntegralImageT<TYPE>::CreateSimpleNSquaredFrom(
-   const CByteImage& image,
+void CIntegralImageT<TYPE>::SizeSimpleNSquared(
+   int width, int height,
    CIntegralImageT<TYPE>& integral,
-   CIntegralImageT<TYPE>& squared_integral,
-   const CRect& roi)
+   CIntegralImageT<TYPE>& squared_integral)
 {
-  int width = integral.m_width = squared_integral.m_width = image.Width();
+  integral.m_width = squared_integral.m_width = width;
   ASSERT(width);
   int padded_width = integral.m_padded_width = squared_integral.m_padded_width =
     width+1;
-  int height = integral.m_height = squared_integral.m_height = image.Height();
+  integral.m_height = squared_integral.m_height = height;
   ASSERT(height);
 
   // check sizes of internal data structures
@@ -273,12 +272,74 @@ void CIntegralImageT<TYPE>::CreateSimpleNSquaredFrom(
     squared_integral.m_arraylen = new_array_len;
     squared_integral.m_pData = &squared_integral.m_pPaddedData[padded_width+1];
   }
-  memset(integral.m_pPaddedData, 0, new_array_len*sizeof(TYPE));
-  memset(squared_integral.m_pPaddedData, 0, new_array_len*sizeof(TYPE));
+}
+
+/* allocates data structures and generates the integral matrix from
+ * a gray image with TYPE-size elements.
+ */
+template<class TYPE>
+void CIntegralImageT<TYPE>::CreateSimpleNSquaredFrom(
+   const CByteImage& image,
+   CIntegralImageT<TYPE>& integral,
+   CIntegralImageT<TYPE>& squared_integral,
+   const CRect& roi)
+{
+  SizeSimpleNSquared(image.Width(), image.Height(), integral, squared_integral);
+  memset(integral.m_pPaddedData, 0, integral.m_arraylen*sizeof(TYPE));
+  memset(squared_integral.m_pPaddedData, 0, 
+         squared_integral.m_arraylen*sizeof(TYPE));
+  FillSimpleNSquared(image, integral, squared_integral, roi);
+}
+
+/* like above, but for several ROIs, each of which is integrated on
+ * its own.  Only the ROIs and the row above and column left of each
+ * are initialized, everything else keeps whatever it was.  Hence the
+ * ROIs must not overlap, and no ROI may start right next to another
+ * one (a one-pixel gap is enough); windows must lie within one ROI.
+ */
+template<class TYPE>
+void CIntegralImageT<TYPE>::CreateSimpleNSquaredFrom(
+   const CByteImage& image,
+   CIntegralImageT<TYPE>& integral,
+   CIntegralImageT<TYPE>& squared_integral,
+   const CRectVector& rois)
+{
+  int width = image.Width();
+  int height = image.Height();
+  SizeSimpleNSquared(width, height, integral, squared_integral);
+  int padded_width = integral.m_padded_width;
+  for (int rcnt=0; rcnt<(int)rois.size(); rcnt++) {
+    const CRect& roi = rois[rcnt];
+    int left = max(0, roi.left);
+    int top = max(0, roi.top);
+    int x_stop = min(width, roi.right);
+    int y_stop = min(height, roi.bottom);
+    if (left>=x_stop || top>=y_stop) continue;
+
+    // the row above and the column left of the ROI are the zero
+    // border; at row or column -1, that is the padding
+    for (int x=left-1; x<x_stop; x++) {
+      integral.m_pData[(top-1)*padded_width+x] = 0;
+      squared_integral.m_pData[(top-1)*padded_width+x] = 0;
+    }
+    for (int y=top; y<y_stop; y++) {
+      integral.m_pData[y*padded_width+left-1] = 0;
+      squared_integral.m_pData[y*padded_width+left-1] = 0;
+    }
+    FillSimpleNSquared(image, integral, squared_integral, roi);
+  }
+}
 
+template<class TYPE>
+void CIntegralImageT<TYPE>::FillSimpleNSquared(
+   const CByteImage& image,
+   CIntegralImageT<TYPE>& integral,
+   CIntegralImageT<TYPE>& squared_integral,
+   const CRect& roi)
+{
   // fill integral image for the ROI part of the image
-  int y_stop = min(height, roi.bottom);
-  int x_stop = min(width, roi.right);
+  int y_stop = min(integral.m_height, roi.bottom);
+  int x_stop = min(integral.m_width, roi.right);
   for (int y=max(0,roi.top); y<y_stop; y++) {
     for (int x=max(0,roi.left); x<x_stop; x++) {
       TYPE img = image.Pixel(x, y);
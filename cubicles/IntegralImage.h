@@ -144,6 +144,10 @@ class CIntegralImageT
                                        CIntegralImageT<TYPE>& integral,
                                        CIntegralImageT<TYPE>& squared_integral,
                                        const CRect& roi);
+  static void CreateSimpleNSquaredFrom(const CByteImage& image,
+                                       CIntegralImageT<TYPE>& integral,
+                                       CIntegralImageT<TYPE>& squared_integral,
+                                       const CRectVector& rois);
   void SetSize(int width, int height);
   int GetWidth() const { return m_width; }
   int GetHeight() const { return m_height; }
@@ -161,6 +165,14 @@ class CIntegralImageT
   
   // Implementation
  protected:
+  static void SizeSimpleNSquared(int width, int height,
+                                 CIntegralImageT<TYPE>& integral,
+                                 CIntegralImageT<TYPE>& squared_integral);
+  static void FillSimpleNSquared(const CByteImage& image,
+                                 CIntegralImageT<TYPE>& integral,
+                                 CIntegralImageT<TYPE>& squared_integral,
+                                 const CRect& roi);
+
   TYPE*				m_pData;
   TYPE*				m_pPaddedData;
   int				m_width;
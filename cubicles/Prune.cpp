@@ -0,0 +1,507 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// Prune.cpp: it_prune, makes cascades cheaper by removing weak
+// classifiers and reports the speed/accuracy trade-offs.
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+
+#include "cubicles.hpp"
+#include "Cascade.h"
+#include "Scanner.h"
+#include "IntegralImage.h"
+#include "Exceptions.h"
+#include <stdio.h>
+#include <float.h>
+#include <fstream>
+#include <sstream>
+
+#ifdef _DEBUG
+#ifdef USE_MFC
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif // USE_MFC
+#endif // _DEBUG
+
+
+// the stage thresholds are re-tuned by bisection in (0..1] with
+// this many steps; the lowest threshold tried is the resolution of
+// the bisection, 0 would let every window pass
+#define PRUNE_TUNE_STEPS 12
+#define PRUNE_MIN_THRESHOLD (1.0/(1<<PRUNE_TUNE_STEPS))
+
+
+// one image of the validation set: a positive example contains the
+// object within the given box, a negative image contains no object
+// at all
+class CValidationImage {
+public:
+  CValidationImage() : is_positive(false), has_window(false) {};
+
+  string             filename;
+  bool               is_positive;
+  CRect              object;
+  bool               has_window;   // false if the object is too small
+  CScanWindow        window;       // the window centered on the object
+  CRect              area;         // the whole image
+  CIntegralImage     integral;
+  CIntegralImage     squared_integral;
+};
+
+typedef vector<CValidationImage*> CValidationImageVector;
+
+// speed and accuracy of one cascade on the validation set
+class CPruneResult {
+public:
+  CPruneResult() 
+    : num_removed(0), cost(0), detection_rate(0), false_positive_rate(0),
+      on_front(false) {};
+
+  int                num_removed;  // weak classifiers
+  double             cost;         // expected, per window
+  double             detection_rate;
+  double             false_positive_rate;
+  bool               on_front;
+  CClassifierCascade cascade;
+};
+
+typedef vector<CPruneResult> CPruneResultVector;
+
+
+/** read the validation list: one image per line, followed by the
+* bounding box "left top right bottom" of the object for positive
+* examples or by nothing for negative images; lines starting with #
+* are comments
+*/
+void ReadValidationList(const string& filename, CValidationImageVector& images)
+{
+  ifstream is(filename.c_str());
+  if (!is) {
+    throw ITEFileNotFound(filename);
+  }
+  string line;
+  int linecnt = 0;
+  while (getline(is, line)) {
+    linecnt++;
+    istringstream ls(line);
+    string imgname;
+    if (!(ls >> imgname) || imgname[0]=='#') {
+      continue;
+    }
+    CValidationImage* pImage = new CValidationImage();
+    images.push_back(pImage);
+    pImage->filename = imgname;
+    int left, top, right, bottom;
+    if (ls >> left >> top >> right >> bottom) {
+      if (right<=left || bottom<=top) {
+        char buf[64];
+        sprintf(buf, "empty object box in line %d", linecnt);
+        throw ITEFile(filename, buf);
+      }
+      pImage->is_positive = true;
+      pImage->object = CRect(left, top, right, bottom);
+    }
+
+    CByteImage image;
+    image.ImportFromFile(imgname);
+    pImage->area = CRect(0, 0, image.Width(), image.Height());
+    CIntegralImage::CreateSimpleNSquaredFrom(image, pImage->integral,
+                                             pImage->squared_integral,
+                                             pImage->area);
+  }
+}
+
+/** the largest window of the cascade's aspect ratio that fits into
+* each object box, centered on it.  Pruning does not change the
+* template, so this is done once for all cascades.
+*/
+void PlaceWindows(const CClassifierCascade& cascade,
+                  const CImageScanner& scanner,
+                  CValidationImageVector& images)
+{
+  CRect unit = scanner.GetWindowRect(cascade, CScanWindow(0, 0, 1.0));
+  for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+    CValidationImage* pImage = images[imgcnt];
+    if (!pImage->is_positive) continue;
+    const CRect& object = pImage->object;
+    double scale =
+      min((double)(object.right-object.left)/(unit.right-unit.left),
+          (double)(object.bottom-object.top)/(unit.bottom-unit.top));
+    if (scale<1.0) {
+      fprintf(stderr, "%s: object smaller than the template, ignored\n",
+              pImage->filename.c_str());
+      continue;
+    }
+    CRect rect = scanner.GetWindowRect(cascade, CScanWindow(0, 0, scale));
+    pImage->window = 
+      CScanWindow(object.left+(object.right-object.left-rect.right)/2,
+                  object.top+(object.bottom-object.top-rect.bottom)/2,
+                  scale);
+    pImage->has_window = true;
+  }
+}
+
+/** fraction of the positive examples whose window the cascade accepts
+*/
+double DetectionRate(const CClassifierCascade& cascade,
+                     const CImageScanner& scanner,
+                     const CValidationImageVector& images)
+{
+  int num_positives = 0;
+  int num_detected = 0;
+  for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+    const CValidationImage* pImage = images[imgcnt];
+    if (!pImage->has_window) continue;
+    CScanWindowResultVector results;
+    CScanMatchVector matches;
+    scanner.EvaluateWindows(cascade, pImage->integral,
+                            pImage->squared_integral,
+                            CRectVector(1, pImage->area),
+                            CScanWindowVector(1, pImage->window),
+                            results, matches);
+    num_positives++;
+    if (results[0].accepted) num_detected++;
+  }
+  return num_positives ? (double)num_detected/(double)num_positives : 0.0;
+}
+
+/** detection rate, false positive rate of all windows of the negative
+* images, and expected cost per window as measured on the negative
+* images; the cascade is scanned the way handvu does it, as a tree
+*/
+void Measure(const CClassifierCascade& cascade,
+             const CImageScanner& scanner,
+             const CValidationImageVector& images,
+             CPruneResult& result)
+{
+  result.detection_rate = DetectionRate(cascade, scanner, images);
+
+  CClassifierCascade tree(cascade);
+  tree.ConvertFanToTree(1);
+  tree.SetKeepStatistics();
+  int num_windows = 0;
+  int num_false = 0;
+  for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+    const CValidationImage* pImage = images[imgcnt];
+    if (pImage->is_positive) continue;
+    CScanMatchVector matches;
+    scanner.Scan(tree, pImage->integral, pImage->squared_integral, matches);
+    CScanPlanScaleVector plan;
+    scanner.GetScanPlan(tree, pImage->area.right, pImage->area.bottom, plan);
+    for (int scl=0; scl<(int)plan.size(); scl++) {
+      num_windows += plan[scl].num_windows;
+    }
+    // a window of a fan cascade can match several names
+    for (int mcnt=0; mcnt<(int)matches.size(); mcnt++) {
+      if (mcnt==0
+          || matches[mcnt].left!=matches[mcnt-1].left
+          || matches[mcnt].top!=matches[mcnt-1].top
+          || matches[mcnt].right!=matches[mcnt-1].right
+          || matches[mcnt].bottom!=matches[mcnt-1].bottom) {
+        num_false++;
+      }
+    }
+  }
+  result.false_positive_rate = 
+    num_windows ? (double)num_false/(double)num_windows : 0.0;
+  result.cost = tree.GetExpectedCost();
+}
+
+/** the branches that start with the same strong classifiers as the
+* given branch, up to and including number stage.  ConvertFanToTree
+* evaluates their strong classifier number stage only once, so they
+* must be pruned together to keep sharing it.
+*/
+CIntVector SameStages(CClassifierCascade& cascade, int branch, int stage)
+{
+  CIntVector same;
+  if (branch==-1) {
+    same.push_back(-1);
+    return same;
+  }
+  for (int bcnt=0; bcnt<cascade.GetNumBranches(); bcnt++) {
+    if (stage>=cascade.GetNumStrongClassifiers(bcnt)) continue;
+    bool is_same = true;
+    for (int scnt=0; scnt<=stage && is_same; scnt++) {
+      is_same = cascade.GetStrongClassifier(bcnt, scnt)
+        ==cascade.GetStrongClassifier(branch, scnt);
+    }
+    if (is_same) {
+      same.push_back(bcnt);
+    }
+  }
+  return same;
+}
+
+/** set the threshold of the given stages to the highest value that
+* keeps the detection rate at min_dr, by bisection; returns false if
+* not even PRUNE_MIN_THRESHOLD does
+*/
+bool TuneStage(CClassifierCascade& cascade, const CIntVector& branches,
+               int stage, double min_dr, const CImageScanner& scanner,
+               const CValidationImageVector& images)
+{
+  double lo = PRUNE_MIN_THRESHOLD;
+  double hi = 1.0;
+  for (int step=-1; step<PRUNE_TUNE_STEPS; step++) {
+    double thresh = step==-1 ? lo : (lo+hi)/2.0;
+    for (int bcnt=0; bcnt<(int)branches.size(); bcnt++) {
+      cascade.GetStrongClassifier(branches[bcnt], stage).
+        SetAlphasThreshold(thresh);
+    }
+    bool meets = DetectionRate(cascade, scanner, images)>=min_dr;
+    if (step==-1 && !meets) {
+      return false;
+    }
+    if (meets) {
+      lo = thresh;
+    } else {
+      hi = thresh;
+    }
+  }
+  for (int bcnt=0; bcnt<(int)branches.size(); bcnt++) {
+    cascade.GetStrongClassifier(branches[bcnt], stage).SetAlphasThreshold(lo);
+  }
+  return true;
+}
+
+/** remove one weak classifier from the stage that keeps the false
+* positive rate lowest, or if several do, the cost; false if all
+* candidates drop the detection rate below min_dr
+*/
+bool PruneStep(const CPruneResult& last, double min_dr,
+               const CImageScanner& scanner,
+               const CValidationImageVector& images,
+               CPruneResult& best)
+{
+  bool found = false;
+  const CClassifierCascade& cascade = last.cascade;
+  for (int branch=-1; branch<cascade.GetNumBranches(); branch++) {
+    for (int stage=0; stage<cascade.GetNumStrongClassifiers(branch); stage++) {
+      CPruneResult candidate;
+      candidate.cascade = cascade;
+      CIntVector same = SameStages(candidate.cascade, branch, stage);
+      if (same[0]!=branch) continue; // done with the first branch
+      if (candidate.cascade.GetStrongClassifier(branch, stage).
+          GetNumWeakClassifiers()<=1) continue;
+      for (int bcnt=0; bcnt<(int)same.size(); bcnt++) {
+        candidate.cascade.GetStrongClassifier(same[bcnt], stage).
+          RemoveLastWeakClassifier();
+      }
+      if (!TuneStage(candidate.cascade, same, stage, min_dr,
+                     scanner, images)) continue;
+
+      Measure(candidate.cascade, scanner, images, candidate);
+      if (!found
+          || candidate.false_positive_rate<best.false_positive_rate
+          || (candidate.false_positive_rate==best.false_positive_rate
+              && candidate.cost<best.cost)) {
+        candidate.num_removed = last.num_removed+1;
+        best = candidate;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+/** mark the results that no other one beats in cost, false positive
+* rate and detection rate at once
+*/
+void MarkParetoFront(CPruneResultVector& results)
+{
+  for (int rcnt=0; rcnt<(int)results.size(); rcnt++) {
+    const CPruneResult& r = results[rcnt];
+    results[rcnt].on_front = true;
+    for (int ocnt=0; ocnt<(int)results.size(); ocnt++) {
+      const CPruneResult& o = results[ocnt];
+      if (o.cost<=r.cost && o.false_positive_rate<=r.false_positive_rate
+          && o.detection_rate>=r.detection_rate
+          && (o.cost<r.cost || o.false_positive_rate<r.false_positive_rate
+              || o.detection_rate>r.detection_rate)) {
+        results[rcnt].on_front = false;
+        break;
+      }
+    }
+  }
+}
+
+void WriteCascade(const CPruneResult& result, const string& cascade_filename,
+                  const string& filename)
+{
+  ofstream os(filename.c_str());
+  if (!os) {
+    throw ITEFile(filename, "can not open for writing");
+  }
+  os << "# " << cascade_filename << " without " << result.num_removed
+     << " weak classifiers" << endl;
+  os << "# validation: cost " << result.cost
+     << ", detection rate " << result.detection_rate
+     << ", false positive rate " << result.false_positive_rate << endl;
+  os << result.cascade;
+  if (!os) {
+    throw ITEFile(filename, "write failed");
+  }
+}
+
+void Usage(const char* name)
+{
+  fprintf(stderr, "usage: %s [options] cascade validation_list output_prefix\n",
+          name);
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -steps n      remove at most n weak classifiers (20)\n");
+  fprintf(stderr, "  -min_dr r     keep at least this detection rate\n");
+  fprintf(stderr, "                (that of the original cascade)\n");
+  fprintf(stderr, "  -scale_inc f  scale increment factor for negatives (1.25)\n");
+  fprintf(stderr, "  -trans_inc n  translation increment for negatives (1.0)\n");
+  fprintf(stderr, "The validation list has one image per line, with the object box\n");
+  fprintf(stderr, "\"left top right bottom\" after positive examples.  The cascades\n");
+  fprintf(stderr, "on the Pareto front of cost, false positive and detection rate\n");
+  fprintf(stderr, "are written to output_prefix_<removed>.cascade.\n");
+}
+
+int main(int argc, char** argv)
+{
+  int max_steps = 20;
+  double min_dr = -1;
+  double scale_inc = 1.25;
+  double trans_inc = 1.0;
+  int argcnt = 1;
+  for (; argcnt<argc && argv[argcnt][0]=='-'; argcnt++) {
+    string opt = argv[argcnt];
+    if (argcnt+1>=argc) {
+      Usage(argv[0]);
+      return 1;
+    }
+    if (opt=="-steps") {
+      max_steps = atoi(argv[++argcnt]);
+    } else if (opt=="-min_dr") {
+      min_dr = atof(argv[++argcnt]);
+    } else if (opt=="-scale_inc") {
+      scale_inc = atof(argv[++argcnt]);
+    } else if (opt=="-trans_inc") {
+      trans_inc = atof(argv[++argcnt]);
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc-argcnt!=3) {
+    Usage(argv[0]);
+    return 1;
+  }
+  string cascade_filename = argv[argcnt];
+  string list_filename = argv[argcnt+1];
+  string prefix = argv[argcnt+2];
+
+  CValidationImageVector images;
+  try {
+    CPruneResultVector results(1);
+    results[0].cascade.ParseFrom(cascade_filename);
+
+    CImageScanner scanner;
+    scanner.SetScanParameters(1.0, DBL_MAX, scale_inc, trans_inc, trans_inc);
+    scanner.SetAutoPostProcessing(false);
+
+    ReadValidationList(list_filename, images);
+    PlaceWindows(results[0].cascade, scanner, images);
+
+    Measure(results[0].cascade, scanner, images, results[0]);
+    if (min_dr<0) {
+      min_dr = results[0].detection_rate;
+    }
+    printf("original: cost %f, detection rate %f, false positive rate %g\n",
+           results[0].cost, results[0].detection_rate,
+           results[0].false_positive_rate);
+
+    for (int step=0; step<max_steps; step++) {
+      CPruneResult best;
+      if (!PruneStep(results.back(), min_dr, scanner, images, best)) {
+        printf("no weak classifier can be removed at detection rate %f\n",
+               min_dr);
+        break;
+      }
+      results.push_back(best);
+      printf("removed %d: cost %f, detection rate %f, false positive rate %g\n",
+             best.num_removed, best.cost, best.detection_rate,
+             best.false_positive_rate);
+    }
+
+    MarkParetoFront(results);
+    printf("\nPareto front:\nremoved  cost        detection  false pos.  file\n");
+    for (int rcnt=0; rcnt<(int)results.size(); rcnt++) {
+      const CPruneResult& r = results[rcnt];
+      if (!r.on_front) continue;
+      char buf[32];
+      sprintf(buf, "_%d.cascade", r.num_removed);
+      string filename = prefix+buf;
+      WriteCascade(r, cascade_filename, filename);
+      printf("%7d  %10.4f  %9.6f  %10.3g  %s\n", r.num_removed, r.cost,
+             r.detection_rate, r.false_positive_rate, filename.c_str());
+    }
+
+  } catch (ITException& ite) {
+    fprintf(stderr, "error: %s\n", ite.GetMessage().c_str());
+    return 1;
+  }
+
+  for (int imgcnt=0; imgcnt<(int)images.size(); imgcnt++) {
+    delete images[imgcnt];
+  }
+  return 0;
+}
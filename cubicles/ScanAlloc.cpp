@@ -0,0 +1,331 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// ScanAlloc.cpp: it_scan_alloc, the test for "make check" that
+// scanning does not allocate heap memory once it has seen the frames.
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+
+#include "cubicles.hpp"
+#include "Cascade.h"
+#include "Scanner.h"
+#include "IntegralImage.h"
+#include "Exceptions.h"
+#include "cubicles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <fstream>
+#include <new>
+
+
+#define SCAN_ALLOC_WIDTH 160
+#define SCAN_ALLOC_HEIGHT 120
+#define SCAN_ALLOC_FRAMES 10
+#define SCAN_ALLOC_THRESH_FACTOR 0.7
+
+
+// every operator new of the program counts, also those in the library
+// and its worker threads; increments that race can get lost, but not
+// all of them, so an allocation still shows
+static long g_num_allocs = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  g_num_allocs++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+  g_num_allocs++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) throw()
+{
+  free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  free(p);
+}
+
+
+// a frame of smooth shading with blobs of texture; the same frame
+// for the same number
+void MakeFrame(CByteImage& image, int frame)
+{
+  srand(frame+1);
+  const int num_blobs = 12;
+  double cx[num_blobs], cy[num_blobs], r[num_blobs], v[num_blobs];
+  for (int b=0; b<num_blobs; b++) {
+    cx[b] = rand()%image.Width();
+    cy[b] = rand()%image.Height();
+    r[b] = 10+rand()%60;
+    v[b] = rand()%255;
+  }
+  for (int y=0; y<image.Height(); y++) {
+    for (int x=0; x<image.Width(); x++) {
+      double s = 100+40*sin(x*0.05)*cos(y*0.07);
+      for (int b=0; b<num_blobs; b++) {
+        double dx = x-cx[b], dy = y-cy[b];
+        if (dx*dx+dy*dy<r[b]*r[b]) {
+          s = v[b]+20*sin(x*0.3+y*0.2);
+        }
+      }
+      s += rand()%25;
+      image.Pixel(x, y) = (BYTE) (s<0 ? 0 : (s>255 ? 255 : s));
+    }
+  }
+}
+
+
+// the frames show no hands; lower thresholds let enough windows
+// through that the matches and their post-processing are exercised
+void LowerThresholds(CClassifierCascade& cascade, double factor)
+{
+  for (int branch=-1; branch<cascade.GetNumBranches(); branch++) {
+    int num_stages = cascade.GetNumStrongClassifiers(branch);
+    for (int stage=0; stage<num_stages; stage++) {
+      CStrongClassifier& sc = cascade.GetStrongClassifier(branch, stage);
+      sc.SetAlphasThreshold(sc.GetAlphasThreshold()*factor);
+    }
+  }
+}
+
+
+// scans the frames twice, the first time to size the buffers, and
+// returns how many scans of the second time allocated
+int CheckCascade(const string& filename, bool post_process)
+{
+  CClassifierCascade cascade;
+  cascade.ParseFrom(filename.c_str());
+  LowerThresholds(cascade, SCAN_ALLOC_THRESH_FACTOR);
+  cascade.ConvertFanToTree(1);
+
+  CImageScanner scanner;
+  scanner.SetScanParameters(1.0, DBL_MAX, 1.2, 1, 1);
+  scanner.SetAutoPostProcessing(post_process);
+
+  CByteImage image(SCAN_ALLOC_WIDTH, SCAN_ALLOC_HEIGHT);
+  CIntegralImage integral, squared_integral;
+  CScanMatchVector matches;
+  CRect area(0, 0, SCAN_ALLOC_WIDTH, SCAN_ALLOC_HEIGHT);
+
+  int num_failed = 0, num_matches = 0;
+  for (int pass=0; pass<2; pass++) {
+    for (int frame=0; frame<SCAN_ALLOC_FRAMES; frame++) {
+      MakeFrame(image, frame);
+      long before = g_num_allocs;
+      CIntegralImage::CreateSimpleNSquaredFrom(image, integral,
+                                               squared_integral, area);
+      scanner.Scan(cascade, integral, squared_integral, matches);
+      long allocs = g_num_allocs-before;
+      num_matches += (int)matches.size();
+      if (pass==1 && allocs>0) {
+        printf("%s%s: frame %d: %d matches, %ld allocations\n",
+               filename.c_str(), post_process ? " (post-processed)" : "",
+               frame, (int)matches.size(), allocs);
+        num_failed++;
+      }
+    }
+  }
+  if (num_matches==0) {
+    printf("%s%s: no matches, the test does not check them\n",
+           filename.c_str(), post_process ? " (post-processed)" : "");
+    num_failed++;
+  }
+  return num_failed;
+}
+
+
+// cuLoadCascade only reads files, so the cascade with lowered
+// thresholds is written to one in the current directory
+string WriteLowered(const string& filename, int num)
+{
+  CClassifierCascade cascade;
+  cascade.ParseFrom(filename.c_str());
+  LowerThresholds(cascade, SCAN_ALLOC_THRESH_FACTOR);
+  char lowered[64];
+  sprintf(lowered, "it_scan_alloc_%d.cascade", num);
+  ofstream os(lowered);
+  os << cascade;
+  if (!os) {
+    throw ITException(string("could not write ") + lowered);
+  }
+  return lowered;
+}
+
+
+// the same through the C interface: cuScan with all cascades in one
+// context, each of them loaded twice so that the copies are scanned
+// together, into the same match vector for all frames
+int CheckCuScan(const CStringVector& filenames, int num_threads)
+{
+  CuContext* pContext = cuCreateContext();
+  cuSetContext(pContext);
+  cuInitialize(SCAN_ALLOC_WIDTH, SCAN_ALLOC_HEIGHT);
+  cuSetNumThreads(num_threads);
+
+  CStringVector lowered;
+  for (int fcnt=0; fcnt<(int)filenames.size(); fcnt++) {
+    lowered.push_back(WriteLowered(filenames[fcnt], fcnt));
+    for (int post_process=0; post_process<2; post_process++) {
+      CuCascadeID cascadeID;
+      cuLoadCascade(lowered.back(), &cascadeID);
+      CuScannerParameters sp;
+      sp.active = true;
+      sp.left = 0;
+      sp.top = 0;
+      sp.right = SCAN_ALLOC_WIDTH;
+      sp.bottom = SCAN_ALLOC_HEIGHT;
+      sp.start_scale = 1.0;
+      sp.stop_scale = DBL_MAX;
+      sp.scale_inc_factor = 1.2;
+      sp.translation_inc_x = 1;
+      sp.translation_inc_y = 1;
+      sp.post_process = post_process!=0;
+      cuSetScannerParameters(cascadeID, sp);
+    }
+  }
+
+  // cuScan only needs the header fields that describe the pixels
+  CByteImage image(SCAN_ALLOC_WIDTH, SCAN_ALLOC_HEIGHT);
+  IplImage header;
+  memset(&header, 0, sizeof(header));
+  header.nSize = sizeof(IplImage);
+  header.nChannels = 1;
+  header.depth = IPL_DEPTH_8U;
+  header.origin = 0;
+  header.width = SCAN_ALLOC_WIDTH;
+  header.height = SCAN_ALLOC_HEIGHT;
+  header.widthStep = SCAN_ALLOC_WIDTH;
+  header.imageSize = SCAN_ALLOC_WIDTH*SCAN_ALLOC_HEIGHT;
+  header.imageData = (char*) image.GetData();
+  CuScanMatchVector matches;
+
+  int num_failed = 0, num_matches = 0;
+  for (int pass=0; pass<2; pass++) {
+    for (int frame=0; frame<SCAN_ALLOC_FRAMES; frame++) {
+      MakeFrame(image, frame);
+      long before = g_num_allocs;
+      cuScan(&header, matches);
+      long allocs = g_num_allocs-before;
+      num_matches += (int)matches.size();
+      if (pass==1 && allocs>0) {
+        printf("cuScan with %d threads: frame %d: %d matches, "
+               "%ld allocations\n",
+               num_threads, frame, (int)matches.size(), allocs);
+        num_failed++;
+      }
+    }
+  }
+  if (num_matches==0) {
+    printf("cuScan with %d threads: no matches, the test does not "
+           "check them\n", num_threads);
+    num_failed++;
+  }
+
+  cuReleaseContext(&pContext);
+  for (int lcnt=0; lcnt<(int)lowered.size(); lcnt++) {
+    remove(lowered[lcnt].c_str());
+  }
+  return num_failed;
+}
+
+
+// checks the given cascades, or the shipped ones in $srcdir/../config
+int main(int argc, char* argv[])
+{
+  CStringVector filenames;
+  for (int arg=1; arg<argc; arg++) {
+    filenames.push_back(argv[arg]);
+  }
+  if (filenames.empty()) {
+    const char* srcdir = getenv("srcdir");
+    string config = string(srcdir ? srcdir : ".") + "/../config/";
+    filenames.push_back(config+"all_hands_combined.cascade");
+    filenames.push_back(config+"all_extended_0_5_10_15_closed_30x20.cascade");
+  }
+
+  int num_failed = 0;
+  try {
+    for (int fcnt=0; fcnt<(int)filenames.size(); fcnt++) {
+      num_failed += CheckCascade(filenames[fcnt], false);
+      num_failed += CheckCascade(filenames[fcnt], true);
+    }
+    num_failed += CheckCuScan(filenames, 1);
+    num_failed += CheckCuScan(filenames, 2);
+  } catch (ITException& ite) {
+    fprintf(stderr, "error: %s\n", ite.GetMessage().c_str());
+    return 1;
+  }
+  if (num_failed) {
+    printf("%d scans allocated after the first %d frames\n",
+           num_failed, SCAN_ALLOC_FRAMES);
+    return 1;
+  }
+  return 0;
+}
@@ -61,6 +61,7 @@
 
 
 #include "cubicles.hpp"
+#include "Trace.h"
 #include "Scanner.h"
 #include "Cascade.h"
 #include <math.h>
@@ -81,7 +82,10 @@ static char THIS_FILE[] = __FILE__;
 
 CImageScanner::CImageScanner() 
 : m_is_active(true),
-  m_post_process(false)
+  m_post_process(false),
+  m_scan_order(SCAN_ORDER_RASTER),
+  m_max_matches(0),
+  m_prior(SCAN_PRIOR_CELLS_X*SCAN_PRIOR_CELLS_Y, 0.0)
 {
   SetScanParameters();
 }
@@ -95,6 +99,9 @@ CImageScanner::CImageScanner(const CImageScanner& src)
   m_translation_inc_y(src.m_translation_inc_y),
   m_scan_area(src.m_scan_area),
   m_post_process(src.m_post_process),
+  m_scan_order(src.m_scan_order),
+  m_max_matches(src.m_max_matches),
+  m_prior(src.m_prior),
   m_min_scaled_template_width(-1),
   m_max_scaled_template_width(-1),
   m_min_scaled_template_height(-1),
@@ -181,6 +188,58 @@ const CRect& CImageScanner::GetScanArea() const
   return m_scan_area;
 }
 
+/** the order in which windows are scanned; with an order other than
+* SCAN_ORDER_RASTER, the cells of the prior grid are ranked and the
+* best ones are scanned at all scales before the others.  If 
+* max_matches is positive, the scan stops as soon as that many 
+* matches were found.
+*/
+void CImageScanner::SetScanOrder(ScanOrder order, int max_matches/*=0*/)
+{
+  if (order!=SCAN_ORDER_RASTER && order!=SCAN_ORDER_CENTER_OUT
+      && order!=SCAN_ORDER_PRIOR) {
+    throw ITException("invalid scan order");
+  }
+  if (max_matches<0) {
+    throw ITException("max_matches must not be negative");
+  }
+  m_scan_order = order;
+  m_max_matches = max_matches;
+}
+
+void CImageScanner::GetScanOrder(ScanOrder* pOrder, int* pMax_matches) const
+{
+  *pOrder = m_scan_order;
+  *pMax_matches = m_max_matches;
+}
+
+/** tell the scanner that an object was found in area, so that
+* SCAN_ORDER_PRIOR scans look there first next time
+*/
+void CImageScanner::AddPrior(const CRect& area, 
+                             int image_width, int image_height)
+{
+  if (image_width<=0 || image_height<=0) {
+    throw ITException("invalid image size");
+  }
+  int center_x = (area.left+area.right)/2;
+  int center_y = (area.top+area.bottom)/2;
+  if (center_x<0 || center_x>=image_width
+      || center_y<0 || center_y>=image_height) {
+    return;
+  }
+  int cell_x = center_x*SCAN_PRIOR_CELLS_X/image_width;
+  int cell_y = center_y*SCAN_PRIOR_CELLS_Y/image_height;
+  m_prior[cell_y*SCAN_PRIOR_CELLS_X+cell_x] += 1.0;
+}
+
+void CImageScanner::ClearPrior()
+{
+  for (int cell=0; cell<(int)m_prior.size(); cell++) {
+    m_prior[cell] = 0.0;
+  }
+}
+
 int
 CImageScanner::Scan(const CClassifierCascade& cascade,
 		    const CByteImage& image, CScanMatchVector& posClsfd) const
@@ -202,6 +261,38 @@ CImageScanner::Scan(const CClassifierCascade& cascade,
   if (!m_is_active) return -1;
 
   posClsfd.clear();  
+  int scancnt=0;
+  bool done = false;
+  if (m_scan_order==SCAN_ORDER_RASTER) {
+    scancnt = ScanPass(cascade, integral, squared_integral, -1, 
+                       posClsfd, &done);
+  } else {
+    OrderRegions(integral.GetWidth(), integral.GetHeight());
+    for (int pass=0; pass<SCAN_NUM_PASSES && !done; pass++) {
+      scancnt += ScanPass(cascade, integral, squared_integral, pass,
+                          posClsfd, &done);
+    }
+  }
+
+  if (m_post_process) {
+    PostProcess(posClsfd);
+    return (int) posClsfd.size();
+  } else {
+    return scancnt;
+  }
+}
+
+/** scan all windows at all scales whose centers lie in a prior grid
+* cell that OrderRegions assigned to this pass, or all windows if
+* pass is -1.  *pDone is set once m_max_matches matches were found.
+*/
+int
+CImageScanner::ScanPass(const CClassifierCascade& cascade,
+                        const CIntegralImage& integral,
+                        const CIntegralImage& squared_integral,
+                        int pass,
+                        CScanMatchVector& posClsfd, bool* pDone) const
+{
   CScaleParams sclprms;
   InitScaleParams(cascade, sclprms);
   m_min_scaled_template_width = sclprms.scaled_template_width;
@@ -212,24 +303,37 @@ CImageScanner::Scan(const CClassifierCascade& cascade,
   int width = integral.GetWidth();
   int height = integral.GetHeight();
   
-  CStringVector matches;
+  CIntVector& matches = m_matches;
+  matches.clear();
   int scancnt=0;
   while (sclprms.scaled_template_width<width && sclprms.scaled_template_height<height
     && sclprms.base_scale<m_stop_scale) 
   {
+    CuTraceSpan span("scale", "scale", sclprms.base_scale);
     cascade.ScaleFeaturesEvenly(sclprms.actual_scale_x, 
 				sclprms.actual_scale_y,
 				sclprms.scaled_template_width, 
 				sclprms.scaled_template_height);
+    int half_width = sclprms.scaled_template_width/2;
+    int half_height = sclprms.scaled_template_height/2;
 
     // for each y-location in the image
     int top_stop = min(m_scan_area.bottom, height)-sclprms.scaled_template_height;
     for (int top=max(0, m_scan_area.top); top<top_stop; top+=(int)sclprms.translation_inc_y) {
       int bottom = top+sclprms.scaled_template_height;
+      const int* cell_pass = NULL;
+      if (pass!=-1) {
+        int cell_y = (top+half_height)*SCAN_PRIOR_CELLS_Y/height;
+        cell_pass = &m_cell_pass[cell_y*SCAN_PRIOR_CELLS_X];
+      }
 
       // for each x-location in the image
       int left_stop = min(m_scan_area.right, width)-sclprms.scaled_template_width;
       for (int left=max(0, m_scan_area.left); left<left_stop; left+=(int)sclprms.translation_inc_x) {
+        if (cell_pass 
+            && cell_pass[(left+half_width)*SCAN_PRIOR_CELLS_X/width]!=pass) {
+          continue;
+        }
         int right = left+sclprms.scaled_template_width;
 
         double sum_x = 
@@ -249,6 +353,7 @@ CImageScanner::Scan(const CClassifierCascade& cascade,
 
         bool is_positive =
           cascade.Evaluate(integral, mean, stddev, left, top, matches);
+        scancnt++;
         if (is_positive) {
           for (int m=0; m<(int)matches.size(); m++) {
             posClsfd.push_back(CScanMatch(left, top, right, bottom,
@@ -257,8 +362,11 @@ CImageScanner::Scan(const CClassifierCascade& cascade,
                                           matches[m]));
           }
           matches.clear();
+          if (m_max_matches>0 && (int)posClsfd.size()>=m_max_matches) {
+            *pDone = true;
+            return scancnt;
+          }
         }
-        scancnt++;
       }
     }
 
@@ -268,12 +376,352 @@ CImageScanner::Scan(const CClassifierCascade& cascade,
     ASSERT(N!=sclprms.scaled_template_width*sclprms.scaled_template_height);
     N = sclprms.scaled_template_width * sclprms.scaled_template_height;
   }
+  return scancnt;
+}
+
+/** rank the prior grid cells that overlap the scan area, most
+* promising first, and assign them to the scan passes: the first
+* pass gets the best ninth of them, the second pass the next third,
+* the last pass the rest.  There are only a few passes because each
+* pass has to scale the features once per scale.
+*/
+void CImageScanner::OrderRegions(int image_width, int image_height) const
+{
+  double center_x = 
+    (max(0, m_scan_area.left)+min(m_scan_area.right, image_width))/2.0;
+  double center_y = 
+    (max(0, m_scan_area.top)+min(m_scan_area.bottom, image_height))/2.0;
+
+  int num_cells = SCAN_PRIOR_CELLS_X*SCAN_PRIOR_CELLS_Y;
+  m_cell_pass.resize(num_cells);
+  m_region_order.clear();
+  m_region_keys.clear();
+  for (int cell=0; cell<num_cells; cell++) {
+    m_cell_pass[cell] = -1;
+    int cell_x = cell%SCAN_PRIOR_CELLS_X;
+    int cell_y = cell/SCAN_PRIOR_CELLS_X;
+    int left = cell_x*image_width/SCAN_PRIOR_CELLS_X;
+    int top = cell_y*image_height/SCAN_PRIOR_CELLS_Y;
+    int right = (cell_x+1)*image_width/SCAN_PRIOR_CELLS_X;
+    int bottom = (cell_y+1)*image_height/SCAN_PRIOR_CELLS_Y;
+    if (right<=m_scan_area.left || m_scan_area.right<=left
+        || bottom<=m_scan_area.top || m_scan_area.bottom<=top) {
+      continue;
+    }
+    // closer to the center is better, prior weight is much better
+    double dx = (left+right)/2.0-center_x;
+    double dy = (top+bottom)/2.0-center_y;
+    double key = sqrt(dx*dx+dy*dy)/(double)(image_width+image_height);
+    if (m_scan_order==SCAN_ORDER_PRIOR) {
+      key -= m_prior[cell];
+    }
+
+    // insertion sort, there are only a few cells
+    int pos = (int) m_region_order.size();
+    m_region_order.push_back(cell);
+    m_region_keys.push_back(key);
+    while (pos>0 && m_region_keys[pos-1]>key) {
+      m_region_order[pos] = m_region_order[pos-1];
+      m_region_keys[pos] = m_region_keys[pos-1];
+      pos--;
+    }
+    m_region_order[pos] = cell;
+    m_region_keys[pos] = key;
+  }
+
+  int num_regions = (int) m_region_order.size();
+  int first_end = (num_regions+8)/9;
+  int second_end = first_end+(num_regions+2)/3;
+  for (int rcnt=0; rcnt<num_regions; rcnt++) {
+    int pass = rcnt<first_end ? 0 : (rcnt<second_end ? 1 : 2);
+    m_cell_pass[m_region_order[rcnt]] = pass;
+  }
+}
+
+/** the area that a window covers in the image
+*/
+CRect CImageScanner::GetWindowRect(const CClassifierCascade& cascade,
+                                   const CScanWindow& window) const
+{
+  if (window.scale<1.0) {
+    throw ITException("window scale must be at least 1.0");
+  }
+  CScaleParams sclprms;
+  InitScaleParams(cascade, window.scale, sclprms);
+  return CRect(window.left, window.top,
+               window.left+sclprms.scaled_template_width,
+               window.top+sclprms.scaled_template_height);
+}
+
+/** true if this scanner with its cascade and the other scanner with
+* its cascade visit exactly the same windows, so that ScanTogether
+* can scan them in one pass
+*/
+bool CImageScanner::CanScanTogether(const CClassifierCascade& cascade,
+                                    const CImageScanner& other,
+                                    const CClassifierCascade& other_cascade) const
+{
+  return m_is_active && other.m_is_active
+    && m_scan_order==SCAN_ORDER_RASTER && other.m_scan_order==SCAN_ORDER_RASTER
+    && m_max_matches==0 && other.m_max_matches==0
+    && m_start_scale==other.m_start_scale
+    && m_stop_scale==other.m_stop_scale
+    && m_scale_inc_factor==other.m_scale_inc_factor
+    && m_translation_inc_x==other.m_translation_inc_x
+    && m_translation_inc_y==other.m_translation_inc_y
+    && m_scan_area.left==other.m_scan_area.left
+    && m_scan_area.top==other.m_scan_area.top
+    && m_scan_area.right==other.m_scan_area.right
+    && m_scan_area.bottom==other.m_scan_area.bottom
+    && cascade.GetTemplateWidth()==other_cascade.GetTemplateWidth()
+    && cascade.GetTemplateHeight()==other_cascade.GetTemplateHeight()
+    && cascade.GetImageAreaRatio()==other_cascade.GetImageAreaRatio();
+}
+
+/** scan several cascades in one pass over the windows: each window is
+* normalized once and then evaluated with all cascades.  "which" lists
+* the indices into scanners and cascades, and all of them must be 
+* compatible with the first one (CanScanTogether).  matches[which[i]]
+* receives the same matches as scanners[which[i]].Scan would find.
+*/
+void CImageScanner::ScanTogether(const CScannerVector& scanners,
+                                 const CCascadeVector& cascades,
+                                 const CIntVector& which,
+                                 const CIntegralImage& integral,
+                                 const CIntegralImage& squared_integral,
+                                 CScanMatchMatrix& matches)
+{
+  int num_which = (int) which.size();
+  if (num_which==0) return;
+  const CImageScanner& first = scanners[which[0]];
+  for (int wcnt=0; wcnt<num_which; wcnt++) {
+    ASSERT(first.CanScanTogether(cascades[which[0]],
+                                 scanners[which[wcnt]], cascades[which[wcnt]]));
+    matches[which[wcnt]].clear();
+  }
+
+  CScaleParams sclprms;
+  first.InitScaleParams(cascades[which[0]], sclprms);
+  for (int wcnt=0; wcnt<num_which; wcnt++) {
+    const CImageScanner& scanner = scanners[which[wcnt]];
+    scanner.m_min_scaled_template_width = sclprms.scaled_template_width;
+    scanner.m_min_scaled_template_height = sclprms.scaled_template_height;
+  }
+  double N = sclprms.scaled_template_width * sclprms.scaled_template_height;
+  
+  int width = integral.GetWidth();
+  int height = integral.GetHeight();
+  const CRect& scan_area = first.m_scan_area;
+  
+  CIntVector& cascade_matches = first.m_matches;
+  cascade_matches.clear();
+  while (sclprms.scaled_template_width<width && sclprms.scaled_template_height<height
+    && sclprms.base_scale<first.m_stop_scale) 
+  {
+    CuTraceSpan span("scale", "scale", sclprms.base_scale);
+    for (int wcnt=0; wcnt<num_which; wcnt++) {
+      cascades[which[wcnt]].ScaleFeaturesEvenly(sclprms.actual_scale_x, 
+                                                sclprms.actual_scale_y,
+                                                sclprms.scaled_template_width, 
+                                                sclprms.scaled_template_height);
+    }
+
+    // for each y-location in the image
+    int top_stop = min(scan_area.bottom, height)-sclprms.scaled_template_height;
+    for (int top=max(0, scan_area.top); top<top_stop; top+=(int)sclprms.translation_inc_y) {
+      int bottom = top+sclprms.scaled_template_height;
+
+      // for each x-location in the image
+      int left_stop = min(scan_area.right, width)-sclprms.scaled_template_width;
+      for (int left=max(0, scan_area.left); left<left_stop; left+=(int)sclprms.translation_inc_x) {
+        int right = left+sclprms.scaled_template_width;
+
+        double sum_x = 
+          integral.GetElement(right-1, bottom-1) 
+          - integral.GetElement(right-1, top-1)
+          - integral.GetElement(left-1, bottom-1)
+          + integral.GetElement(left-1, top-1);
+        double mean =
+          sum_x / N;
+        double sum_x2 = 
+          squared_integral.GetElement(right-1, bottom-1) 
+          - squared_integral.GetElement(right-1, top-1)
+          - squared_integral.GetElement(left-1, bottom-1)
+          + squared_integral.GetElement(left-1, top-1);
+        double stddev = sqrt(fabs(mean*mean - sum_x2/N));
+
+        // offer the window to all cascades
+        for (int wcnt=0; wcnt<num_which; wcnt++) {
+          bool is_positive =
+            cascades[which[wcnt]].Evaluate(integral, mean, stddev, left, top,
+                                           cascade_matches);
+          if (is_positive) {
+            CScanMatchVector& posClsfd = matches[which[wcnt]];
+            for (int m=0; m<(int)cascade_matches.size(); m++) {
+              posClsfd.push_back(CScanMatch(left, top, right, bottom,
+                                            sclprms.base_scale,
+                                            sclprms.scale_x, sclprms.scale_y,
+                                            cascade_matches[m]));
+            }
+            cascade_matches.clear();
+          }
+        }
+      }
+    }
+
+    for (int wcnt=0; wcnt<num_which; wcnt++) {
+      const CImageScanner& scanner = scanners[which[wcnt]];
+      scanner.m_max_scaled_template_width = sclprms.scaled_template_width;
+      scanner.m_max_scaled_template_height = sclprms.scaled_template_height;
+    }
+    first.NextScaleParams(sclprms);
+    ASSERT(N!=sclprms.scaled_template_width*sclprms.scaled_template_height);
+    N = sclprms.scaled_template_width * sclprms.scaled_template_height;
+  }
+
+  for (int wcnt=0; wcnt<num_which; wcnt++) {
+    const CImageScanner& scanner = scanners[which[wcnt]];
+    if (scanner.m_post_process) {
+      scanner.PostProcess(matches[which[wcnt]]);
+    }
+  }
+}
+
+/** predict what Scan will do on an image of the given size with the
+* current parameters, without scanning: the scales, the number of 
+* windows at each scale, and their expected cost according to
+* CClassifierCascade::GetExpectedCost.  Returns the total cost.  With
+* a match limit (SetScanOrder), the scan may stop earlier than this.
+*/
+double CImageScanner::GetScanPlan(const CClassifierCascade& cascade,
+                                  int image_width, int image_height,
+                                  CScanPlanScaleVector& plan) const
+{
+  plan.clear();
+  if (!m_is_active) return 0;
+
+  double window_cost = cascade.GetExpectedCost();
+  double total_cost = 0;
+  CScaleParams sclprms;
+  InitScaleParams(cascade, sclprms);
+  while (sclprms.scaled_template_width<image_width 
+         && sclprms.scaled_template_height<image_height
+         && sclprms.base_scale<m_stop_scale) 
+  {
+    // same window positions as in ScanPass
+    int top_start = max(0, m_scan_area.top);
+    int top_stop = min(m_scan_area.bottom, image_height)-sclprms.scaled_template_height;
+    int inc_y = (int) sclprms.translation_inc_y;
+    int num_rows = top_start<top_stop ? (top_stop-top_start+inc_y-1)/inc_y : 0;
+    int left_start = max(0, m_scan_area.left);
+    int left_stop = min(m_scan_area.right, image_width)-sclprms.scaled_template_width;
+    int inc_x = (int) sclprms.translation_inc_x;
+    int num_cols = left_start<left_stop ? (left_stop-left_start+inc_x-1)/inc_x : 0;
+
+    CScanPlanScale scale;
+    scale.scale = sclprms.base_scale;
+    scale.width = sclprms.scaled_template_width;
+    scale.height = sclprms.scaled_template_height;
+    scale.num_windows = num_rows*num_cols;
+    scale.cost = scale.num_windows*window_cost;
+    plan.push_back(scale);
+    total_cost += scale.cost;
+
+    NextScaleParams(sclprms);
+  }
+  return total_cost;
+}
+
+/** evaluate the cascade only on the given windows rather than on
+* all windows in the scan area.  The integral images must be valid
+* within each of the integrated_areas; windows that are not entirely
+* inside one of them are rejected.  "results" gets one entry per window, "matches"
+* the matches of all accepted windows, just like Scan would report
+* them (with post processing if that is turned on).  Neighboring
+* windows with the same scale share the feature scaling, so callers
+* should order the windows by scale.
+*/
+void CImageScanner::EvaluateWindows(const CClassifierCascade& cascade,
+                                    const CIntegralImage& integral,
+                                    const CIntegralImage& squared_integral,
+                                    const CRectVector& integrated_areas,
+                                    const CScanWindowVector& windows,
+                                    CScanWindowResultVector& results,
+                                    CScanMatchVector& posClsfd) const
+{
+  int num_windows = (int) windows.size();
+  results.resize(num_windows);
+  posClsfd.clear();
+
+  CScaleParams sclprms;
+  double scaled_for = -1;
+  CIntVector& matches = m_matches;
+  for (int wcnt=0; wcnt<num_windows; wcnt++) {
+    const CScanWindow& window = windows[wcnt];
+    CScanWindowResult& result = results[wcnt];
+    result = CScanWindowResult();
+    if (window.scale<1.0) {
+      throw ITException("window scale must be at least 1.0");
+    }
+
+    if (window.scale!=scaled_for) {
+      InitScaleParams(cascade, window.scale, sclprms);
+      cascade.ScaleFeaturesEvenly(sclprms.actual_scale_x, 
+                                  sclprms.actual_scale_y,
+                                  sclprms.scaled_template_width, 
+                                  sclprms.scaled_template_height);
+      scaled_for = window.scale;
+    }
+
+    int left = window.left;
+    int top = window.top;
+    int right = left+sclprms.scaled_template_width;
+    int bottom = top+sclprms.scaled_template_height;
+    bool is_valid = false;
+    for (int acnt=0; acnt<(int)integrated_areas.size() && !is_valid; acnt++) {
+      const CRect& area = integrated_areas[acnt];
+      is_valid = 
+        max(0, area.left)<=left && max(0, area.top)<=top
+        && right<=min(area.right, integral.GetWidth())
+        && bottom<=min(area.bottom, integral.GetHeight());
+    }
+    if (!is_valid) {
+      continue;
+    }
+
+    double N = sclprms.scaled_template_width * sclprms.scaled_template_height;
+    double sum_x = 
+      integral.GetElement(right-1, bottom-1) 
+      - integral.GetElement(right-1, top-1)
+      - integral.GetElement(left-1, bottom-1)
+      + integral.GetElement(left-1, top-1);
+    double mean =
+      sum_x / N;
+    double sum_x2 = 
+      squared_integral.GetElement(right-1, bottom-1) 
+      - squared_integral.GetElement(right-1, top-1)
+      - squared_integral.GetElement(left-1, bottom-1)
+      + squared_integral.GetElement(left-1, top-1);
+    double stddev = sqrt(fabs(mean*mean - sum_x2/N));
+
+    matches.clear();
+    result.confidence =
+      cascade.EvaluateConfidence(integral, mean, stddev, left, top, matches);
+    if (matches.size()>0) {
+      result.accepted = true;
+      result.name_id = matches[0];
+      for (int m=0; m<(int)matches.size(); m++) {
+        posClsfd.push_back(CScanMatch(left, top, right, bottom,
+                                      sclprms.base_scale,
+                                      sclprms.scale_x, sclprms.scale_y,
+                                      matches[m]));
+      }
+    }
+  }
+  matches.clear();
 
   if (m_post_process) {
     PostProcess(posClsfd);
-    return (int) posClsfd.size();
-  } else {
-    return scancnt;
   }
 }
 
@@ -303,7 +751,7 @@ void CImageScanner::PostProcess(CScanMatchVector& posClsfd) const
 	if (num_matches<2) return;
 
 	// partition all matches into disjoint clusters
-	CIntVector clustnums;
+	CIntVector& clustnums = m_clustnums;
 	clustnums.resize(num_matches);
 	clustnums[0] = 0;
 	int num_clusters = 1;
@@ -369,7 +817,7 @@ void CImageScanner::PostProcess(CScanMatchVector& posClsfd) const
 	}
 
 	// patch holes in cluster numbering
-	CIntVector elements;
+	CIntVector& elements = m_cluster_sizes;
 	elements.resize(num_clusters);
 	for (int e=0; e<num_clusters; e++) elements[e] = 0;
 	for (int mcnt=0; mcnt<num_matches; mcnt++) {
@@ -427,8 +875,15 @@ void CImageScanner::PostProcess(CScanMatchVector& posClsfd) const
 void CImageScanner::InitScaleParams(const CClassifierCascade& cascade,
 				    CScaleParams& params) const
 {
-  ASSERT(m_start_scale>=1.0);
   ASSERT(m_scale_inc_factor>1.0);
+  InitScaleParams(cascade, m_start_scale, params);
+}
+
+void CImageScanner::InitScaleParams(const CClassifierCascade& cascade,
+				    double base_scale,
+				    CScaleParams& params) const
+{
+  ASSERT(base_scale>=1.0);
   ASSERT(m_translation_inc_x>=1);
   ASSERT(m_translation_inc_y>=1);
 
@@ -442,17 +897,17 @@ void CImageScanner::InitScaleParams(const CClassifierCascade& cascade,
   double template_ratio = (double)params.template_width/(double)params.template_height;
   if (image_area_ratio<template_ratio) { 
     // image area is narrower than template, stretch template in height
-    params.scale_x = m_start_scale;
-    params.scale_y = m_start_scale*template_ratio/image_area_ratio;
+    params.scale_x = base_scale;
+    params.scale_y = base_scale*template_ratio/image_area_ratio;
   } else { 
     // stretch template width
-    params.scale_x = m_start_scale*image_area_ratio/template_ratio;
-    params.scale_y = m_start_scale;
+    params.scale_x = base_scale*image_area_ratio/template_ratio;
+    params.scale_y = base_scale;
   }
   ASSERT(params.scale_x>=1.0);
   ASSERT(params.scale_y>=1.0);
 
-  params.base_scale = m_start_scale;
+  params.base_scale = base_scale;
 
   params.scaled_template_width = (int) (params.scale_x*params.template_width);
   params.scaled_template_height = (int) (params.scale_y*params.template_height);
@@ -64,6 +64,7 @@
 #define __SCANNER_H
 
 #include "IntegralImage.h"
+#include "Cascade.h"
 #ifdef HAVE_FLOAT_H
 #include <float.h>
 #endif
@@ -76,31 +77,88 @@ class CScanMatch {
 public:
   CScanMatch() 
     : left(-1), top(-1), right(-1), bottom(-1),
-    scale(-1), scale_x(-1), scale_y(-1), name("") {};
+    scale(-1), scale_x(-1), scale_y(-1), name_id(-1) {};
   CScanMatch(int _left, int _top, int _right, int _bottom,
-             double _scale, double _scale_x, double _scale_y, string _name) 
+             double _scale, double _scale_x, double _scale_y, int _name_id) 
     : left(_left), top(_top), right(_right), bottom(_bottom), 
-      scale(_scale), scale_x(_scale_x), scale_y(_scale_y), name(_name) {};
+      scale(_scale), scale_x(_scale_x), scale_y(_scale_y), name_id(_name_id) {};
 
   CRect AsRect() const { return CRect(left, top, right, bottom); }
 
   int         left, top, right, bottom;
   double      scale, scale_x, scale_y;
-  string      name;
+  int         name_id;  // see CClassifierCascade::GetMatchName
 };
 #endif // CScanMatch_DEFINED
 
 typedef vector<CScanMatch> CScanMatchVector;
 typedef vector<CScanMatchVector> CScanMatchMatrix;
 
-class CClassifierCascade;
+// a single window for CImageScanner::EvaluateWindows, the scale
+// has the same meaning as CScanMatch::scale
+class CScanWindow {
+public:
+  CScanWindow() : left(-1), top(-1), scale(-1) {};
+  CScanWindow(int _left, int _top, double _scale)
+    : left(_left), top(_top), scale(_scale) {};
+
+  int         left, top;
+  double      scale;
+};
+
+typedef vector<CScanWindow> CScanWindowVector;
+
+// outcome of evaluating one CScanWindow
+class CScanWindowResult {
+public:
+  CScanWindowResult() 
+    : accepted(false), confidence(0), name_id(-1) {};
+
+  bool        accepted;
+  double      confidence;  // 0..1, 1 if accepted
+  int         name_id;     // first match, -1 if not accepted
+};
+
+typedef vector<CScanWindowResult> CScanWindowResultVector;
+
+// what CImageScanner::Scan will do at one scale; the cost is in units
+// of CStrongClassifier::GetComputeCost
+class CScanPlanScale {
+public:
+  CScanPlanScale()
+    : scale(-1), width(-1), height(-1), num_windows(0), cost(0) {};
+
+  double      scale;          // same as CScanMatch::scale
+  int         width, height;  // of the windows
+  int         num_windows;
+  double      cost;           // expected, of all windows
+};
+
+typedef vector<CScanPlanScale> CScanPlanScaleVector;
+
 class CScaleParams;
+class CImageScanner;
+typedef vector<CImageScanner> CScannerVector;
+
+// the scan prior is kept on a grid of this many cells over the image;
+// ordered scans visit the cells in the order of their priority, in
+// a few passes
+#define SCAN_PRIOR_CELLS_X 8
+#define SCAN_PRIOR_CELLS_Y 6
+#define SCAN_NUM_PASSES 3
 
 // ----------------------------------------------------------------------
 // class CImageScanner
 // ----------------------------------------------------------------------
 
 class CImageScanner {
+ public:
+  enum ScanOrder {
+    SCAN_ORDER_RASTER = 0,      // row by row, one scale after the other
+    SCAN_ORDER_CENTER_OUT = 1,  // scan area center first
+    SCAN_ORDER_PRIOR = 2        // where AddPrior put most weight first
+  };
+
  public:
   CImageScanner();
   CImageScanner(const CImageScanner& src);
@@ -130,6 +188,10 @@ class CImageScanner {
   void GetScaleSizes(int* min_width, int* max_width,
 		     int* min_height, int* max_height) const;
   void SetAutoPostProcessing(bool on=true);
+  void SetScanOrder(ScanOrder order, int max_matches=0);
+  void GetScanOrder(ScanOrder* pOrder, int* pMax_matches) const;
+  void AddPrior(const CRect& area, int image_width, int image_height);
+  void ClearPrior();
   int Scan(const CClassifierCascade& cascade,
 	   const CByteImage& image,
 	   CScanMatchVector& matches) const;
@@ -137,6 +199,27 @@ class CImageScanner {
 	   const CIntegralImage& integral,
 	   const CIntegralImage& squared_integral,
 	   CScanMatchVector& matches) const;
+  void EvaluateWindows(const CClassifierCascade& cascade,
+                       const CIntegralImage& integral,
+                       const CIntegralImage& squared_integral,
+                       const CRectVector& integrated_areas,
+                       const CScanWindowVector& windows,
+                       CScanWindowResultVector& results,
+                       CScanMatchVector& matches) const;
+  CRect GetWindowRect(const CClassifierCascade& cascade,
+                      const CScanWindow& window) const;
+  bool CanScanTogether(const CClassifierCascade& cascade,
+                       const CImageScanner& other,
+                       const CClassifierCascade& other_cascade) const;
+  static void ScanTogether(const CScannerVector& scanners,
+                           const CCascadeVector& cascades,
+                           const CIntVector& which,
+                           const CIntegralImage& integral,
+                           const CIntegralImage& squared_integral,
+                           CScanMatchMatrix& matches);
+  double GetScanPlan(const CClassifierCascade& cascade,
+                     int image_width, int image_height,
+                     CScanPlanScaleVector& plan) const;
   void PostProcess(CScanMatchVector& posClsfd) const;
   bool IsActive() const {return m_is_active;};
   void SetActive(bool active=true) {m_is_active = active;}
@@ -151,9 +234,17 @@ class CImageScanner {
   ostream& output(ostream& os) const;
 
 protected:
+  int ScanPass(const CClassifierCascade& cascade,
+               const CIntegralImage& integral,
+               const CIntegralImage& squared_integral,
+               int pass,
+               CScanMatchVector& posClsfd, bool* pDone) const;
+  void OrderRegions(int image_width, int image_height) const;
   void NextScaleParams(CScaleParams& params) const;
   void InitScaleParams(const CClassifierCascade& cascade,
 		       CScaleParams& params) const;
+  void InitScaleParams(const CClassifierCascade& cascade,
+		       double base_scale, CScaleParams& params) const;
 
   friend class CScaleParams;
   
@@ -166,6 +257,9 @@ protected:
   CRect                       m_scan_area;
   bool                        m_post_process;
   bool                        m_is_active;
+  ScanOrder                   m_scan_order;
+  int                         m_max_matches;  // 0: no limit
+  CDoubleVector               m_prior;        // per grid cell
   mutable int                 m_min_scaled_template_width;
   mutable int                 m_max_scaled_template_width;
   mutable int                 m_min_scaled_template_height;
@@ -174,10 +268,15 @@ protected:
   // local buffer
   mutable CIntegralImage      m_integral;
   mutable CIntegralImage      m_squared_integral;
+  // kept between scans so that their memory gets reused
+  mutable CIntVector          m_matches;
+  mutable CIntVector          m_clustnums;
+  mutable CIntVector          m_cluster_sizes;
+  mutable CIntVector          m_region_order;
+  mutable CDoubleVector       m_region_keys;
+  mutable CIntVector          m_cell_pass;
 };
 
-typedef vector<CImageScanner> CScannerVector;
-
 ostream& operator<<(ostream& os, const CImageScanner& scanner);
 
 
@@ -212,6 +311,9 @@ protected:
   friend void CImageScanner::NextScaleParams(CScaleParams& params) const;
   friend void CImageScanner::InitScaleParams(const CClassifierCascade& cascade,
 					     CScaleParams& params) const;
+  friend void CImageScanner::InitScaleParams(const CClassifierCascade& cascade,
+					     double base_scale,
+					     CScaleParams& params) const;
 };
 
 //} // namespace cubicles
@@ -0,0 +1,371 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// Trace.cpp: spans of time for the Chrome trace viewer
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+#include "cubicles.hpp"
+#include "cubicles.h"
+#include "Trace.h"
+#include "Exceptions.h"
+#include <stdio.h>
+
+#if defined(WIN32)
+#define CU_TRACE_BARRIER() MemoryBarrier()
+#else // WIN32
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#define CU_TRACE_BARRIER() __sync_synchronize()
+#endif // WIN32
+
+#ifdef _DEBUG
+#ifdef USE_MFC
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif // USE_MFC
+#endif // _DEBUG
+
+
+volatile bool g_cu_tracing = false;
+
+// one span
+class CTraceEvent {
+ public:
+  const char*             name;
+  const char*             arg_name;
+  double                  arg;
+  double                  start;
+  double                  duration;
+};
+
+typedef vector<CTraceEvent> CTraceEventVector;
+
+// the spans of one thread.  Only that thread writes it, without a
+// lock; the slot of span number n is n%CU_TRACE_BUFFER_SIZE, and
+// m_num_recorded tells the readers which spans are complete
+class CTraceBuffer {
+ public:
+  CTraceBuffer(int id) : m_id(id), m_num_recorded(0) {}
+
+  int                     m_id;
+  volatile unsigned int   m_num_recorded;
+  CTraceEvent             m_events[CU_TRACE_BUFFER_SIZE];
+};
+
+typedef vector<CTraceBuffer*> CTraceBufferVector;
+
+// all buffers, and the file that is being written; the lock is taken
+// once per thread, when it records its first span, and by the writer.
+// The buffers are never freed since the writer may be reading them;
+// those of exited threads are free for new threads instead, which
+// keep recording after their spans
+static CTraceBufferVector g_cu_trace_buffers;
+static CTraceBufferVector g_cu_trace_free_buffers;
+static CU_THREAD_LOCAL CTraceBuffer* g_cu_trace_buffer = NULL;
+#if defined(WIN32)
+static CRITICAL_SECTION g_cu_trace_lock;
+static bool g_cu_trace_lock_initialized = false;
+#else // WIN32
+static pthread_mutex_t g_cu_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_cu_trace_writer;
+static bool g_cu_trace_writing = false;
+// its destructor returns the buffer of an exiting thread
+static pthread_key_t g_cu_trace_key;
+static pthread_once_t g_cu_trace_key_once = PTHREAD_ONCE_INIT;
+#endif // WIN32
+
+
+/** before spans can be recorded or written, so only the
+* application's thread calls it
+*/
+static void cuTraceInitLock()
+{
+#if defined(WIN32)
+  if (!g_cu_trace_lock_initialized) {
+    InitializeCriticalSection(&g_cu_trace_lock);
+    g_cu_trace_lock_initialized = true;
+  }
+#endif // WIN32
+}
+
+static void cuTraceLock()
+{
+#if defined(WIN32)
+  EnterCriticalSection(&g_cu_trace_lock);
+#else // WIN32
+  pthread_mutex_lock(&g_cu_trace_lock);
+#endif // WIN32
+}
+
+static void cuTraceUnlock()
+{
+#if defined(WIN32)
+  LeaveCriticalSection(&g_cu_trace_lock);
+#else // WIN32
+  pthread_mutex_unlock(&g_cu_trace_lock);
+#endif // WIN32
+}
+
+#if !defined(WIN32)
+static void cuTraceReturnBuffer(void* arg)
+{
+  cuTraceLock();
+  g_cu_trace_free_buffers.push_back((CTraceBuffer*) arg);
+  cuTraceUnlock();
+}
+
+static void cuTraceCreateKey()
+{
+  pthread_key_create(&g_cu_trace_key, cuTraceReturnBuffer);
+}
+#endif // WIN32
+
+/** a free buffer, or a new one; threads on WIN32 keep theirs
+*/
+static CTraceBuffer* cuTraceGetBuffer()
+{
+  cuTraceLock();
+  CTraceBuffer* buffer;
+  if (g_cu_trace_free_buffers.empty()) {
+    buffer = new CTraceBuffer((int) g_cu_trace_buffers.size()+1);
+    g_cu_trace_buffers.push_back(buffer);
+  } else {
+    buffer = g_cu_trace_free_buffers.back();
+    g_cu_trace_free_buffers.pop_back();
+  }
+  cuTraceUnlock();
+#if !defined(WIN32)
+  pthread_once(&g_cu_trace_key_once, cuTraceCreateKey);
+  pthread_setspecific(g_cu_trace_key, buffer);
+#endif // WIN32
+  return buffer;
+}
+
+/** micro-seconds of the monotonic clock, or of the time of day
+*/
+static double cuTraceNow()
+{
+#if defined(WIN32)
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double) count.QuadPart*1000000.0/(double) frequency.QuadPart;
+#else // WIN32
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)==0) {
+    return (double) ts.tv_sec*1000000.0 + (double) ts.tv_nsec/1000.0;
+  }
+#endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec*1000000.0 + (double) tv.tv_usec;
+#endif // WIN32
+}
+
+
+void CuTraceSpan::Begin(const char* name, const char* arg_name, double arg)
+{
+  m_name = name;
+  m_arg_name = arg_name;
+  m_arg = arg;
+  m_start = cuTraceNow();
+}
+
+void CuTraceSpan::End()
+{
+  double end = cuTraceNow();
+  CTraceBuffer* buffer = g_cu_trace_buffer;
+  if (buffer==NULL) {
+    buffer = cuTraceGetBuffer();
+    g_cu_trace_buffer = buffer;
+  }
+  unsigned int num = buffer->m_num_recorded;
+  CTraceEvent& event = buffer->m_events[num % CU_TRACE_BUFFER_SIZE];
+  event.name = m_name;
+  event.arg_name = m_arg_name;
+  event.arg = m_arg;
+  event.start = m_start;
+  event.duration = end-m_start;
+  // the span must be complete before it is counted
+  CU_TRACE_BARRIER();
+  buffer->m_num_recorded = num+1;
+}
+
+
+/** copies the complete spans of the buffer, while its thread may
+* record more: those whose slots it may have reused meanwhile are
+* left out
+*/
+static void cuTraceCopy(const CTraceBuffer* buffer, CTraceEventVector& events)
+{
+  unsigned int num_before = buffer->m_num_recorded;
+  CU_TRACE_BARRIER();
+  unsigned int first = 0;
+  if (num_before>CU_TRACE_BUFFER_SIZE) {
+    first = num_before-CU_TRACE_BUFFER_SIZE;
+  }
+  events.clear();
+  for (unsigned int num=first; num<num_before; num++) {
+    events.push_back(buffer->m_events[num % CU_TRACE_BUFFER_SIZE]);
+  }
+  CU_TRACE_BARRIER();
+  unsigned int num_after = buffer->m_num_recorded;
+  // while recording span n, the thread overwrites span n-size
+  unsigned int valid = num_after+1>CU_TRACE_BUFFER_SIZE
+    ? num_after+1-CU_TRACE_BUFFER_SIZE : 0;
+  if (valid>first) {
+    unsigned int num_invalid = min(valid-first, num_before-first);
+    events.erase(events.begin(), events.begin()+num_invalid);
+  }
+}
+
+/** writes all buffers' spans to the file and closes it
+*/
+static void cuTraceWrite(FILE* fp)
+{
+  cuTraceLock();
+  CTraceBufferVector buffers = g_cu_trace_buffers;
+  cuTraceUnlock();
+
+  fprintf(fp, "{\"traceEvents\":[\n");
+  bool first = true;
+  CTraceEventVector events;
+  for (int b=0; b<(int)buffers.size(); b++) {
+    int tid = buffers[b]->m_id;
+    fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            first ? "" : ",\n", tid, tid);
+    first = false;
+    cuTraceCopy(buffers[b], events);
+    for (int e=0; e<(int)events.size(); e++) {
+      const CTraceEvent& event = events[e];
+      fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+              "\"ts\":%.1f,\"dur\":%.1f", event.name, tid,
+              event.start, event.duration);
+      if (event.arg_name) {
+        fprintf(fp, ",\"args\":{\"%s\":%g}", event.arg_name, event.arg);
+      }
+      fprintf(fp, "}");
+    }
+  }
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(fp);
+}
+
+#if !defined(WIN32)
+static void* cuTraceWriterMain(void* arg)
+{
+  cuTraceWrite((FILE*) arg);
+  return NULL;
+}
+#endif // WIN32
+
+/** waits until the previous cuWriteTrace is done
+*/
+static void cuTraceJoinWriter()
+{
+#if !defined(WIN32)
+  if (g_cu_trace_writing) {
+    pthread_join(g_cu_trace_writer, NULL);
+    g_cu_trace_writing = false;
+  }
+#endif // WIN32
+}
+
+void cuSetTracing(bool on)
+{
+  cuTraceInitLock();
+  g_cu_tracing = on;
+}
+
+bool cuIsTracing()
+{
+  return g_cu_tracing;
+}
+
+void cuWriteTrace(const string& filename)
+{
+  CV_FUNCNAME( "cuWriteTrace" ); // declare cvFuncName
+  __BEGIN__;
+  cuTraceInitLock();
+  cuTraceJoinWriter();
+  FILE* fp = fopen(filename.c_str(), "w");
+  if (fp==NULL) {
+    CV_ERROR(CV_StsError, (string("can not open trace file ")
+                           + filename).c_str());
+  }
+#if defined(WIN32)
+  cuTraceWrite(fp);
+#else // WIN32
+  if (pthread_create(&g_cu_trace_writer, NULL, cuTraceWriterMain, fp)!=0) {
+    // write it here instead
+    cuTraceWrite(fp);
+  } else {
+    g_cu_trace_writing = true;
+  }
+#endif // WIN32
+  __END__;
+}
+
+/** called from cuUninitialize
+*/
+void cuTraceWaitWritten()
+{
+  cuTraceJoinWriter();
+}
@@ -0,0 +1,104 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// Trace.h: spans of time that are recorded per thread for
+// cuWriteTrace, see cubicles.h; has no dependencies so that the core
+// files can record spans
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+#if !defined(__TRACE_H_INCLUDED_)
+#define __TRACE_H_INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <stddef.h>
+
+
+extern volatile bool g_cu_tracing;
+
+#define CU_TRACE_BUFFER_SIZE 32768
+
+/** a span from construction to destruction; name and arg_name must
+ *  be string constants, the optional argument is shown with the span
+ */
+class CuTraceSpan {
+ public:
+  CuTraceSpan(const char* name, const char* arg_name=NULL, double arg=0)
+    : m_name(NULL)
+    { if (g_cu_tracing) Begin(name, arg_name, arg); }
+  ~CuTraceSpan() { if (m_name) End(); }
+
+ protected:
+  void Begin(const char* name, const char* arg_name, double arg);
+  void End();
+
+ protected:
+  const char*        m_name;      // NULL if not recording
+  const char*        m_arg_name;
+  double             m_arg;
+  double             m_start;
+
+ private:
+  // not to be copied
+  CuTraceSpan(const CuTraceSpan&);
+  CuTraceSpan& operator=(const CuTraceSpan&);
+};
+
+
+#endif // __TRACE_H_INCLUDED_
@@ -0,0 +1,253 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// WorkerPool.cpp: implementation of the CWorkerPool class.
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+#include "cubicles.hpp"
+#include "WorkerPool.h"
+#include "Exceptions.h"
+#include <exception>
+
+#ifdef _DEBUG
+#ifdef USE_MFC
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif // USE_MFC
+#endif // _DEBUG
+
+
+// ----------------------------------------------------------------------
+// class CWorkerPool
+// ----------------------------------------------------------------------
+
+CWorkerPool::CWorkerPool()
+  : m_num_threads(1),
+    m_fun(NULL),
+    m_arg(NULL),
+    m_num_tasks(0),
+    m_next_task(0),
+    m_num_unfinished(0),
+    m_stop(false),
+    m_failed(false)
+{
+#if defined(WORKERPOOL_PTHREADS)
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_work_cond, NULL);
+  pthread_cond_init(&m_done_cond, NULL);
+#endif // WORKERPOOL_PTHREADS
+}
+
+CWorkerPool::~CWorkerPool()
+{
+  StopThreads();
+#if defined(WORKERPOOL_PTHREADS)
+  pthread_cond_destroy(&m_done_cond);
+  pthread_cond_destroy(&m_work_cond);
+  pthread_mutex_destroy(&m_mutex);
+#endif // WORKERPOOL_PTHREADS
+}
+
+/** num_threads includes the calling thread, so 1 (or less) runs all
+* tasks in the calling thread
+*/
+void CWorkerPool::SetNumThreads(int num_threads)
+{
+  if (num_threads<1) num_threads = 1;
+  if (num_threads==m_num_threads) return;
+  StopThreads();
+#if defined(WORKERPOOL_PTHREADS)
+  m_stop = false;
+  for (int tcnt=1; tcnt<num_threads; tcnt++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, WorkerMain, this)!=0) {
+      StopThreads();
+      throw ITException("can not start worker thread");
+    }
+    m_threads.push_back(thread);
+  }
+  m_num_threads = num_threads;
+#endif // WORKERPOOL_PTHREADS
+}
+
+void CWorkerPool::StopThreads()
+{
+#if defined(WORKERPOOL_PTHREADS)
+  pthread_mutex_lock(&m_mutex);
+  m_stop = true;
+  pthread_cond_broadcast(&m_work_cond);
+  pthread_mutex_unlock(&m_mutex);
+  for (int tcnt=0; tcnt<(int)m_threads.size(); tcnt++) {
+    pthread_join(m_threads[tcnt], NULL);
+  }
+  m_threads.clear();
+#endif // WORKERPOOL_PTHREADS
+  m_num_threads = 1;
+}
+
+/** call fun(arg, task) for all tasks from 0 to num_tasks-1, in no
+* particular order and possibly concurrently; returns when all of
+* them are done, even if some of them threw.  Tasks may throw
+* anything: the remaining tasks still run, and afterwards the first
+* failure is thrown as an ITException with its message (or a generic
+* one for exceptions other than ITException and std::exception).
+* Run must not be called from several threads at once.
+*/
+void CWorkerPool::Run(TaskFun fun, void* arg, int num_tasks)
+{
+  if (m_num_threads==1 || num_tasks<=1) {
+    bool failed = false;
+    string error;
+    for (int task=0; task<num_tasks; task++) {
+      string task_error;
+      if (!RunTask(fun, arg, task, task_error) && !failed) {
+        failed = true;
+        error = task_error;
+      }
+    }
+    if (failed) {
+      throw ITException(error);
+    }
+    return;
+  }
+
+#if defined(WORKERPOOL_PTHREADS)
+  pthread_mutex_lock(&m_mutex);
+  m_fun = fun;
+  m_arg = arg;
+  m_num_tasks = num_tasks;
+  m_next_task = 0;
+  m_num_unfinished = num_tasks;
+  m_failed = false;
+  pthread_cond_broadcast(&m_work_cond);
+
+  while (m_next_task<m_num_tasks) {
+    RunNextTask();
+  }
+  while (m_num_unfinished>0) {
+    pthread_cond_wait(&m_done_cond, &m_mutex);
+  }
+  m_num_tasks = 0;
+  m_next_task = 0;
+  bool failed = m_failed;
+  string error = m_error;
+  pthread_mutex_unlock(&m_mutex);
+
+  if (failed) {
+    throw ITException(error);
+  }
+#endif // WORKERPOOL_PTHREADS
+}
+
+/** run one task and catch whatever it throws, so that neither a
+* worker thread nor Run is left by an exception; returns false and
+* sets error if the task threw
+*/
+bool CWorkerPool::RunTask(TaskFun fun, void* arg, int task, string& error)
+{
+  try {
+    fun(arg, task);
+    return true;
+  } catch (ITException& ite) {
+    error = ite.GetMessage();
+  } catch (exception& e) {
+    error = string("task failed: ") + e.what();
+  } catch (...) {
+    error = "task failed with an unknown exception";
+  }
+  return false;
+}
+
+#if defined(WORKERPOOL_PTHREADS)
+/** take the next task and run it; to be called with the mutex held,
+* which is released while the task runs and always taken again
+*/
+void CWorkerPool::RunNextTask()
+{
+  int task = m_next_task++;
+  pthread_mutex_unlock(&m_mutex);
+
+  string error;
+  bool failed = !RunTask(m_fun, m_arg, task, error);
+
+  pthread_mutex_lock(&m_mutex);
+  if (failed && !m_failed) {
+    m_failed = true;
+    m_error = error;
+  }
+  m_num_unfinished--;
+  if (m_num_unfinished==0) {
+    pthread_cond_signal(&m_done_cond);
+  }
+}
+
+void* CWorkerPool::WorkerMain(void* pool)
+{
+  CWorkerPool* pPool = (CWorkerPool*) pool;
+  pthread_mutex_lock(&pPool->m_mutex);
+  for (;;) {
+    while (!pPool->m_stop && pPool->m_next_task>=pPool->m_num_tasks) {
+      pthread_cond_wait(&pPool->m_work_cond, &pPool->m_mutex);
+    }
+    if (pPool->m_stop) break;
+    pPool->RunNextTask();
+  }
+  pthread_mutex_unlock(&pPool->m_mutex);
+  return NULL;
+}
+#endif // WORKERPOOL_PTHREADS
@@ -0,0 +1,126 @@
+/**
+  * cubicles
+  *
+  * This is an implementation of the Viola-Jones object detection 
+  * method and some extensions.  The code is mostly platform-
+  * independent and uses only standard C and C++ libraries.  It
+  * can make use of MPI for parallel training and a few Windows
+  * MFC functions for classifier display.
+  *
+  * Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * $Id$
+**/
+
+// WorkerPool runs a number of independent tasks on a few threads
+// that are kept around between calls.  The calling thread works on
+// the tasks, too.  Threads are only implemented with pthreads so
+// far; elsewhere, all tasks run in the calling thread.
+//
+
+////////////////////////////////////////////////////////////////////
+//
+// By downloading, copying, installing or using the software you 
+// agree to this license.  If you do not agree to this license, 
+// do not download, install, copy or use the software.
+//
+// Copyright (C) 2004, Mathias Kolsch, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in binary form, with or without 
+// modification, is permitted for non-commercial purposes only.
+// Redistribution in source, with or without modification, is 
+// prohibited without prior written permission.
+// If granted in writing in another document, personal use and 
+// modification are permitted provided that the following two
+// conditions are met:
+//
+// 1.Any modification of source code must retain the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer.
+//
+// 2.Redistribution's in binary form must reproduce the above 
+//   copyright notice, this list of conditions and the following 
+//   disclaimer in the documentation and/or other materials provided
+//   with the distribution.
+//
+// This software is provided by the copyright holders and 
+// contributors "as is" and any express or implied warranties, 
+// including, but not limited to, the implied warranties of 
+// merchantability and fitness for a particular purpose are 
+// disclaimed.  In no event shall the copyright holder or 
+// contributors be liable for any direct, indirect, incidental, 
+// special, exemplary, or consequential damages (including, but not 
+// limited to, procurement of substitute goods or services; loss of 
+// use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict 
+// liability, or tort (including negligence or otherwise) arising 
+// in any way out of the use of this software, even if advised of 
+// the possibility of such damage.
+//
+////////////////////////////////////////////////////////////////////
+
+
+#if !defined(__WORKERPOOL_H_INCLUDED_)
+#define __WORKERPOOL_H_INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <string>
+#include <vector>
+
+#include "Exceptions.h"
+
+#if !defined(WIN32)
+#define WORKERPOOL_PTHREADS
+#include <pthread.h>
+#endif // WIN32
+
+// ----------------------------------------------------------------------
+// class CWorkerPool
+// ----------------------------------------------------------------------
+
+class CWorkerPool {
+ public:
+  typedef void (*TaskFun)(void* arg, int task);
+
+  CWorkerPool();
+  ~CWorkerPool();
+
+  void SetNumThreads(int num_threads);
+  int GetNumThreads() const { return m_num_threads; }
+  void Run(TaskFun fun, void* arg, int num_tasks);
+
+ protected:
+  void StopThreads();
+  static bool RunTask(TaskFun fun, void* arg, int task, string& error);
+#if defined(WORKERPOOL_PTHREADS)
+  void RunNextTask();
+  static void* WorkerMain(void* pool);
+#endif // WORKERPOOL_PTHREADS
+
+ private:
+  // not to be copied
+  CWorkerPool(const CWorkerPool&);
+  CWorkerPool& operator=(const CWorkerPool&);
+
+  int                         m_num_threads;  // including the caller
+  TaskFun                     m_fun;
+  void*                       m_arg;
+  int                         m_num_tasks;
+  int                         m_next_task;
+  int                         m_num_unfinished;
+  bool                        m_stop;
+  bool                        m_failed;
+  string                      m_error;
+#if defined(WORKERPOOL_PTHREADS)
+  vector<pthread_t>           m_threads;
+  pthread_mutex_t             m_mutex;
+  pthread_cond_t              m_work_cond;   // new tasks or stop
+  pthread_cond_t              m_done_cond;   // all tasks finished
+#endif // WORKERPOOL_PTHREADS
+};
+
+#endif // !defined(__WORKERPOOL_H_INCLUDED_)
@@ -63,6 +63,11 @@
 #include "IntegralImage.h"
 #include "Cascade.h"
 #include "Scanner.h"
+#include "WorkerPool.h"
+#include <map>
+#if !defined(WIN32)
+#include <pthread.h>
+#endif // WIN32
 
 #if defined (IMG_LIB_OPENCV)
 #include "cubicles.h"
@@ -85,26 +90,163 @@ extern "C" {
 #endif
 
 //
-// global variables
+// the cascades that were loaded from files, shared by all contexts.
+// They are never scanned with, since scanning scales the features
+// of a cascade and keeps statistics; the contexts scan with copies.
+//
+class CCuModel {
+ public:
+  CCuModel(const string& fname) : filename(fname), refcount(0) {}
+
+  string                      filename;
+  CClassifierCascade          cascade;
+  int                         refcount;   // cascades loaded from it
+};
+
+typedef map<string, CCuModel*> CCuModelMap;
+typedef vector<CCuModel*> CCuModelVector;
+
+static CCuModelMap            g_cu_models;
+
+//
+// the state of scanning one stream of images; the cascades are
+// copies of the models, one per scanner
 //
-CCascadeVector                g_cu_cascades;
-CScannerVector                g_cu_scanners;
+struct _CuContext {
+  _CuContext() : image_width(-1), image_height(-1),
+                 min_width(-1), max_width(-1),
+                 min_height(-1), max_height(-1),
+                 keep_statistics(false) {}
+
+  CCascadeVector                cascades;
+  CCuModelVector                models;   // where cascades came from
+  CScannerVector                scanners;
+
+  CIntegralImage                integral;
+  CIntegralImage                squared_integral;
+  CScanMatchMatrix              events;
+  CRectVector                   integrated_areas;
+  CScanMatchVector              window_matches;
+  CScanWindowVector             windows;
+  CScanWindowResultVector       window_results;
+  CScanPlanScaleVector          plan_scales;
+  CWorkerPool                   workers;
+  CIntMatrix                    scan_groups;
+  CIntVector                    scan_tasks;
+  CDoubleVector                 scan_costs;
+
+  int                           image_width;
+  int                           image_height;
+  CRect                         bbox;
+
+  int                           min_width;
+  int                           max_width;
+  int                           min_height;
+  int                           max_height;
+
+  bool                          keep_statistics;
+};
+
+// threads that have not set a context of their own use the default
+static CuContext              g_cu_default_context;
+static CU_THREAD_LOCAL CuContext* g_cu_context = NULL;
+
+#if defined(WIN32)
+// initialized when the library is loaded, before any thread runs
+static class CCuModelsLock {
+ public:
+  CCuModelsLock() { InitializeCriticalSection(&section); }
+  CRITICAL_SECTION section;
+} g_cu_models_lock;
+#else // WIN32
+static pthread_mutex_t g_cu_models_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif // WIN32
+
+static CuContext& cuCurrentContext()
+{
+  return g_cu_context ? *g_cu_context : g_cu_default_context;
+}
+
+static void cuModelsLock()
+{
+#if defined(WIN32)
+  EnterCriticalSection(&g_cu_models_lock.section);
+#else // WIN32
+  pthread_mutex_lock(&g_cu_models_lock);
+#endif // WIN32
+}
+
+static void cuModelsUnlock()
+{
+#if defined(WIN32)
+  LeaveCriticalSection(&g_cu_models_lock.section);
+#else // WIN32
+  pthread_mutex_unlock(&g_cu_models_lock);
+#endif // WIN32
+}
 
-CIntegralImage                g_cu_integral;
-CIntegralImage                g_cu_squared_integral;
+/** the model of filename, which is parsed only if no context uses
+* it yet; the caller gets a reference.  Parsing is serialized, the
+* parser keeps its state in globals.
+*/
+static CCuModel* cuAcquireModel(const string& filename)
+{
+  cuModelsLock();
+  CCuModel* pModel = NULL;
+  CCuModelMap::iterator found = g_cu_models.find(filename);
+  if (found!=g_cu_models.end()) {
+    pModel = found->second;
+  } else {
+    pModel = new CCuModel(filename);
+    try {
+#if defined(WIN32)
+      pModel->cascade.ParseFrom(ConvertPathToWindows(filename).c_str());
+#else
+      pModel->cascade.ParseFrom(filename.c_str());
+#endif // WIN32
+      // evaluate strong classifiers that several branches share only once
+      pModel->cascade.ConvertFanToTree(1);
+    } catch (ITException&) {
+      delete pModel;
+      cuModelsUnlock();
+      throw;
+    }
+    g_cu_models[filename] = pModel;
+    VERBOSE1(3, "cubicles: loaded cascade %s", filename.c_str());
+  }
+  pModel->refcount++;
+  cuModelsUnlock();
+  return pModel;
+}
 
-int                           g_cu_image_width = -1;
-int                           g_cu_image_height = -1;
-CRect                         g_cu_bbox;
+static void cuReleaseModel(CCuModel* pModel)
+{
+  cuModelsLock();
+  pModel->refcount--;
+  if (pModel->refcount==0) {
+    g_cu_models.erase(pModel->filename);
+    delete pModel;
+  }
+  cuModelsUnlock();
+}
 
-int                           g_cu_min_width = -1;
-int                           g_cu_max_width = -1;
-int                           g_cu_min_height = -1;
-int                           g_cu_max_height = -1;
+/** drops the cascades and scanners of a context and its references
+* to their models
+*/
+static void cuClearCascades(CuContext& ctx)
+{
+  for (int mcnt=0; mcnt<(int)ctx.models.size(); mcnt++) {
+    cuReleaseModel(ctx.models[mcnt]);
+  }
+  ctx.models.clear();
+  ctx.cascades.clear();
+  ctx.scanners.clear();
+  ctx.events.clear();
+}
 
 // make sure cascadeID is typedef'ed as "unsigned int" or change this:
 #define CHECK_CASCADE_ID \
-  if (g_cu_cascades.size()<=cascadeID) { \
+  if (ctx.cascades.size()<=cascadeID) { \
     CV_ERROR(CV_StsBadArg, "invalid cascadeID"); \
   }
 
@@ -115,48 +257,105 @@ int                           g_cu_max_height = -1;
 void cuInitialize(int image_width, int image_height)
 {
   CV_FUNCNAME( "cuInitialize" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   if (image_width<0 || image_height<0) {
     CV_ERROR(CV_BadImageSize, "negative image width or height");
   }
   try {
-    g_cu_integral.SetSize(image_width, image_height);
-    g_cu_squared_integral.SetSize(image_width, image_height);
+    ctx.integral.SetSize(image_width, image_height);
+    ctx.squared_integral.SetSize(image_width, image_height);
+    ctx.integrated_areas.clear();
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
   }
   // this serves as "initialized" flag
-  g_cu_image_width = image_width;
-  g_cu_image_height = image_height;
+  ctx.image_width = image_width;
+  ctx.image_height = image_height;
   __END__;
 }
 
 /**
- * Uninitialize -- call for garbage collection of global variables;
- * they are all stack-allocated, so this is not really necessary
+ * Uninitialize -- call for garbage collection of the current
+ * context's variables; the default context is stack-allocated,
+ * so this is not really necessary
  */
 void cuUninitialize()
 {
   CV_FUNCNAME( "cuUninitialize" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
-  if (g_cu_image_width<0 || g_cu_image_height<0) {
+  if (ctx.image_width<0 || ctx.image_height<0) {
     CV_ERROR(CV_StsError, "cubicles not initialized");
   }
   // clear out memory
-  g_cu_cascades.clear();
-  g_cu_scanners.clear();
-  g_cu_integral.~CIntegralImage();
-  g_cu_squared_integral.~CIntegralImage();
+  cuClearCascades(ctx);
+  ctx.window_matches.clear();
+  ctx.windows.clear();
+  ctx.window_results.clear();
+  ctx.plan_scales.clear();
+  ctx.scan_groups.clear();
+  ctx.scan_tasks.clear();
+  ctx.scan_costs.clear();
+  ctx.workers.SetNumThreads(1);
+  cuTraceWaitWritten();
+  ctx.integrated_areas.clear();
+  ctx.integral.~CIntegralImage();
+  ctx.squared_integral.~CIntegralImage();
 
   // this serves as "initialized" flag
-  g_cu_image_width = -1;
-  g_cu_image_height = -1;
+  ctx.image_width = -1;
+  ctx.image_height = -1;
+  __END__;
+}
+
+CuContext* cuCreateContext()
+{
+  CuContext* pContext = NULL;
+  CV_FUNCNAME( "cuCreateContext" ); // declare cvFuncName
+  __BEGIN__;
+  try {
+    pContext = new CuContext;
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+  return pContext;
+}
+
+void cuReleaseContext(CuContext** ppContext)
+{
+  CV_FUNCNAME( "cuReleaseContext" ); // declare cvFuncName
+  __BEGIN__;
+  if (ppContext==NULL) {
+    CV_ERROR(CV_StsBadArg, "ppContext: invalid pointer");
+  }
+  if (*ppContext==NULL) {
+    EXIT;
+  }
+  if (g_cu_context==*ppContext) {
+    g_cu_context = NULL;
+  }
+  cuClearCascades(**ppContext);
+  delete *ppContext;
+  *ppContext = NULL;
   __END__;
 }
 
+void cuSetContext(CuContext* pContext)
+{
+  g_cu_context = pContext;
+}
+
+CuContext* cuGetContext()
+{
+  return g_cu_context;
+}
+
 void cuLoadCascade(const string& filename, CuCascadeID* pID)
 {
   CV_FUNCNAME( "cuLoadCascade" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   if (filename.length()==0) {
     CV_ERROR(CV_StsBadArg, "no file name specified");
@@ -165,17 +364,14 @@ void cuLoadCascade(const string& filename, CuCascadeID* pID)
     CV_ERROR(CV_StsBadArg, "pID: invalid pointer");
   }
   try {
-    CClassifierCascade cascade;
-#if defined(WIN32)
-    cascade.ParseFrom(ConvertPathToWindows(filename).c_str());
-#else
-    cascade.ParseFrom(filename.c_str());
-#endif // WIN32
-    
-    CuCascadeID cascadeID = (CuCascadeID) g_cu_cascades.size();
-    g_cu_cascades.push_back(cascade);
+    CCuModel* pModel = cuAcquireModel(filename);
+    // the model stays the same while others copy it
+    CuCascadeID cascadeID = (CuCascadeID) ctx.cascades.size();
+    ctx.models.push_back(pModel);
+    ctx.cascades.push_back(pModel->cascade);
+    ctx.cascades.back().SetKeepStatistics(ctx.keep_statistics);
     CImageScanner scanner;
-    g_cu_scanners.push_back(scanner);
+    ctx.scanners.push_back(scanner);
     *pID = cascadeID;
 
   } catch (ITException& ite) {
@@ -186,17 +382,52 @@ void cuLoadCascade(const string& filename, CuCascadeID* pID)
   __END__;
 }
 
+void cuReleaseCascades()
+{
+  cuClearCascades(cuCurrentContext());
+}
+
+void cuLoadMirroredCascade(CuCascadeID cascadeID, CuCascadeID* pID)
+{
+  CV_FUNCNAME( "cuLoadMirroredCascade" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  CHECK_CASCADE_ID;
+  if (pID==NULL) {
+    CV_ERROR(CV_StsBadArg, "pID: invalid pointer");
+  }
+  try {
+    CClassifierCascade cascade(ctx.cascades[cascadeID]);
+    cascade.Mirror();
+    CImageScanner scanner(ctx.scanners[cascadeID]);
+    // where the original found its objects says little about the mirror
+    scanner.ClearPrior();
+
+    CuCascadeID mirroredID = (CuCascadeID) ctx.cascades.size();
+    CCuModel* pModel = cuAcquireModel(ctx.models[cascadeID]->filename);
+    ctx.models.push_back(pModel);
+    ctx.cascades.push_back(cascade);
+    ctx.scanners.push_back(scanner);
+    *pID = mirroredID;
+
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
 void cuGetCascadeProperties(CuCascadeID cascadeID, CuCascadeProperties& cp)
 {
   CV_FUNCNAME( "cuGetCascadeProperties" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
     cp.cascadeID = cascadeID;
-    cp.names = g_cu_cascades[cascadeID].GetNames();
-    cp.template_width = g_cu_cascades[cascadeID].GetTemplateWidth();
-    cp.template_height = g_cu_cascades[cascadeID].GetTemplateHeight();
-    cp.image_area_ratio = g_cu_cascades[cascadeID].GetImageAreaRatio();
+    cp.names = ctx.cascades[cascadeID].GetNames();
+    cp.template_width = ctx.cascades[cascadeID].GetTemplateWidth();
+    cp.template_height = ctx.cascades[cascadeID].GetTemplateHeight();
+    cp.image_area_ratio = ctx.cascades[cascadeID].GetImageAreaRatio();
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
   }
@@ -208,11 +439,12 @@ void cuGetCascadeProperties(CuCascadeID cascadeID, CuCascadeProperties& cp)
 void cuGetScannerParameters(CuCascadeID cascadeID, CuScannerParameters& sp)
 {
   CV_FUNCNAME( "cuGetScannerParameters" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
     CRect area;
-    g_cu_scanners[cascadeID].GetScanParameters(&sp.start_scale,
+    ctx.scanners[cascadeID].GetScanParameters(&sp.start_scale,
                                             &sp.stop_scale,
                                             &sp.scale_inc_factor,
                                             &sp.translation_inc_x,
@@ -233,18 +465,19 @@ void cuGetScannerParameters(CuCascadeID cascadeID, CuScannerParameters& sp)
 void cuSetScannerParameters(CuCascadeID cascadeID, const CuScannerParameters& sp)
 {
   CV_FUNCNAME( "cuSetScannerParameters" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
     CRect area(sp.left, sp.top, sp.right, sp.bottom);
-    g_cu_scanners[cascadeID].SetActive(sp.active);
-    g_cu_scanners[cascadeID].SetScanParameters(sp.start_scale,
+    ctx.scanners[cascadeID].SetActive(sp.active);
+    ctx.scanners[cascadeID].SetScanParameters(sp.start_scale,
                                            sp.stop_scale,
                                            sp.scale_inc_factor,
                                            sp.translation_inc_x,
                                            sp.translation_inc_y,
                                            area);
-    g_cu_scanners[cascadeID].SetAutoPostProcessing(sp.post_process);
+    ctx.scanners[cascadeID].SetAutoPostProcessing(sp.post_process);
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
   }
@@ -254,10 +487,11 @@ void cuSetScannerParameters(CuCascadeID cascadeID, const CuScannerParameters& sp
 void cuSetScannerActive(CuCascadeID cascadeID, bool active)
 {
   CV_FUNCNAME( "cuSetScannerActive" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
-    g_cu_scanners[cascadeID].SetActive(active);
+    ctx.scanners[cascadeID].SetActive(active);
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
   }
@@ -267,11 +501,12 @@ void cuSetScannerActive(CuCascadeID cascadeID, bool active)
 void cuSetScanArea(CuCascadeID cascadeID, int left, int top, int right, int bottom)
 {
   CV_FUNCNAME( "cuSetScanArea" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
     CRect area(left, top, right, bottom);
-    g_cu_scanners[cascadeID].SetScanArea(area);
+    ctx.scanners[cascadeID].SetScanArea(area);
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
   }
@@ -281,10 +516,11 @@ void cuSetScanArea(CuCascadeID cascadeID, int left, int top, int right, int bott
 void cuSetScanScales(CuCascadeID cascadeID, double start_scale, double stop_scale)
 {
   CV_FUNCNAME( "cuSetScanScales" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   CHECK_CASCADE_ID;
   try {
-    g_cu_scanners[cascadeID].SetScanScales(start_scale,
+    ctx.scanners[cascadeID].SetScanScales(start_scale,
                                            stop_scale);
   } catch (ITException& ite) {
     CV_ERROR(CV_StsError, ite.GetMessage().c_str());
@@ -292,11 +528,127 @@ void cuSetScanScales(CuCascadeID cascadeID, double start_scale, double stop_scal
   __END__;
 }
 
+void cuSetScanOrder(CuCascadeID cascadeID, CuScanOrder order, int max_matches)
+{
+  CV_FUNCNAME( "cuSetScanOrder" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  CHECK_CASCADE_ID;
+  try {
+    ctx.scanners[cascadeID].SetScanOrder((CImageScanner::ScanOrder) order,
+                                          max_matches);
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
+void cuAddScanPrior(CuCascadeID cascadeID, int left, int top, int right, int bottom)
+{
+  CV_FUNCNAME( "cuAddScanPrior" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  CHECK_CASCADE_ID;
+  if (ctx.image_width<=0 || ctx.image_height<=0) {
+    CV_ERROR(CV_StsError, "cubicles has not been initialized");
+  }
+  try {
+    CRect area(left, top, right, bottom);
+    ctx.scanners[cascadeID].AddPrior(area, ctx.image_width, ctx.image_height);
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
+/** merge areas that overlap or touch into their bounding box, until
+* there is at least a one-pixel gap between any two of them, so that
+* they can be integrated separately
+*/
+static void cuMergeAreas(CRectVector& areas)
+{
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (int a=0; a<(int)areas.size() && !merged; a++) {
+      for (int b=a+1; b<(int)areas.size(); b++) {
+        CRect& ra = areas[a];
+        const CRect& rb = areas[b];
+        if (ra.left<=rb.right && rb.left<=ra.right
+            && ra.top<=rb.bottom && rb.top<=ra.bottom) {
+          ra.left = min(ra.left, rb.left);
+          ra.top = min(ra.top, rb.top);
+          ra.right = max(ra.right, rb.right);
+          ra.bottom = max(ra.bottom, rb.bottom);
+          areas.erase(areas.begin()+b);
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+/** one task of cuScan: scan with one group of active scanners;
+* arg is the context, which need not be current in worker threads
+*/
+static void cuScanTask(void* arg, int task)
+{
+  CuContext& ctx = *(CuContext*) arg;
+  const CIntVector& group = ctx.scan_groups[ctx.scan_tasks[task]];
+  CuTraceSpan span("scanner", "cascade", group[0]);
+  if (group.size()==1) {
+    int numc = group[0];
+    ctx.scanners[numc].Scan(ctx.cascades[numc],
+                             ctx.integral, ctx.squared_integral,
+                             ctx.events[numc]);
+  } else {
+    CImageScanner::ScanTogether(ctx.scanners, ctx.cascades, group,
+                                ctx.integral, ctx.squared_integral,
+                                ctx.events);
+  }
+}
+
+void cuSetNumThreads(int num_threads)
+{
+  CV_FUNCNAME( "cuSetNumThreads" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  if (num_threads<1) {
+    CV_ERROR(CV_StsBadArg, "need at least one thread");
+  }
+  try {
+    ctx.workers.SetNumThreads(num_threads);
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
+int cuGetNumThreads()
+{
+  return cuCurrentContext().workers.GetNumThreads();
+}
+
+void cuRunTasks(CuTaskFun fun, void* arg, int num_tasks)
+{
+  CV_FUNCNAME( "cuRunTasks" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  try {
+    ctx.workers.Run(fun, arg, num_tasks);
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
 void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
 {
   CV_FUNCNAME( "cuScan" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
-  if (g_cu_image_width<=0 || g_cu_image_height<=0) {
+  if (ctx.image_width<=0 || ctx.image_height<=0) {
     CV_ERROR(CV_StsError, "cubicles has not been initialized");
   }
   if (grayImage==NULL) {
@@ -311,12 +663,13 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
   if (grayImage->origin!=0) {
     CV_ERROR(CV_BadOrigin, "need image origin in top left corner");
   }
-  if (grayImage->width!=g_cu_image_width 
-      || grayImage->height!=g_cu_image_height) {
+  if (grayImage->width!=ctx.image_width 
+      || grayImage->height!=ctx.image_height) {
     CV_ERROR(CV_BadImageSize, "different from initialization");
   }
   try {
-    g_cu_bbox = CRect(-1, -1, -1, -1);
+    CuTraceSpan span("cuScan");
+    ctx.bbox = CRect(-1, -1, -1, -1);
     matches.clear();
 
     // todo: maybe sometime we should allow a maximum processing time
@@ -326,11 +679,11 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
     
     // find bounding box around all scanners' scan_areas and
     // integrate image only within that bbox
-    int num_cascades = (int) g_cu_cascades.size();
+    int num_cascades = (int) ctx.cascades.size();
     CRect bbox = CRect(INT_MAX, INT_MAX, 0, 0);
     for (int sc=0; sc<num_cascades; sc++) {
-      if (g_cu_scanners[sc].IsActive()) {
-        const CRect& scan_area = g_cu_scanners[sc].GetScanArea();
+      if (ctx.scanners[sc].IsActive()) {
+        const CRect& scan_area = ctx.scanners[sc].GetScanArea();
         if (scan_area.left<bbox.left) bbox.left = scan_area.left;
         if (scan_area.right>bbox.right) bbox.right = scan_area.right;
         if (scan_area.top<bbox.top) bbox.top = scan_area.top;
@@ -346,26 +699,102 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
       return;
     }
   
+    // integrate the image only within the scan areas; those that
+    // overlap or touch are integrated as one
+    CRectVector& areas = ctx.integrated_areas;
+    areas.clear();
+    for (int sc=0; sc<num_cascades; sc++) {
+      if (ctx.scanners[sc].IsActive()) {
+        const CRect& scan_area = ctx.scanners[sc].GetScanArea();
+        CRect area(max(0, scan_area.left), max(0, scan_area.top),
+                   min(scan_area.right, grayImage->width),
+                   min(scan_area.bottom, grayImage->height));
+        if (area.right-area.left>0 && area.bottom-area.top>0) {
+          areas.push_back(area);
+        }
+      }
+    }
+    cuMergeAreas(areas);
+
     CByteImage byteImage((BYTE*)grayImage->imageData,
                          grayImage->width,
                          grayImage->height);
-    CIntegralImage::CreateSimpleNSquaredFrom(byteImage,
-                                             g_cu_integral,
-                                             g_cu_squared_integral, bbox);
+    {
+      CuTraceSpan integrate_span("integrate");
+      CIntegralImage::CreateSimpleNSquaredFrom(byteImage,
+                                               ctx.integral,
+                                               ctx.squared_integral, areas);
+    }
     
-    int num_active = 0;
-    CScanMatchMatrix events;
+    // the per-cascade match vectors are kept from one scan to the
+    // next, so that scanning does not allocate memory once they are
+    // large enough
+    CScanMatchMatrix& events = ctx.events;
     events.resize(num_cascades);
+
+    // scanners that visit the same windows are scanned together;
+    // every group of them is one task, and with several threads,
+    // the most expensive ones are started first
+    CIntMatrix& groups = ctx.scan_groups;
+    CIntVector& tasks = ctx.scan_tasks;
+    CDoubleVector& costs = ctx.scan_costs;
+    int num_groups = 0;
     for (int numc=0; numc<num_cascades; numc++) {
-      if (g_cu_scanners[numc].IsActive()) {
-        num_active++;
-        ASSERT(g_cu_cascades[numc].GetNumStrongClassifiers()>0);
+      if (!ctx.scanners[numc].IsActive()) {
+        continue;
+      }
+      ASSERT(ctx.cascades[numc].GetNumStrongClassifiers()>0);
+      int group = 0;
+      for (; group<num_groups; group++) {
+        int first = groups[group][0];
+        if (ctx.scanners[first].CanScanTogether(ctx.cascades[first],
+                                                 ctx.scanners[numc],
+                                                 ctx.cascades[numc])) {
+          break;
+        }
+      }
+      if (group==num_groups) {
+        num_groups++;
+        if ((int)groups.size()<num_groups) {
+          groups.resize(num_groups);
+        }
+        groups[group].clear();
+      }
+      groups[group].push_back(numc);
+    }
+
+    tasks.clear();
+    costs.clear();
+    for (int group=0; group<num_groups; group++) {
+      double cost = 0;
+      if (ctx.workers.GetNumThreads()>1) {
+        for (int gcnt=0; gcnt<(int)groups[group].size(); gcnt++) {
+          int numc = groups[group][gcnt];
+          cost += ctx.scanners[numc].GetScanPlan(ctx.cascades[numc],
+                                                  grayImage->width,
+                                                  grayImage->height,
+                                                  ctx.plan_scales);
+        }
+      }
+      int pos = (int) tasks.size();
+      tasks.push_back(group);
+      costs.push_back(cost);
+      while (pos>0 && costs[pos-1]<cost) {
+        tasks[pos] = tasks[pos-1];
+        costs[pos] = costs[pos-1];
+        pos--;
+      }
+      tasks[pos] = group;
+      costs[pos] = cost;
+    }
 
-        // do the scan!
-        g_cu_scanners[numc].Scan(g_cu_cascades[numc],
-                                 g_cu_integral, g_cu_squared_integral,
-                                 events[numc]);
+    // do the scans!  They only share the integral images, which
+    // they don't modify
+    ctx.workers.Run(cuScanTask, &ctx, num_groups);
 
+    // merge the matches in cascade order
+    for (int numc=0; numc<num_cascades; numc++) {
+      if (ctx.scanners[numc].IsActive()) {
         // this is a bit awkward and really not elegant, but we avoid
         // exposing all sorts of internal structures
         for (CScanMatchVector::const_iterator cm = events[numc].begin();
@@ -373,7 +802,8 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
              cm++)
         {
           CuScanMatch m;
-          m.name = cm->name;
+          m.cascadeID = (CuCascadeID) numc;
+          m.name_id = cm->name_id;
           m.left = cm->left;
           m.top = cm->top;
           m.right = cm->right;
@@ -386,12 +816,12 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
 
 	// must be called after the actual scan, and the behavior with
 	// multiple active scanners is somewhat undetermined
-	g_cu_scanners[numc].GetScaleSizes(&g_cu_min_width, &g_cu_max_width, 
-					  &g_cu_min_height, &g_cu_max_height);
+	ctx.scanners[numc].GetScaleSizes(&ctx.min_width, &ctx.max_width, 
+					  &ctx.min_height, &ctx.max_height);
       }
     }
-    if (num_active>0) {
-      g_cu_bbox = bbox;
+    if (num_groups>0) {
+      ctx.bbox = bbox;
     }
     
   } catch (ITException& ite) {
@@ -400,17 +830,193 @@ void cuScan(const IplImage* grayImage, CuScanMatchVector& matches)
   __END__;
 } // Scan
 
+void cuEvaluateWindows(const IplImage* grayImage, CuCascadeID cascadeID,
+                       const CuScanWindowVector& windows,
+                       CuWindowResultVector& results,
+                       CuScanMatchVector& matches)
+{
+  CV_FUNCNAME( "cuEvaluateWindows" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  if (ctx.image_width<=0 || ctx.image_height<=0) {
+    CV_ERROR(CV_StsError, "cubicles has not been initialized");
+  }
+  CHECK_CASCADE_ID;
+  if (grayImage!=NULL) {
+    if (grayImage->nChannels!=1) {
+      CV_ERROR(CV_BadNumChannels, "can only scan gray-level images");
+    }
+    if (grayImage->depth!=IPL_DEPTH_8U) {
+      CV_ERROR(CV_BadDepth, "can only scan unsigned byte images");
+    }
+    if (grayImage->origin!=0) {
+      CV_ERROR(CV_BadOrigin, "need image origin in top left corner");
+    }
+    if (grayImage->width!=ctx.image_width 
+        || grayImage->height!=ctx.image_height) {
+      CV_ERROR(CV_BadImageSize, "different from initialization");
+    }
+  }
+  try {
+    results.clear();
+    matches.clear();
+    const CClassifierCascade& cascade = ctx.cascades[cascadeID];
+    const CImageScanner& scanner = ctx.scanners[cascadeID];
+    ASSERT(cascade.GetNumStrongClassifiers()>0);
+
+    int num_windows = (int) windows.size();
+    CScanWindowVector& cwindows = ctx.windows;
+    cwindows.resize(num_windows);
+    for (int wcnt=0; wcnt<num_windows; wcnt++) {
+      cwindows[wcnt] = CScanWindow(windows[wcnt].left, windows[wcnt].top,
+                                   windows[wcnt].scale);
+    }
+
+    if (grayImage!=NULL) {
+      // integrate only within the bounding box around all windows
+      CRect bbox = CRect(INT_MAX, INT_MAX, 0, 0);
+      for (int wcnt=0; wcnt<num_windows; wcnt++) {
+        CRect rect = scanner.GetWindowRect(cascade, cwindows[wcnt]);
+        if (rect.left<bbox.left) bbox.left = rect.left;
+        if (rect.right>bbox.right) bbox.right = rect.right;
+        if (rect.top<bbox.top) bbox.top = rect.top;
+        if (rect.bottom>bbox.bottom) bbox.bottom = rect.bottom;
+      }
+      bbox.left = max(0, bbox.left);
+      bbox.top = max(0, bbox.top);
+      bbox.right = min(bbox.right, grayImage->width);
+      bbox.bottom = min(bbox.bottom, grayImage->height);
+      if (bbox.right-bbox.left>0 && bbox.bottom-bbox.top>0) {
+        CByteImage byteImage((BYTE*)grayImage->imageData,
+                             grayImage->width,
+                             grayImage->height);
+        CIntegralImage::CreateSimpleNSquaredFrom(byteImage,
+                                                 ctx.integral,
+                                                 ctx.squared_integral, bbox);
+        ctx.integrated_areas.clear();
+        ctx.integrated_areas.push_back(bbox);
+      }
+    }
+
+    CScanWindowResultVector& cresults = ctx.window_results;
+    CScanMatchVector& cmatches = ctx.window_matches;
+    scanner.EvaluateWindows(cascade, ctx.integral, ctx.squared_integral,
+                            ctx.integrated_areas, cwindows, cresults, cmatches);
+
+    results.resize(num_windows);
+    for (int rcnt=0; rcnt<num_windows; rcnt++) {
+      results[rcnt].accepted = cresults[rcnt].accepted;
+      results[rcnt].confidence = cresults[rcnt].confidence;
+      results[rcnt].name_id = cresults[rcnt].name_id;
+    }
+    for (CScanMatchVector::const_iterator cm = cmatches.begin();
+         cm!=cmatches.end();
+         cm++)
+    {
+      CuScanMatch m;
+      m.cascadeID = cascadeID;
+      m.name_id = cm->name_id;
+      m.left = cm->left;
+      m.top = cm->top;
+      m.right = cm->right;
+      m.bottom = cm->bottom;
+      m.scale = cm->scale;
+      m.scale_x = cm->scale_x;
+      m.scale_y = cm->scale_y;
+      matches.push_back(m);
+    }
+
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+}
+
+double cuGetScanPlan(CuScanPlanVector& plans)
+{
+  double total_cost = 0;
+  CV_FUNCNAME( "cuGetScanPlan" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  if (ctx.image_width<=0 || ctx.image_height<=0) {
+    CV_ERROR(CV_StsError, "cubicles has not been initialized");
+  }
+  try {
+    plans.clear();
+    int num_cascades = (int) ctx.cascades.size();
+    for (int sc=0; sc<num_cascades; sc++) {
+      const CImageScanner& scanner = ctx.scanners[sc];
+      if (!scanner.IsActive()) {
+        continue;
+      }
+      plans.resize(plans.size()+1);
+      CuScanPlan& plan = plans.back();
+      plan.cascadeID = (CuCascadeID) sc;
+      plan.window_cost = ctx.cascades[sc].GetExpectedCost(&plan.measured);
+      plan.cost = scanner.GetScanPlan(ctx.cascades[sc], 
+                                      ctx.image_width, ctx.image_height,
+                                      ctx.plan_scales);
+      plan.num_windows = 0;
+      int num_scales = (int) ctx.plan_scales.size();
+      plan.scales.resize(num_scales);
+      for (int scl=0; scl<num_scales; scl++) {
+        const CScanPlanScale& from = ctx.plan_scales[scl];
+        CuScanPlanScale& to = plan.scales[scl];
+        to.scale = from.scale;
+        to.width = from.width;
+        to.height = from.height;
+        to.num_windows = from.num_windows;
+        to.cost = from.cost;
+        plan.num_windows += from.num_windows;
+      }
+      total_cost += plan.cost;
+    }
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+  return total_cost;
+}
+
+void cuSetScanStatistics(bool on)
+{
+  CuContext& ctx = cuCurrentContext();
+  ctx.keep_statistics = on;
+  for (int sc=0; sc<(int)ctx.cascades.size(); sc++) {
+    ctx.cascades[sc].SetKeepStatistics(on);
+  }
+}
+
+const string& cuGetMatchName(const CuScanMatch& match)
+{
+  static const string no_name("");
+  const string* pName = &no_name;
+  CV_FUNCNAME( "cuGetMatchName" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
+  __BEGIN__;
+  CuCascadeID cascadeID = match.cascadeID;
+  CHECK_CASCADE_ID;
+  try {
+    pName = &ctx.cascades[cascadeID].GetMatchName(match.name_id);
+  } catch (ITException& ite) {
+    CV_ERROR(CV_StsError, ite.GetMessage().c_str());
+  }
+  __END__;
+  return *pName;
+}
+
 void cuGetScannedArea(int* pLeft, int* pTop, int* pRight, int* pBottom)
 {
   CV_FUNCNAME( "cuGetScannedArea" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   if (pLeft==NULL || pTop==NULL || pRight==NULL || pBottom==NULL) {
     CV_ERROR(CV_StsBadArg, "null pointer");
   }
-  *pLeft = g_cu_bbox.left;
-  *pTop = g_cu_bbox.top;
-  *pRight = g_cu_bbox.right;
-  *pBottom = g_cu_bbox.bottom;
+  *pLeft = ctx.bbox.left;
+  *pTop = ctx.bbox.top;
+  *pRight = ctx.bbox.right;
+  *pBottom = ctx.bbox.bottom;
   __END__;
 }
 
@@ -418,15 +1024,16 @@ void cuGetScaleSizes(int* min_width, int* max_width,
 		     int* min_height, int* max_height)
 {
   CV_FUNCNAME( "cuGetScaleSizes" ); // declare cvFuncName
+  CuContext& ctx = cuCurrentContext();
   __BEGIN__;
   if (min_width==NULL || max_width==NULL ||
       min_height==NULL || max_height==NULL) {
     CV_ERROR(CV_StsBadArg, "null pointer");
   }
-  *min_width = g_cu_min_width;
-  *max_width = g_cu_max_width;
-  *min_height = g_cu_min_height;
-  *max_height = g_cu_max_height;
+  *min_width = ctx.min_width;
+  *max_width = ctx.max_width;
+  *min_height = ctx.min_height;
+  *max_height = ctx.max_height;
   __END__;
 }
 
@@ -67,6 +67,8 @@
 #include <vector>
 using namespace std;
 
+#include "Trace.h"
+
 
 
 #ifdef __cplusplus
@@ -93,19 +95,106 @@ typedef struct _CuScannerParameters {
 typedef struct _CuScanMatch {
   int                left, top, right, bottom;
   double             scale, scale_x, scale_y;
-  string             name;
+  CuCascadeID        cascadeID;
+  int                name_id;     // index into CuCascadeProperties.names
 } CuScanMatch;
 
 typedef vector<CuScanMatch> CuScanMatchVector;
 
+typedef struct _CuScanWindow {
+  int                left, top;
+  double             scale;       // same as CuScanMatch.scale
+} CuScanWindow;
+
+typedef vector<CuScanWindow> CuScanWindowVector;
+
+typedef struct _CuWindowResult {
+  bool               accepted;
+  double             confidence;  // 0..1, 1 if accepted
+  int                name_id;     // first match, -1 if not accepted
+} CuWindowResult;
+
+typedef vector<CuWindowResult> CuWindowResultVector;
+
+typedef struct _CuScanPlanScale {
+  double             scale;       // same as CuScanMatch.scale
+  int                width, height;
+  int                num_windows;
+  double             cost;        // expected, of all windows
+} CuScanPlanScale;
+
+typedef vector<CuScanPlanScale> CuScanPlanScaleVector;
+
+typedef struct _CuScanPlan {
+  CuCascadeID            cascadeID;
+  CuScanPlanScaleVector  scales;
+  int                    num_windows;
+  double                 window_cost; // expected cost of one window
+  bool                   measured;    // window_cost from pass rates 
+                                      // measured while scanning, rather 
+                                      // than from training
+  double                 cost;        // of all scales
+} CuScanPlan;
+
+typedef vector<CuScanPlan> CuScanPlanVector;
+
+typedef enum {
+  CU_SCAN_ORDER_RASTER = 0,       // row by row, one scale after the other
+  CU_SCAN_ORDER_CENTER_OUT = 1,   // scan area center first
+  CU_SCAN_ORDER_PRIOR = 2         // where cuAddScanPrior put most weight first
+} CuScanOrder;
+
 
 
 void cuInitialize(int image_width, int image_height);
 
 void cuUninitialize();
 
+/** A context is all state of scanning one stream of images: the
+ *  scanners, their cascades, the integral images and the threads.
+ *  All other functions work on the calling thread's current
+ *  context; threads that did not set one share a default context,
+ *  so that applications with a single stream need not bother.
+ *  cuInitialize must be called for every context.
+ *  Every cascade file is parsed once per process, no matter how
+ *  many contexts load it.  The contexts scan with copies of it,
+ *  though, since scanning scales the features of a cascade and
+ *  keeps statistics about the scene.
+ */
+typedef struct _CuContext CuContext;
+
+CuContext* cuCreateContext();
+
+/** releases the context and its cascades and sets *ppContext to
+ *  NULL; no other thread must be using it
+ */
+void cuReleaseContext(CuContext** ppContext);
+
+/** makes pContext the calling thread's current context, NULL the
+ *  default one
+ */
+void cuSetContext(CuContext* pContext);
+
+/** NULL if the calling thread uses the default context
+ */
+CuContext* cuGetContext();
+
 void cuLoadCascade(const string& filename, CuCascadeID* pID);
 
+/** removes all cascades and their scanners from the current context,
+ *  so that the next cuLoadCascade returns the first ID again
+ */
+void cuReleaseCascades();
+
+/** Add a horizontally mirrored copy of a loaded cascade, for example
+ *  to find left hands with a cascade that was trained on right hands.
+ *  The copy gets its own ID, the same names, and a scanner with the
+ *  parameters of the original's scanner.  cuScan evaluates it on the
+ *  same integral image as all other cascades, so finding the mirror
+ *  images costs only the evaluation of the copy.
+ */
+void cuLoadMirroredCascade(CuCascadeID cascadeID, CuCascadeID* pID);
+
 void cuGetCascadeProperties(CuCascadeID cascadeID, CuCascadeProperties& cp);
 
 void cuGetScannerParameters(CuCascadeID cascadeID, CuScannerParameters& sp);
@@ -118,18 +207,108 @@ void cuSetScanArea(CuCascadeID cascadeID, int left, int top, int right, int bott
 
 void cuSetScanScales(CuCascadeID cascadeID, double start_scale, double stop_scale);
 
+/** The order in which a cascade's scanner visits the windows.  If
+ *  max_matches is positive, its scan stops as soon as that many
+ *  matches were found, which is much faster if an object is found
+ *  early but finds only a subset of all matches.  Without a limit
+ *  all orders find the same matches; the non-raster orders are then
+ *  somewhat slower since they scale the features more often.
+ */
+void cuSetScanOrder(CuCascadeID cascadeID, CuScanOrder order, int max_matches);
+
+/** Record that an object was found in this area, so that scans with
+ *  CU_SCAN_ORDER_PRIOR look there first.
+ */
+void cuAddScanPrior(CuCascadeID cascadeID, int left, int top, int right, int bottom);
+
 void cuGetScaleSizes(int* min_width, int* max_width,
 		     int* min_height, int* max_height);
 
+/** cuScan runs the active scanners as independent tasks on this many
+ *  threads, including the calling one; the default is 1.  Every
+ *  context has threads of its own.  The
+ *  matches are reported in the same order regardless.  Not
+ *  available on WIN32 yet, where all scans run in the calling thread.
+ */
+void cuSetNumThreads(int num_threads);
+
+int cuGetNumThreads();
+
+/** runs fun(arg, task) for all tasks from 0 to num_tasks-1 on the
+ *  threads of cuScan, possibly concurrently, so that callers can use
+ *  them in between scans; returns when all are done.  The tasks must
+ *  not call into cubicles and should not throw; if one does anyway,
+ *  the others still run and the error is reported once all are done.
+ */
+typedef void (*CuTaskFun)(void* arg, int task);
+void cuRunTasks(CuTaskFun fun, void* arg, int num_tasks);
+
 /** Scan a gray-level image,
  *  returns the resulting matches in the ScanMatchVector
  */
 void cuScan(const IplImage* pImage, CuScanMatchVector& matches);
 
+/** Evaluate one cascade on the given windows only, rather than on
+ *  all windows of its scan area; windows with the same scale should
+ *  be adjacent.  If pImage is given, it is integrated within the
+ *  windows' bounding box first, otherwise the integral images of the
+ *  previous cuScan or cuEvaluateWindows call are used, and windows
+ *  that do not lie within one of the areas that were integrated
+ *  then are rejected.
+ *  results gets one entry per window, matches the matches of all
+ *  accepted windows like cuScan reports them.  The scanner of the
+ *  cascade need not be active; only its post_process flag is used.
+ */
+void cuEvaluateWindows(const IplImage* pImage, CuCascadeID cascadeID,
+                       const CuScanWindowVector& windows,
+                       CuWindowResultVector& results,
+                       CuScanMatchVector& matches);
+
+/** What cuScan would do on the next image with the current scanner
+ *  settings, for each active scanner: the scales, the number of
+ *  windows per scale, and the expected cost.  Costs are in units of
+ *  feature computations (see CIntegralFeature::GetComputeCost).  With
+ *  cuSetScanStatistics, they are based on how many windows passed
+ *  each stage of the cascade in earlier scans, so they follow the
+ *  scene; otherwise on the false positive rates from training.
+ *  Scaling the features to a new scale is not included.  Returns the
+ *  total cost.
+ */
+double cuGetScanPlan(CuScanPlanVector& plans);
+
+/** whether the cascades of the current context count how many windows
+ *  reach each of their stages, for cuGetScanPlan.  Off by default,
+ *  since that costs a few memory writes per window; turning it off
+ *  forgets the counts.
+ */
+void cuSetScanStatistics(bool on);
+
+/** the name of a match, same as CuCascadeProperties.names[match.name_id];
+ *  the string belongs to cubicles and is valid until the next call to
+ *  cuLoadCascade, cuReleaseCascades or cuUninitialize
+ */
+const string& cuGetMatchName(const CuScanMatch& match);
+
 /** *pLeft is set to -1 of no scanner was active
  */
 void cuGetScannedArea(int* pLeft, int* pTop, int* pRight, int* pBottom);
 
+/** Tracing: CuTraceSpans record spans of time into a buffer per
+ *  thread that keeps the most recent CU_TRACE_BUFFER_SIZE spans of
+ *  each thread.  cubicles traces the scans, every scanner and every
+ *  scale.  Off by default; while it is off, a span costs one test
+ *  of a flag.
+ */
+void cuSetTracing(bool on);
+bool cuIsTracing();
+
+/** writes the recorded spans to filename in the Chrome trace JSON
+ *  format (chrome://tracing, ui.perfetto.dev).  The file is written
+ *  in a thread of its own (not on WIN32); this returns once the file
+ *  was opened.  Times are micro-seconds of the monotonic clock.
+ */
+void cuWriteTrace(const string& filename);
+
 /** verbosity: 0 minimal, 3 maximal
 */
 void cuGetVersion(string& version, int verbosity);
@@ -138,5 +138,14 @@ using std::vector;
 
 #define CU_CURRENT_VERSION_STRING "cubicles version 1.4"
 
+#if defined(WIN32)
+#define CU_THREAD_LOCAL __declspec(thread)
+#else // WIN32
+#define CU_THREAD_LOCAL __thread
+#endif // WIN32
+
+// waits for the file that cuWriteTrace writes, in Trace.cpp
+void cuTraceWaitWritten();
+
 
 #endif // __CUBICLES_HPP_INCLUDED_
@@ -35,14 +35,29 @@ CubicleWrapper::CubicleWrapper()
     0.5f /* vscale */, 0.1f /*italic_scale */, 
     1 /* thickness */);
   m_bbox = CRect(-1, -1, -1, -1);
+  m_pContext = cuCreateContext();
+  if (m_pContext==NULL) {
+    throw HVException("can not create cubicles context");
+  }
 }
 
 CubicleWrapper::~CubicleWrapper()
 {
+  cuReleaseContext(&m_pContext);
+}
+
+/* all cubicles calls of the calling thread go to our context from
+* now on, until another CubicleWrapper's MakeCurrent; cheap enough
+* to be called before every use
+*/
+void CubicleWrapper::MakeCurrent() const
+{
+  cuSetContext(m_pContext);
 }
 
 void CubicleWrapper::Initialize(int width, int height)
 {
+  MakeCurrent();
   cuInitialize(width, height);
 }
 
@@ -53,6 +68,114 @@ void CubicleWrapper::Process(IplImage* grayImage)
   cuGetScaleSizes(&m_min_width, &m_max_width, &m_min_height, &m_max_height);
 } // Process
 
+/* like Process, but the active scanners of the cascades 
+* cascades_start..cascades_end-1 evaluate only windows around the
+* given areas (usually skin-colored blobs) rather than their entire
+* scan areas.  Of the scanner's scales, only those are used whose
+* windows are comparable in width or in height to an area; the
+* windows are placed so that they cover the area's center, with
+* the same translation steps as a regular scan.
+*/
+void CubicleWrapper::ProcessAreas(IplImage* grayImage,
+                                  int cascades_start, int cascades_end,
+                                  const CRectVector& areas)
+{
+  m_matches.clear();
+  m_bbox = CRect(-1, -1, -1, -1);
+  m_min_width = m_min_height = INT_MAX;
+  m_max_width = m_max_height = -1;
+
+  int num_areas = (int) areas.size();
+  for (int cc=cascades_start; cc<cascades_end; cc++) {
+    CuCascadeID cascadeID = (CuCascadeID) cc;
+    CuScannerParameters sp;
+    cuGetScannerParameters(cascadeID, sp);
+    if (!sp.active || num_areas==0) {
+      continue;
+    }
+    CuCascadeProperties cp;
+    cuGetCascadeProperties(cascadeID, cp);
+
+    // the template is stretched to the image area ratio, just like
+    // the scanner does it
+    double template_ratio = (double)cp.template_width/(double)cp.template_height;
+    double stretch_x = 1.0, stretch_y = 1.0;
+    if (cp.image_area_ratio<template_ratio) {
+      stretch_y = template_ratio/cp.image_area_ratio;
+    } else {
+      stretch_x = cp.image_area_ratio/template_ratio;
+    }
+    int scan_left = max(0, sp.left);
+    int scan_top = max(0, sp.top);
+    int scan_right = min(sp.right, grayImage->width);
+    int scan_bottom = min(sp.bottom, grayImage->height);
+
+    m_windows.clear();
+    for (double scale=sp.start_scale; scale<sp.stop_scale;
+         scale*=sp.scale_inc_factor) 
+    {
+      int width = (int) (scale*stretch_x*cp.template_width);
+      int height = (int) (scale*stretch_y*cp.template_height);
+      if (width>=scan_right-scan_left || height>=scan_bottom-scan_top) {
+        break;
+      }
+      int inc_x = max(1, (int) (sp.translation_inc_x*scale/sp.start_scale));
+      int inc_y = max(1, (int) (sp.translation_inc_y*scale/sp.start_scale));
+
+      for (int acnt=0; acnt<num_areas; acnt++) {
+        const CRect& area = areas[acnt];
+        int area_width = area.right-area.left;
+        int area_height = area.bottom-area.top;
+        bool fits_x = area_width/2<=width && width<=area_width*3/2;
+        bool fits_y = area_height/2<=height && height<=area_height*3/2;
+        if (!fits_x && !fits_y) {
+          continue;
+        }
+        int center_x = (area.left+area.right)/2;
+        int center_y = (area.top+area.bottom)/2;
+        int left_start = max(scan_left, 
+                             min(area.left-width/4, center_x-width*3/4));
+        int left_stop = min(scan_right-width,
+                            max(area.right-width*3/4, center_x-width/4));
+        int top_start = max(scan_top,
+                            min(area.top-height/4, center_y-height*3/4));
+        int top_stop = min(scan_bottom-height,
+                           max(area.bottom-height*3/4, center_y-height/4));
+        for (int top=top_start; top<=top_stop; top+=inc_y) {
+          for (int left=left_start; left<=left_stop; left+=inc_x) {
+            CuScanWindow window;
+            window.left = left;
+            window.top = top;
+            window.scale = scale;
+            m_windows.push_back(window);
+
+            if (m_bbox.left==-1) {
+              m_bbox = CRect(left, top, left+width, top+height);
+            } else {
+              m_bbox.left = min(m_bbox.left, left);
+              m_bbox.top = min(m_bbox.top, top);
+              m_bbox.right = max(m_bbox.right, left+width);
+              m_bbox.bottom = max(m_bbox.bottom, top+height);
+            }
+          }
+        }
+        m_min_width = min(m_min_width, width);
+        m_max_width = max(m_max_width, width);
+        m_min_height = min(m_min_height, height);
+        m_max_height = max(m_max_height, height);
+      }
+    }
+    if (m_windows.empty()) {
+      continue;
+    }
+
+    cuEvaluateWindows(grayImage, cascadeID, m_windows,
+                      m_window_results, m_window_matches);
+    m_matches.insert(m_matches.end(), 
+                     m_window_matches.begin(), m_window_matches.end());
+  }
+} // ProcessAreas
+
 
 
 void CubicleWrapper::DrawOverlay(IplImage* iplImage, int overlay_level) const
@@ -120,6 +243,32 @@ void CubicleWrapper::DrawMatches(IplImage* iplImage, int overlay_level) const
 
 }
 
+/* removes the matches whose centers lie in one of the areas
+*/
+void CubicleWrapper::RemoveMatchesIn(const CRectVector& areas)
+{
+  if (areas.size()==0) {
+    return;
+  }
+  int num_kept = 0;
+  for (int mc=0; mc<(int)m_matches.size(); mc++) {
+    int x = (m_matches[mc].left+m_matches[mc].right)/2;
+    int y = (m_matches[mc].top+m_matches[mc].bottom)/2;
+    bool inside = false;
+    for (int ac=0; ac<(int)areas.size(); ac++) {
+      if (areas[ac].left<=x && x<areas[ac].right
+          && areas[ac].top<=y && y<areas[ac].bottom) {
+        inside = true;
+        break;
+      }
+    }
+    if (!inside) {
+      m_matches[num_kept++] = m_matches[mc];
+    }
+  }
+  m_matches.resize(num_kept);
+}
+
 CuScanMatch CubicleWrapper::GetBestMatch()
 {
   int num_matches = (int)m_matches.size();
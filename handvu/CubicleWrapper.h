@@ -40,19 +40,29 @@ class CubicleWrapper {
   CubicleWrapper();
   ~CubicleWrapper();
 
+  void MakeCurrent() const;
   void Initialize(int width, int height);
   void Process(IplImage* grayImage);
+  void ProcessAreas(IplImage* grayImage, int cascades_start, int cascades_end,
+                    const CRectVector& areas);
   void DrawOverlay(IplImage* iplImage, int overlay_level) const;
   void DrawMatches(IplImage* iplImage, int overlay_level) const;
   CuScanMatch GetBestMatch();
   bool GotMatches() const { return m_matches.size()>0; }
+  void RemoveMatchesIn(const CRectVector& areas);
 
  protected:
+  CuContext*                m_pContext;   // our scanners and cascades
   CRect                     m_bbox;
   int                       m_min_width, m_max_width;
   int                       m_min_height, m_max_height;
   mutable CvFont            m_cvFont;
   CuScanMatchVector         m_matches;
+
+  // for ProcessAreas, kept to reuse their memory
+  CuScanWindowVector        m_windows;
+  CuWindowResultVector      m_window_results;
+  CuScanMatchVector         m_window_matches;
 };
 
 
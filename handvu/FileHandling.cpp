@@ -102,18 +102,33 @@ void SplitPathFile(const string& pathfile, string& vc_path, string& filename)
   filename = string(fname)+string(ext);
 }
 
+/** the full, resolved, path of a file that is given relative to the
+* current working directory or absolute
+*/
+string GetFullPath(const string& pathfile)
+{
+  char fullpath[_MAX_PATH];
+  if (_fullpath(fullpath, pathfile.c_str(), _MAX_PATH)==NULL) {
+    throw HVException("fullpath error");
+  }
+  return string(fullpath);
+}
+
 
 
 #if !defined(WIN32)
 char* _fullpath(char* absPath, const char* relPath, size_t maxLength)
 {
-  if (getcwd(absPath, maxLength)==NULL) {
+  if (relPath[0]=='/') {
+    // absolute already
+    if (maxLength>0) absPath[0] = 0;
+  } else if (getcwd(absPath, maxLength)==NULL) {
     if (maxLength>0) absPath[0] = 0;
     return NULL;
   }
   int pos = strlen(absPath);
   if (pos+strlen(relPath)+2<maxLength) {
-    sprintf(&absPath[pos], "/%s", relPath);
+    sprintf(&absPath[pos], pos>0 ? "/%s" : "%s", relPath);
     // todo: should use snprintf (WIN32: _snprintf)
   }
   char* up = strstr(absPath, "/..");
@@ -50,5 +50,10 @@ void SetCWD(const string& new_cwd);
 */
 void SplitPathFile(const string& pathfile, string& vc_path, string& filename);
 
+/** the full, resolved, path of a file that is given relative to the
+* current working directory or absolute
+*/
+string GetFullPath(const string& pathfile);
+
 
 #endif // __FILEHANDLING_H__
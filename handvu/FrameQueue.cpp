@@ -0,0 +1,330 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+// FrameQueue.cpp: lock-free single-producer/single-consumer queue
+// of ring buffer indices
+//
+
+#include "Common.h"
+#include "FrameQueue.h"
+#include "Exceptions.h"
+
+// full memory barrier, compare-and-swap and increment
+#if defined(WIN32)
+#define FQ_BARRIER() MemoryBarrier()
+#define FQ_CAS(ptr, oldval, newval) \
+  (InterlockedCompareExchange((volatile LONG*)(ptr), (LONG)(newval), \
+                              (LONG)(oldval))==(LONG)(oldval))
+#define FQ_INCREMENT(ptr) InterlockedIncrement((volatile LONG*)(ptr))
+#else //WIN32
+#define FQ_BARRIER() __sync_synchronize()
+#define FQ_CAS(ptr, oldval, newval) \
+  __sync_bool_compare_and_swap(ptr, oldval, newval)
+#define FQ_INCREMENT(ptr) __sync_fetch_and_add(ptr, 1)
+#endif //WIN32
+
+
+FrameQueue::FrameQueue()
+  : m_capacity(0),
+    m_num_pooled(0),
+    m_num_buffers(0),
+    m_ring(NULL),
+    m_occupied(NULL),
+    m_head(0),
+    m_tail(0),
+    m_closed(false),
+    m_num_dropped(0),
+    m_policy(FQ_DROP_OLDEST),
+    m_release_hook(NULL),
+    m_release_arg(NULL),
+    m_consumer_waiting(false),
+    m_producer_waiting(false)
+{
+#if defined(WIN32)
+  // auto-reset events remember a Wake that comes before the Wait
+  m_filled_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+  m_freed_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (m_filled_event==NULL || m_freed_event==NULL) {
+    throw HVException("can not initialize WIN32 event");
+  }
+#else //WIN32
+  int err;
+  err = pthread_mutex_init(&m_mutex, NULL);
+  if (err) throw HVException("can not initialize pthread mutex");
+  err = pthread_cond_init(&m_filled_cond, NULL);
+  if (err) throw HVException("can not initialize pthread conditional variable");
+  err = pthread_cond_init(&m_freed_cond, NULL);
+  if (err) throw HVException("can not initialize pthread conditional variable");
+#endif //WIN32
+}
+
+FrameQueue::~FrameQueue()
+{
+#if defined(WIN32)
+  CloseHandle(m_filled_event);
+  CloseHandle(m_freed_event);
+#else //WIN32
+  pthread_cond_destroy(&m_freed_cond);
+  pthread_cond_destroy(&m_filled_cond);
+  pthread_mutex_destroy(&m_mutex);
+#endif //WIN32
+  delete[] m_ring;
+  delete[] m_occupied;
+}
+
+/* num_pooled free buffers, room for capacity buffers in total, queue
+* empty; must not be called while the queue is in use
+*/
+void FrameQueue::Resize(int num_pooled, int capacity)
+{
+  ASSERT(num_pooled<=capacity);
+  delete[] m_ring;
+  delete[] m_occupied;
+  m_capacity = capacity;
+  m_num_pooled = num_pooled;
+  m_num_buffers = num_pooled;
+  m_ring = new int[capacity];
+  m_occupied = new bool[capacity];
+  for (int b=0; b<capacity; b++) {
+    m_ring[b] = -1;
+    m_occupied[b] = false;
+  }
+  m_head = 0;
+  m_tail = 0;
+  m_closed = false;
+  m_num_dropped = 0;
+}
+
+/* a buffer that the producer owns rather than the pool; returns its
+* index, or -1 if there is no room
+*/
+int FrameQueue::Add()
+{
+  if (m_num_buffers==m_capacity) {
+    return -1;
+  }
+  int id = m_num_buffers;
+  m_occupied[id] = false;
+  FQ_BARRIER();
+  m_num_buffers = id+1;
+  return id;
+}
+
+/* returns the index of a free pooled buffer, which belongs to the
+* caller until it is pushed.  If all are taken, the policy decides:
+* FQ_BLOCK waits until one is released, the others take the oldest
+* buffer that is still queued, and wait only if there is none.
+* Returns -1 if the queue was closed.
+*/
+int FrameQueue::Acquire()
+{
+  for (;;) {
+    // only the producer marks buffers occupied
+    for (int b=0; b<m_num_pooled; b++) {
+      if (!m_occupied[b]) {
+        m_occupied[b] = true;
+        return b;
+      }
+    }
+    if (m_policy!=FQ_BLOCK) {
+      int id = TryPop();
+      if (id!=-1) {
+        FQ_INCREMENT(&m_num_dropped);
+        if (!IsPooled(id)) {
+          // not ours to hand out, give it back
+          Release(id);
+          continue;
+        }
+        // stays occupied, now by the producer
+        return id;
+      }
+    }
+    if (m_closed) {
+      return -1;
+    }
+    Wait(true);
+  }
+}
+
+/* a pooled buffer must have been acquired, a buffer of the producer
+* must not be queued or in use already
+*/
+void FrameQueue::Push(int id)
+{
+  ASSERT(0<=id && id<m_num_buffers);
+  ASSERT(IsPooled(id)==m_occupied[id]);
+  m_occupied[id] = true;
+  // at most m_capacity-1 others are queued, so this slot is unused
+  m_ring[m_tail % m_capacity] = id;
+  FQ_BARRIER();
+  m_tail = m_tail+1;
+  Wake(false);
+}
+
+/* waits until a buffer is queued and returns it in id, or false
+* once the queue was closed.  With FQ_LATEST_WINS, all but the newest
+* of the queued buffers are released and counted as dropped.
+*/
+bool FrameQueue::Pop(int& id)
+{
+  for (;;) {
+    if (m_closed) {
+      return false;
+    }
+    id = TryPop();
+    if (id!=-1) {
+      break;
+    }
+    Wait(false);
+  }
+
+  if (m_policy==FQ_LATEST_WINS) {
+    int newer;
+    while ((newer=TryPop())!=-1) {
+      Release(id);
+      FQ_INCREMENT(&m_num_dropped);
+      id = newer;
+    }
+  }
+  return true;
+}
+
+/* a pooled buffer is free for Acquire again, the release hook
+* returns any other to the producer
+*/
+void FrameQueue::Release(int id)
+{
+  ASSERT(0<=id && id<m_num_buffers && m_occupied[id]);
+  // all use of the buffer must be done before it is seen free
+  FQ_BARRIER();
+  m_occupied[id] = false;
+  if (IsPooled(id)) {
+    Wake(true);
+  } else if (m_release_hook) {
+    m_release_hook(m_release_arg, id);
+  }
+}
+
+/* Acquire and Pop return -1 and false from now on, also if they
+* are waiting
+*/
+void FrameQueue::Close()
+{
+  m_closed = true;
+  FQ_BARRIER();
+#if defined(WIN32)
+  SetEvent(m_filled_event);
+  SetEvent(m_freed_event);
+#else //WIN32
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_broadcast(&m_filled_cond);
+  pthread_cond_broadcast(&m_freed_cond);
+  pthread_mutex_unlock(&m_mutex);
+#endif //WIN32
+}
+
+/* the oldest queued buffer, or -1; both the consumer and Acquire
+* take buffers from the head, hence the compare-and-swap
+*/
+int FrameQueue::TryPop()
+{
+  for (;;) {
+    unsigned int head = m_head;
+    FQ_BARRIER();
+    if (head==m_tail) {
+      return -1;
+    }
+    int id = m_ring[head % m_capacity];
+    if (FQ_CAS(&m_head, head, head+1)) {
+      return id;
+    }
+  }
+}
+
+bool FrameQueue::AnyFree() const
+{
+  for (int b=0; b<m_num_pooled; b++) {
+    if (!m_occupied[b]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* the producer waits for a free buffer, the consumer for a queued one
+*/
+bool FrameQueue::MustWait(bool for_free) const
+{
+  if (m_closed) {
+    return false;
+  }
+  if (for_free) {
+    return !AnyFree();
+  }
+  return m_head==m_tail;
+}
+
+/* announce the wait, then check again: a Wake after the check sees
+* the announcement, one before it changed what is checked
+*/
+void FrameQueue::Wait(bool for_free)
+{
+  volatile bool& waiting = for_free ? m_producer_waiting : m_consumer_waiting;
+#if defined(WIN32)
+  waiting = true;
+  FQ_BARRIER();
+  while (MustWait(for_free)) {
+    WaitForSingleObject(for_free ? m_freed_event : m_filled_event, INFINITE);
+  }
+  waiting = false;
+#else //WIN32
+  pthread_cond_t* cond = for_free ? &m_freed_cond : &m_filled_cond;
+  pthread_mutex_lock(&m_mutex);
+  waiting = true;
+  FQ_BARRIER();
+  while (MustWait(for_free)) {
+    pthread_cond_wait(cond, &m_mutex);
+  }
+  waiting = false;
+  pthread_mutex_unlock(&m_mutex);
+#endif //WIN32
+}
+
+/* called after the change that the other side may wait for; takes
+* the lock only if it does wait
+*/
+void FrameQueue::Wake(bool for_free)
+{
+  volatile bool& waiting = for_free ? m_producer_waiting : m_consumer_waiting;
+  FQ_BARRIER();
+  if (!waiting) {
+    return;
+  }
+#if defined(WIN32)
+  SetEvent(for_free ? m_freed_event : m_filled_event);
+#else //WIN32
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_signal(for_free ? &m_freed_cond : &m_filled_cond);
+  pthread_mutex_unlock(&m_mutex);
+#endif //WIN32
+}
@@ -0,0 +1,114 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+#ifndef __FRAMEQUEUE__INCLUDED_H_
+#define __FRAMEQUEUE__INCLUDED_H_
+
+#if defined(WIN32)
+#include <windows.h>
+#else //WIN32
+#include <pthread.h>
+#endif //WIN32
+
+// ----------------------------------------------------------------------
+// class FrameQueue
+// ----------------------------------------------------------------------
+
+/* the buffers of the async ring and the queue of filled ones between
+ * the capture application (the only producer) and the processing
+ * thread (the only consumer).  Buffers are acquired, pushed, popped
+ * and released by index.  Neither side takes a lock unless it has to
+ * wait: the consumer when the queue is empty, the producer when all
+ * buffers are taken and the policy is FQ_BLOCK.  Release may be
+ * called from any thread, once per popped buffer.
+ * The first buffers are pooled, the ones that the producer Adds are
+ * its own: Acquire never hands them out, and the release hook tells
+ * the producer when it can have one back.
+ */
+class FrameQueue {
+ public:
+  enum DropPolicy {
+    FQ_BLOCK = 0,       // Acquire waits for the consumer to release one
+    FQ_DROP_OLDEST = 1, // Acquire takes back the oldest queued buffer
+    FQ_LATEST_WINS = 2  // as FQ_DROP_OLDEST, and Pop skips to the newest
+  };
+
+ public:
+  FrameQueue();
+  ~FrameQueue();
+
+  void Resize(int num_pooled, int capacity);
+  void SetReleaseHook(void (*hook)(void* arg, int id), void* arg)
+    { m_release_hook = hook; m_release_arg = arg; }
+  void SetDropPolicy(DropPolicy policy) { m_policy = policy; }
+  DropPolicy GetDropPolicy() const { return m_policy; }
+  int GetNumDropped() const { return m_num_dropped; }
+
+  // producer
+  int Add();
+  int Acquire();
+  void Push(int id);
+  bool IsPooled(int id) const { return id<m_num_pooled; }
+  bool IsOccupied(int id) const { return m_occupied[id]; }
+
+  // consumer
+  bool Pop(int& id);
+  void Release(int id);
+
+  void Close();
+
+ protected:
+  int TryPop();
+  bool AnyFree() const;
+  bool MustWait(bool for_free) const;
+  void Wait(bool for_free);
+  void Wake(bool for_free);
+
+ protected:
+  int                     m_capacity;
+  int                     m_num_pooled;
+  volatile int            m_num_buffers;
+  int*                    m_ring;
+  volatile bool*          m_occupied;
+  volatile unsigned int   m_head;   // next to pop, consumer and Acquire
+  volatile unsigned int   m_tail;   // next to push, producer only
+  volatile bool           m_closed;
+  volatile int            m_num_dropped;
+  DropPolicy              m_policy;
+  void                  (*m_release_hook)(void* arg, int id);
+  void*                   m_release_arg;
+
+  // blocking, only if one side has to wait
+  volatile bool           m_consumer_waiting;
+  volatile bool           m_producer_waiting;
+#if defined(WIN32)
+  HANDLE                  m_filled_event;
+  HANDLE                  m_freed_event;
+#else //WIN32
+  pthread_mutex_t         m_mutex;
+  pthread_cond_t          m_filled_cond;
+  pthread_cond_t          m_freed_cond;
+#endif //WIN32
+};
+
+#endif // __FRAMEQUEUE__INCLUDED_H_
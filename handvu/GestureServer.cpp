@@ -99,10 +99,12 @@ void GestureServer::SetNonBlocking(SOCKET sd)
 /////////////////////////////////////////////////////////////////////////////
 // GestureServerStream
 
-GestureServerStream::GestureServerStream(int port, int max_num_clients)
+GestureServerStream::GestureServerStream(int port, int max_num_clients,
+                                         bool local_only)
   : GestureServer(),
     m_port(port),
     m_max_num_clients(max_num_clients),
+    m_local_only(local_only),
     m_server_sd(0)
 {
 }
@@ -111,6 +113,7 @@ GestureServerStream::GestureServerStream(const GestureServerStream& from)
   : GestureServer(),
     m_port(from.m_port),
     m_max_num_clients(from.m_max_num_clients),
+    m_local_only(from.m_local_only),
     m_server_sd(0)
 {
   if (from.m_started) {
@@ -136,6 +139,7 @@ GestureServerStream& GestureServerStream::operator=(const GestureServerStream& f
   }
   m_port = from.m_port;
   m_max_num_clients = from.m_max_num_clients;
+  m_local_only = from.m_local_only;
   m_server_sd = 0;
   m_started = false;
   return *this;
@@ -171,7 +175,8 @@ void GestureServerStream::Start()
   struct sockaddr_in server_sock_addr;
   memset(&server_sock_addr, 0, sizeof(server_sock_addr));
   server_sock_addr.sin_family = AF_INET;
-  server_sock_addr.sin_addr.s_addr = INADDR_ANY;
+  server_sock_addr.sin_addr.s_addr =
+    m_local_only ? htonl(INADDR_LOOPBACK) : INADDR_ANY;
   server_sock_addr.sin_port = htons((unsigned short) m_port);
   int error =
     bind(m_server_sd, (struct sockaddr*) &server_sock_addr, 
@@ -229,7 +234,7 @@ void GestureServerStream::Send(const HVState& state)
   char* buf = (char*) alloca(256+state.m_posture.size());
   float orientation = 0; 
   sprintf(buf, GESTUREEVENT_VERSION_STRING
-	  " %lld %d: %d, %d, \"%s\" (%f, %f) [%f, %f]\r\n",
+	  " %lld %d: %d, %d, \"%s\" (%f, %f) [%f, %f] %lld %lld\r\n",
 #ifdef WIN32
 	  (long) state.m_tstamp,
 #else
@@ -239,7 +244,8 @@ void GestureServerStream::Send(const HVState& state)
 	  (int) state.m_recognized, 
 	  state.m_posture.c_str(), 
 	  (float) state.m_center_xpos, (float) state.m_center_ypos,
-	  (float) state.m_scale, orientation);
+	  (float) state.m_scale, orientation,
+	  state.m_tstamp_processing, state.m_tstamp_event);
   str = string(buf);
   
   SocketList::iterator deleteme = m_client_sds.end();
@@ -371,6 +377,131 @@ void GestureServerStream::InitSockets()
 
 
 
+/////////////////////////////////////////////////////////////////////////////
+// MetricsServer
+
+MetricsServer::MetricsServer(int port, const Metrics* pMetrics)
+  : GestureServerStream(port, 10, true),
+    m_pMetrics(pMetrics)
+{
+}
+
+void MetricsServer::Stop()
+{
+  GestureServerStream::Stop();
+  m_client_sds.clear();
+  m_requests.clear();
+}
+
+/* called with the state of every object; only object 0's is used,
+* to answer once per frame the clients whose request is complete
+* by now
+*/
+void MetricsServer::Send(const HVState& state)
+{
+  if (!m_started) {
+    throw HVException("MetricsServer has not been started");
+  }
+  if (state.m_obj_id!=0) {
+    return;
+  }
+  
+  CheckForNewClients();
+
+  SocketList::iterator it = m_client_sds.begin();
+  while (it != m_client_sds.end()) {
+    SOCKET sd = *it;
+    Request& request = m_requests[sd];
+    request.num_frames++;
+    bool complete = ReadRequest(sd);
+    if (complete) {
+      Respond(sd);
+    }
+    if (complete || request.num_frames>MAX_REQUEST_FRAMES) {
+      CloseClient(sd);
+      it = m_client_sds.erase(it);
+    } else {
+      it ++;
+    }
+  }
+}
+
+/* reads what the client sent so far; true once the header of its
+* request is complete, or if the connection is broken
+*/
+bool MetricsServer::ReadRequest(SOCKET sd)
+{
+  Request& request = m_requests[sd];
+  char buf[1024];
+  for (;;) {
+    int bytes = recv(sd, buf, sizeof(buf), 0);
+    if (bytes>0) {
+      request.data.append(buf, bytes);
+      if (request.data.find("\r\n\r\n")!=string::npos
+          || request.data.find("\n\n")!=string::npos) {
+        return true;
+      }
+      if (request.data.size()>8*sizeof(buf)) {
+        VERBOSE0(2, "MetricsServer: request too long, discarding client");
+        request.num_frames = MAX_REQUEST_FRAMES+1;
+        return false;
+      }
+      continue;
+    }
+#ifdef WIN32
+    if (bytes==SOCKET_ERROR && WSAGetLastError()==WSAEWOULDBLOCK)
+#else
+    if (bytes==-1 && (errno==EAGAIN || errno==EWOULDBLOCK))
+#endif
+    {
+      // nothing more for now
+      return false;
+    }
+    // closed or broken connection
+    request.num_frames = MAX_REQUEST_FRAMES+1;
+    return false;
+  }
+}
+
+void MetricsServer::Respond(SOCKET sd)
+{
+  string body;
+  m_pMetrics->WriteText(body);
+  char header[256];
+  sprintf(header, "HTTP/1.0 200 OK\r\n"
+          "Content-Type: text/plain; version=0.0.4\r\n"
+          "Content-Length: %d\r\n"
+          "Connection: close\r\n\r\n", (int) body.size());
+  string str = string(header) + body;
+
+  int flags = 0;
+#ifndef WIN32
+  flags = MSG_NOSIGNAL;
+#endif
+  int bytes = send(sd, str.c_str(), (int)str.size(), flags);
+  if (bytes!=(int)str.size()) {
+    VERBOSE0(2, "warning: MetricsServer could not send all of the metrics");
+  }
+}
+
+void MetricsServer::CloseClient(SOCKET sd)
+{
+#ifdef WIN32
+  closesocket(sd);
+#else
+  close(sd);
+#endif
+  m_requests.erase(sd);
+}
+
+
+
+
+
+
+
+
+
 /////////////////////////////////////////////////////////////////////////////
 // GestureServerOSC
 
@@ -476,6 +607,9 @@ void GestureServerOSC::Send(const HVState& state)
   m_packet.AddFloat((float)state.m_scale);
   float orientation = 0.0;
   m_packet.AddFloat(orientation);
+  // 32 bits wrap around every 71 minutes, differences are still fine
+  m_packet.AddInt((int) state.m_tstamp_processing);
+  m_packet.AddInt((int) state.m_tstamp_event);
 
   int flags = 0;
   struct sockaddr_in dest_sock_addr;
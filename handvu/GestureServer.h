@@ -24,10 +24,11 @@
 // GestureServer.h: TCP/IP and UDP server
 //
 
-#include "HandVu.hpp"  // for HVState only
+#include "HandVu.hpp"  // for HVState and Metrics only
 #include "OSCpacket.h"
 #include <string>
 #include <list>
+#include <map>
 using namespace std;
 
 #ifdef WIN32
@@ -37,13 +38,15 @@ typedef int SOCKET;
 #endif
 
 
-#define GESTUREEVENT_VERSION_STRING "1.2"
+// 1.3: processing and event time stamps after the orientation
+#define GESTUREEVENT_VERSION_STRING "1.3"
 
 typedef list<SOCKET> SocketList;
 
 class GestureServer {
 
  public:
+  virtual ~GestureServer() {}
   GestureServer& operator=(const GestureServer& from)    ;
 
   virtual void Start() = 0;
@@ -64,7 +67,8 @@ class GestureServer {
 class GestureServerStream : public GestureServer {
 
  public:
-  GestureServerStream(int port, int max_num_clients=10);
+  GestureServerStream(int port, int max_num_clients=10,
+                      bool local_only=false);
   GestureServerStream(const GestureServerStream& from);
   ~GestureServerStream();
   GestureServerStream& operator=(const GestureServerStream& from);
@@ -80,11 +84,44 @@ class GestureServerStream : public GestureServer {
  protected:
   int                            m_port;
   int                            m_max_num_clients;
+  bool                           m_local_only;   // bind to localhost
   SOCKET                         m_server_sd;
   SocketList                     m_client_sds;
 };
 
 
+/* answers HTTP requests with the metrics in Prometheus text format,
+ * on localhost only.  Like the other servers, it does its work when
+ * HandVu sends an event, so a request waits for the next frame.
+ */
+class MetricsServer : public GestureServerStream {
+
+ public:
+  MetricsServer(int port, const Metrics* pMetrics);
+
+  virtual void Stop();
+  virtual void Send(const HVState& state);
+
+ protected:
+  bool ReadRequest(SOCKET sd);
+  void Respond(SOCKET sd);
+  void CloseClient(SOCKET sd);
+
+ protected:
+  // a client that does not complete its request within this many
+  // frames is disconnected
+  enum { MAX_REQUEST_FRAMES = 300 };
+  class Request {
+   public:
+    Request() : num_frames(0) {}
+    string                       data;
+    int                          num_frames;
+  };
+  const Metrics*                 m_pMetrics;
+  map<SOCKET, Request>           m_requests;
+};
+
+
 class GestureServerOSC : public GestureServer {
 
  public:
@@ -50,14 +50,34 @@ static char THIS_FILE[] = __FILE__;
 #endif // USE_MFC
 
 
+/////////////////////////////////////////////////////////////////////////////
+// HandVu::TrackedObject
+
+HandVu::TrackedObject::TrackedObject(int obj_id)
+  : id(obj_id),
+    on(false),
+    tracking(false),
+    recognized(false),
+    lost(false),
+    center_depth(0)
+{
+  center_pos.x = center_pos.y = -1;
+  pOpticalFlow = new OpticalFlow();
+  pCamShift = new CamShift();
+}
+
+HandVu::TrackedObject::~TrackedObject()
+{
+  delete pOpticalFlow;
+  delete pCamShift;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // HandVu
 
 HandVu::HandVu()
   : m_active(false),
-    m_tracking(false),
-    m_recognized(false),
-    m_id1_on(false),
     m_do_track(true),
     m_video_width(0),
     m_video_height(0),
@@ -68,10 +88,13 @@ HandVu::HandVu()
     m_rgbImage(NULL),
     m_depthImage(NULL),
     m_rightGrayImage(NULL),
-    m_center_depth(0),
     m_initialized(false),
     m_quit_thread(false),
     m_pAsyncThread(NULL),
+    m_pDisplayCallback(NULL),
+    m_pReleaseCallback(NULL),
+    m_pipelined(false),
+    m_pOutputThread(NULL),
     m_img_width(-1),
     m_img_height(-1),
     m_undistort(false),
@@ -82,22 +105,28 @@ HandVu::HandVu()
     m_max_abnormal_latency(-1),
     m_determine_normal_latency(false),
     m_t_start_processing(0),
+    m_applied_scan_quality(1.0),
+    m_finish_time(0),
     m_time_to_learn_color(0),
+    m_dt_frames_since_full_scan(0),
     m_min_time_between_learning_color(0),
     m_adjust_exposure(false),
     m_adjust_exposure_at_time(0),
     m_pCameraController(NULL),
-    m_pClock(NULL)
+    m_pClock(NULL),
+    m_pTimer(NULL),
+    m_t_start_timing(0)
 {
   m_pCubicle = new CubicleWrapper();
   m_pSkincolor = new Skincolor();
   m_pLearnedColor = new LearnedColor();
-  m_pOpticalFlow = new OpticalFlow();
-  m_pCamShift = new CamShift();
   m_pUndistortion = new Undistortion();
-  m_pConductor = new VisionConductor();
+  m_pConductor = NULL;
   m_grayImages[0] = NULL;
   m_grayImages[1] = NULL;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    m_objects[obj] = NULL;
+  }
 
 //  g_ostream = fopen("c:\\tmp\\HVout.txt", "aw+");
   g_ostream = NULL;
@@ -108,18 +137,31 @@ HandVu::~HandVu()
 {
   // quit Aync thread
   if (m_pAsyncThread) {
-    m_quit_thread = true; // will be set to false by thread upon exit
-    m_pAsyncThread->Resume();
+    m_quit_thread = true;
+    m_frame_queue.Close(); // Pop fails, and the thread exits
+  }
+  // quit output thread after the Async thread, which feeds it; both
+  // use our datastructures, so wait for them before deleting those
+  if (m_pAsyncThread) {
+     m_pAsyncThread->Join();
+  }  
+  if (m_pOutputThread) {
+    m_pOutputThread->Lock();
+    m_quit_thread = true;
+    m_pOutputThread->Resume();
+    m_pOutputThread->Unlock();
+    m_pOutputThread->Join();
   }
   
   // our datastructures
   delete m_pCubicle;
   delete m_pSkincolor;
   delete m_pLearnedColor;
-  delete m_pOpticalFlow;
-  delete m_pCamShift;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    delete m_objects[obj];
+  }
   delete m_pUndistortion;
-  delete m_pConductor;
+  VisionConductor::Release(m_pConductor);
 
   // images
   cvReleaseImage(&m_grayImages[0]);
@@ -127,12 +169,14 @@ HandVu::~HandVu()
   cvReleaseImage(&m_depthImage);
   cvReleaseImage(&m_rightGrayImage);
 
-  // wait for Aync thread, then delete ring buffer
-  if (m_pAsyncThread) {
-     m_pAsyncThread->Join();
-  }  
+  // delete ring buffer
   for (int b=0; b<(int)m_ring_buffer.size(); b++) {
-    cvReleaseImage(&m_ring_buffer[b]);
+    if (m_frame_queue.IsPooled(b)) {
+      cvReleaseImage(&m_ring_buffer[b]);
+    } else {
+      // the data belongs to the application
+      cvReleaseImageHeader(&m_ring_buffer[b]);
+    }
   }
 }
 
@@ -156,9 +200,13 @@ void HandVu::Initialize(int width, int height, RefClock* pClock,
   m_pCubicle->Initialize(width, height);
   m_pSkincolor->Initialize(width, height);
   m_pLearnedColor->Initialize(width, height);
-  m_pOpticalFlow->Initialize(width, height);
   m_pUndistortion->Initialize(width, height);
-  m_pCamShift->Initialize(width, height);
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj]) {
+      m_objects[obj]->pOpticalFlow->Initialize(width, height);
+      m_objects[obj]->pCamShift->Initialize(width, height);
+    }
+  }
   m_img_width = width;
   m_img_height = height;
 
@@ -166,6 +214,7 @@ void HandVu::Initialize(int width, int height, RefClock* pClock,
     throw HVException("no clock set!");
   }
   m_pClock = pClock;
+  m_pTimer = pClock;
   if (!pCamCon) {
     VERBOSE0(3, "no camera controller will be available");
   }
@@ -182,11 +231,26 @@ void HandVu::Initialize(int width, int height, RefClock* pClock,
   m_initialized = true;
 }
 
+/* time stamps, latencies and timeouts go by pClock from now on, the
+* stage times still by the clock given to Initialize; for replaying
+* recorded frames on the recorded times
+*/
+void HandVu::SetReferenceClock(RefClock* pClock)
+{
+  if (!m_initialized) {
+    throw HVException("HandVu not initialized");
+  }
+  if (!pClock) {
+    throw HVException("no clock set!");
+  }
+  m_pClock = pClock;
+}
+
 
 
 bool HandVu::ConductorLoaded() const
 {
-  return m_pConductor->IsLoaded();
+  return m_pConductor!=NULL;
 }
 
 void HandVu::LoadConductor(const string& filename)
@@ -194,7 +258,33 @@ void HandVu::LoadConductor(const string& filename)
   VERBOSE1(5, "HandVu: loading conductor from file %s",
     filename.c_str());
 
-  m_pConductor->Load(filename);
+  // all instances that load the same file share the conductor, and
+  // the cascade files are parsed only once; the scanners and the
+  // copies of the cascades that they scan with are ours
+  m_pCubicle->MakeCurrent();
+  VisionConductor* pConductor = VisionConductor::Acquire(filename);
+  // the cascades of the previous conductor are replaced in any case
+  VisionConductor::Release(m_pConductor);
+  m_pConductor = pConductor;
+  try {
+    m_pConductor->LoadCascades();
+  } catch (HVException&) {
+    VisionConductor::Release(m_pConductor);
+    m_pConductor = NULL;
+    throw;
+  }
+  m_orig_areas = m_pConductor->m_orig_areas;
+
+  // the scanner parameters for full quality
+  int num_cascades = max(m_pConductor->m_dt_cascades_end,
+                         max(m_pConductor->m_tr_cascades_end,
+                             m_pConductor->m_rc_cascades_end));
+  m_full_quality_params.resize(num_cascades);
+  for (int cc=0; cc<num_cascades; cc++) {
+    cuGetScannerParameters((CuCascadeID)cc, m_full_quality_params[cc]);
+  }
+  m_applied_scan_quality = 1.0;
+  m_quality.Reset();
   // load a calibration matrix, if available, and set active
   if (m_pConductor->m_camera_calib!="") {
     m_pUndistortion->Load(m_pConductor->m_camera_calib.c_str());
@@ -216,7 +306,9 @@ void HandVu::LoadConductor(const string& filename)
 }
 
 
-// put filters in the right state, supply scanners and cascades
+// put filters in the right state, supply scanners and cascades;
+// objects are detected one after the other, each away from those
+// that are tracked already
 //
 void HandVu::StartRecognition(int id/*=0*/)
 {
@@ -224,69 +316,157 @@ void HandVu::StartRecognition(int id/*=0*/)
     throw HVException("HandVu not initialized, cannot start");
   }
 
-  if(!m_pConductor->IsLoaded()) {
+  if(!ConductorLoaded()) {
     throw HVException("no conductor loaded");
   }
+  m_pCubicle->MakeCurrent();
 
   VERBOSE1(5, "HandVu: starting recognition for obj_id %d", id);
 
-  if (id==1) {
-    m_id1_on = true;
-    m_id1_x = -1;
-    m_id1_y = -1;
-    if (m_active) return;
-  } else if (id!=0) {
+  if (id<0 || id>=MAX_OBJECTS) {
     throw HVException("unknown ID");
   }
+  if (m_objects[id]==NULL) {
+    m_objects[id] = new TrackedObject(id);
+    m_objects[id]->pOpticalFlow->Initialize(m_img_width, m_img_height);
+    m_objects[id]->pCamShift->Initialize(m_img_width, m_img_height);
+  }
+  TrackedObject& obj = *m_objects[id];
+  obj.on = true;
+  obj.tracking = false;
+  obj.recognized = false;
 
-  // other detection
-  m_dt_first_match_time = 0;
-  m_dt_first_match = CuScanMatch();
+  RestartDetection();
+  SetDetectionScanners();
+
+  if (!m_active) {
+    m_metrics.ClearFrames();
+
+    m_buf_indx_cycler = 0;
+    m_curr_buf_indx = m_buf_indx_cycler;
+    m_prev_buf_indx = 1-m_buf_indx_cycler;
+
+    m_do_track = true;
+    m_active = true;
+  }
+
+  // the scan area is mostly used during tracking, but also
+  // to do the exposure control
+  UpdateScanArea();
+}
+
+void HandVu::StopRecognition(int id/*=0*/)
+{
+  VERBOSE1(5, "HandVu: stopping recognition for obj_id %d", id);
+
+  if (id<0 || id>=MAX_OBJECTS) {
+    throw HVException("unknown ID");
+  }
+  if (m_objects[id]) {
+    m_objects[id]->on = false;
+    m_objects[id]->tracking = false;
+    m_objects[id]->recognized = false;
+  }
+
+  m_active = false;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->on) {
+      m_active = true;
+    }
+  }
+  if (m_active) {
+    UpdateScanArea();
+  }
+}
 
-  // activate detection scanners
+/* detection scanners on, at their original areas, recognition
+* scanners off
+*/
+void HandVu::SetDetectionScanners()
+{
   for (int cc=0; cc<m_pConductor->m_dt_cascades_end; cc++) {
     cuSetScannerActive((CuCascadeID)cc, true);
-    CRect area(m_pConductor->m_orig_areas[cc].toRect(m_img_width, m_img_height));
+    CRect area(m_orig_areas[cc].toRect(m_img_width, m_img_height));
     cuSetScanArea((CuCascadeID)cc, area.left, area.top, area.right, area.bottom);
   }
-  // de-activate recognition scanners
   for (int cc=m_pConductor->m_rc_cascades_start;
        cc<m_pConductor->m_rc_cascades_end; cc++) {
     cuSetScannerActive((CuCascadeID)cc, false);
   }
+}
 
-  // the scan area is mostly used during tracking, but also
-  // to do the exposure control
-  CQuadruple quad;
-  GetDetectionArea(quad);
-  m_scan_area = quad.toRect(m_img_width, m_img_height);
-
-  m_frame_times.clear();
-  m_processed_frame_times.clear();
-  m_prcs_times.clear();
-
-  m_buf_indx_cycler = 0;
-  m_curr_buf_indx = m_buf_indx_cycler;
-  m_prev_buf_indx = 1-m_buf_indx_cycler;
+/* the next detection starts from scratch, with a full scan
+*/
+void HandVu::RestartDetection()
+{
+  m_dt_first_match_time = 0;
+  m_dt_first_match = CuScanMatch();
+  m_dt_frames_since_full_scan = m_pConductor->m_dt_full_scan_interval;
+}
 
-  m_do_track = true;
+/* the first started object that is not tracked, or NULL
+*/
+HandVu::TrackedObject* HandVu::GetSearchedObject() const
+{
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->on && !m_objects[obj]->tracking) {
+      return m_objects[obj];
+    }
+  }
+  return NULL;
+}
 
-  m_active = true;
-  m_tracking = false;
+int HandVu::GetNumTracking() const
+{
+  int num = 0;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->tracking) {
+      num++;
+    }
+  }
+  return num;
 }
 
-void HandVu::StopRecognition(int id/*=0*/)
+/* the area of the object's last match, at its current position
+*/
+CRect HandVu::GetObjectArea(const TrackedObject& obj) const
 {
-  VERBOSE1(5, "HandVu: stopping recognition for obj_id %d", id);
+  int half_width = (obj.last_match.right-obj.last_match.left)/2;
+  int half_height = (obj.last_match.bottom-obj.last_match.top)/2;
+  int x = cvRound(obj.center_pos.x), y = cvRound(obj.center_pos.y);
+  return CRect(x-half_width, y-half_height, x+half_width, y+half_height);
+}
 
-  if (id==1) {
-    m_id1_on = false;
-    return;
-  } else if (id!=0) {
-    throw HVException("unknown ID");
+/* the bounding box of the scan areas of the tracked objects, and of
+* the detection area while an object is searched for
+*/
+void HandVu::UpdateScanArea()
+{
+  bool empty = true;
+  if (GetSearchedObject()) {
+    CQuadruple quad;
+    GetDetectionArea(quad);
+    m_scan_area = quad.toRect(m_img_width, m_img_height);
+    empty = false;
+  }
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj]==NULL || !m_objects[obj]->tracking) {
+      continue;
+    }
+    const CRect& area = m_objects[obj]->scan_area;
+    if (empty) {
+      m_scan_area = area;
+      empty = false;
+    } else {
+      m_scan_area.left = min(m_scan_area.left, area.left);
+      m_scan_area.top = min(m_scan_area.top, area.top);
+      m_scan_area.right = max(m_scan_area.right, area.right);
+      m_scan_area.bottom = max(m_scan_area.bottom, area.bottom);
+    }
+  }
+  if (empty) {
+    m_scan_area = CRect(0, 0, 0, 0);
   }
-
-  m_active = false;
 }
 
 
@@ -297,8 +477,31 @@ void HandVu::StopRecognition(int id/*=0*/)
 HandVu::HVAction
 HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
 {
+  FrameResult result;
+  HVAction action = AnalyzeFrame(inOutImage, rightImage, result);
+  FinishFrame(result);
+
+  return action;
+}
+
+/* the first stage of ProcessFrame: everything that reads or changes
+* the tracking and detection state, up to and including the overlays
+* of the components.  The result has all that FinishFrame needs, so
+* that the pipelined async mode can run FinishFrame in another thread
+* while the next frame is analyzed.
+*/
+HandVu::HVAction
+HandVu::AnalyzeFrame(GrabbedImage& inOutImage, const IplImage* rightImage,
+                     FrameResult& result)
+{
+  CuTraceSpan span("analyze");
+  // the async threads call this as well
+  m_pCubicle->MakeCurrent();
   m_rgbImage = inOutImage.GetImage();
   m_sample_time = inOutImage.GetSampleTime();
+  result.image = m_rgbImage;
+  result.buffer_id = inOutImage.GetBufferID();
+  result.overlay_time = 0;
 
   // sanity checks
   if(!m_initialized) {
@@ -307,8 +510,8 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
   if (m_rgbImage->width!=m_img_width || m_rgbImage->height!=m_img_height) {
     throw HVException("image dimensions do not match initialization");
   }
-  VERBOSE2(5, "HandVu: processing frame (active: %s, tracking: %s)",
-    m_active?"yes":"no", m_tracking?"yes":"no");
+  VERBOSE2(5, "HandVu: processing frame (active: %s, tracking: %d)",
+    m_active?"yes":"no", GetNumTracking());
 
   if (m_rgbImage->origin==1) {
     m_rgbImage->origin = 0;
@@ -326,17 +529,10 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
     if (action==HV_PROCESS_FRAME) {
       // adjust exposure
       CheckAndCorrectExposure();
-      
-      // undistort image, adjust location of centroid
-      if (m_undistort) {
-        m_pUndistortion->Undistort(m_rgbImage);
-    //    m_pUndistortion->Transform(centroid);
-      }
     }
     
-    KeepStatistics(action);
-    DrawOverlay();
-    SendEvent();
+    // undistort image in FinishFrame
+    TakeSnapshot(action, action==HV_PROCESS_FRAME && m_undistort, result);
 
     return action;
   }
@@ -356,12 +552,12 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
     int cvt_height = min(m_scan_area.bottom+scan_height/2, m_rgbImage->height)-cvt_top;
     ASSERT(cvt_height>0 && cvt_width>0);
     if (!(cvt_height>0 && cvt_width>0)) {
-      KeepStatistics(action);
-      DrawOverlay();
-      SendEvent();
+      TakeSnapshot(action, false, result);
 
       return action;
     }
+    CuTraceSpan convert_span("convert");
+    RefTime t_convert_start = m_pTimer->GetCurrentTimeUsec();
     cvSetImageROI(m_rgbImage, cvRect(cvt_left, cvt_top, cvt_width, cvt_height));
     cvSetImageROI(m_grayImages[m_curr_buf_indx], cvRect(cvt_left, cvt_top, cvt_width, cvt_height));
 
@@ -369,39 +565,70 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
     
     cvResetImageROI(m_rgbImage);
     cvResetImageROI(m_grayImages[m_curr_buf_indx]);
+    m_metrics.AddTime(Metrics::MS_CONVERT,
+      (double) (m_pTimer->GetCurrentTimeUsec()-t_convert_start));
   }
 
-  // do the all-important, fast KLT tracking
-  m_recognized = false;
-  if (m_tracking) {    
-    m_tracking = DoTracking();
-    if (!m_tracking) {
-      // lost tracking
-      StartRecognition();
+  // do the all-important, fast KLT tracking, of all objects at once
+  RefTime t_track_start = m_pTimer->GetCurrentTimeUsec();
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj]) {
+      m_objects[obj]->recognized = false;
     }
   }
+  if (GetNumTracking()>0) {
+    {
+      CuTraceSpan track_span("track");
+      TrackObjects();
+    }
+    m_metrics.AddTime(Metrics::MS_TRACK,
+      (double) (m_pTimer->GetCurrentTimeUsec()-t_track_start));
+    UpdateScanArea();
+  }
+  RefTime t_track_end = m_pTimer->GetCurrentTimeUsec();
 
   // take the recommendation from CheckLatency to heart
   if (action!=HV_PROCESS_FRAME) {
-    KeepStatistics(action);
-    DrawOverlay();
-    SendEvent();
+    TakeSnapshot(action, false, result);
 
     return action;
   }
 
-  if (m_tracking) {    
-    m_recognized = DoRecognition();
-    FindSecondHand();
-  
-  } else {
-    m_recognized = DoDetection();
+  // recognize the postures of the tracked objects, one after the
+  // other since the scanners are shared, then look for the next object
+  ApplyScanQuality();
+  RefTime t_scan_start = m_pTimer->GetCurrentTimeUsec();
+  if (GetNumTracking()>0) {
+    {
+      CuTraceSpan recognize_span("recognize");
+      for (int obj=0; obj<MAX_OBJECTS; obj++) {
+        if (m_objects[obj] && m_objects[obj]->tracking) {
+          m_objects[obj]->recognized = DoRecognition(*m_objects[obj]);
+        }
+      }
+    }
+    m_metrics.AddTime(Metrics::MS_RECOGNIZE,
+      (double) (m_pTimer->GetCurrentTimeUsec()-t_scan_start));
+  }
+  TrackedObject* pSearched = GetSearchedObject();
+  if (pSearched) {
+    RefTime t_detect_start = m_pTimer->GetCurrentTimeUsec();
+    {
+      CuTraceSpan detect_span("detect", "object", pSearched->id);
+      pSearched->recognized = DoDetection(*pSearched);
+    }
+    m_metrics.AddTime(Metrics::MS_DETECT,
+      (double) (m_pTimer->GetCurrentTimeUsec()-t_detect_start));
   }
+  RefTime t_scan_end = m_pTimer->GetCurrentTimeUsec();
 
-  if (m_recognized && m_do_track) {
-    InitializeTracking();
-    m_tracking = true;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->recognized && m_do_track) {
+      InitializeTracking(*m_objects[obj]);
+      m_objects[obj]->tracking = true;
+    }
   }
+  UpdateScanArea();
 
   // restrict the general color segmentation ROI; this is
   // not really important for anything but high overlay_levels
@@ -411,39 +638,56 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
   int scan_bottom = min(m_scan_area.bottom, m_rgbImage->height);
   CRect scan_area(scan_left, scan_top, scan_right, scan_bottom);
 
-  // use stereo correspondence to obtain distance of hand from camera
-  if (m_tracking && rightImage) {
-    int sz = (scan_right-scan_left)/5;
-    CvRect area = cvRect((int)m_center_pos.x-sz, (int)m_center_pos.y-sz, 2*sz, 2*sz);
-    CalculateDepth(rightImage, area);
+  // use stereo correspondence to obtain distance of hands from camera
+  for (int obj=0; rightImage && obj<MAX_OBJECTS; obj++) {
+    TrackedObject* pObj = m_objects[obj];
+    if (pObj==NULL || !pObj->tracking) {
+      continue;
+    }
+    int sz = (pObj->scan_area.right-pObj->scan_area.left)/5;
+    CvRect area = cvRect((int)pObj->center_pos.x-sz,
+                         (int)pObj->center_pos.y-sz, 2*sz, 2*sz);
+    pObj->center_depth = CalculateDepth(rightImage, area);
   }
   
   // adjust exposure
   CheckAndCorrectExposure();
 
   // drawing
-  m_pSkincolor->DrawOverlay(m_rgbImage, m_overlay_level, CRect(m_last_match));
-  if (m_tracking) {
+  RefTime t_overlay_start = m_pTimer->GetCurrentTimeUsec();
+  CuTraceSpan overlay_span("overlay");
+  m_pSkincolor->DrawOverlay(m_rgbImage, m_overlay_level, m_dt_verified_area);
+  if (GetNumTracking()>0) {
     m_pLearnedColor->DrawOverlay(m_rgbImage, m_overlay_level, scan_area);
   }
   m_pCubicle->DrawOverlay(m_rgbImage, m_overlay_level);
 
-  if (m_tracking) {
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj]==NULL || !m_objects[obj]->tracking) {
+      continue;
+    }
     if (m_pConductor->m_tr_type & VisionConductor::VC_TT_CAMSHIFT) {
-      m_pCamShift->DrawOverlay(m_rgbImage, m_overlay_level);
+      m_objects[obj]->pCamShift->DrawOverlay(m_rgbImage, m_overlay_level);
     } else {
-      m_pOpticalFlow->DrawOverlay(m_rgbImage, m_overlay_level);
+      m_objects[obj]->pOpticalFlow->DrawOverlay(m_rgbImage, m_overlay_level);
     }
   }
-  // undistort image, adjust location of centroid
-  if (m_undistort) {
-    m_pUndistortion->Undistort(m_rgbImage);
-//    m_pUndistortion->Transform(centroid);
+  result.overlay_time = m_pTimer->GetCurrentTimeUsec()-t_overlay_start;
+
+  // the time for everything but tracking and scanning includes that
+  // of FinishFrame, unless that runs in parallel
+  if (m_quality.IsOn()) {
+    RefTime t_end = m_pTimer->GetCurrentTimeUsec();
+    RefTime other = (t_end-m_t_start_timing)-(t_scan_end-t_track_start);
+    if (!m_pipelined) {
+      other += m_finish_time;
+    }
+    m_quality.Update((double)(t_scan_end-t_track_end),
+                     (double)(t_track_end-t_track_start), (double)other);
   }
 
-  KeepStatistics(action);
-  DrawOverlay();
-  SendEvent();
+  // undistort image in FinishFrame
+  TakeSnapshot(action, m_undistort, result);
 
   return action;
 }
@@ -451,6 +695,73 @@ HandVu::ProcessFrame(GrabbedImage& inOutImage, const IplImage* rightImage)
 * ----------------------------------------------------------
 */
 
+/* copy what DrawOverlay and SendEvent show of the current state
+*/
+void HandVu::TakeSnapshot(HVAction action, bool undistort,
+                          FrameResult& result) const
+{
+  result.action = action;
+  result.undistort = undistort;
+  result.t_start_processing = m_t_start_processing;
+  result.t_start_timing = m_t_start_timing;
+  if (m_last_latencies.size()>0) {
+    result.last_latency = m_last_latencies[m_last_latencies.size()-1];
+  } else {
+    result.last_latency = -1;
+  }
+  result.active = m_active;
+  result.zero_scan = m_scan_area.left>=m_scan_area.right 
+    || m_scan_area.top>=m_scan_area.bottom;
+  result.states.resize(1);
+  GetState(0, result.states[0]);
+  for (int obj=1; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->on) {
+      result.states.push_back(HVState());
+      GetState(obj, result.states.back());
+    }
+  }
+}
+
+/* the second stage of ProcessFrame: undistortion, statistics, HUD
+* overlay and event; uses only the FrameResult and state that no
+* other stage touches
+*/
+void HandVu::FinishFrame(const FrameResult& result)
+{
+  CuTraceSpan span("finish");
+  RefTime t_start = m_pTimer->GetCurrentTimeUsec();
+
+  // undistort image, adjust location of centroid
+  if (result.undistort) {
+    CuTraceSpan undistort_span("undistort");
+    m_pUndistortion->Undistort(result.image);
+//    m_pUndistortion->Transform(centroid);
+  }
+
+  KeepStatistics(result);
+  RefTime t_overlay_start = m_pTimer->GetCurrentTimeUsec();
+  {
+    CuTraceSpan overlay_span("overlay");
+    DrawOverlay(result);
+  }
+  RefTime t_send_start = m_pTimer->GetCurrentTimeUsec();
+  {
+    CuTraceSpan send_span("send");
+    SendEvent(result.states);
+  }
+  RefTime t_end = m_pTimer->GetCurrentTimeUsec();
+
+  m_metrics.AddTime(Metrics::MS_OVERLAY,
+    (double) (result.overlay_time+t_send_start-t_overlay_start));
+  m_metrics.AddTime(Metrics::MS_SEND, (double) (t_end-t_send_start));
+  if (result.action!=HV_DROP_FRAME) {
+    m_metrics.AddTime(Metrics::MS_LATENCY, 
+      (double) (m_pClock->GetCurrentTimeUsec()-result.states[0].m_tstamp));
+  }
+
+  m_finish_time = t_end-t_start;
+}
+
 
 /* C/C++ interface for AsyncProcessor
  */
@@ -462,11 +773,38 @@ void* asyncProcessor(void* arg)
   }
   HandVu* hv = (HandVu*) arg;
   hv->AsyncProcessor();
+  return NULL;
 }
 
-/* allocate internal ring buffer, start processing thread
+/* C/C++ interface for AsyncOutput
  */
-void HandVu::AsyncSetup(int num_buffers, DisplayCallback* pDisplayCB)
+void* asyncOutput(void* arg)
+{
+  if (arg==NULL) {
+    fprintf(stderr, "asyncOutput: no argument!!\n");
+    return NULL;
+  }
+  HandVu* hv = (HandVu*) arg;
+  hv->AsyncOutput();
+  return NULL;
+}
+
+/* C/C++ interface for AsyncRelease
+ */
+void asyncRelease(void* arg, int id)
+{
+  HandVu* hv = (HandVu*) arg;
+  hv->AsyncRelease(id);
+}
+
+/* allocate internal ring buffer, start processing thread.
+ * If pipelined, a second thread finishes the frames (undistortion,
+ * overlay, event, DisplayCallback) while the processing thread
+ * analyzes the next one.  Not available on WIN32 yet, where the
+ * processing thread does both.
+ */
+void HandVu::AsyncSetup(int num_buffers, DisplayCallback* pDisplayCB,
+                        bool pipelined)
 {
   // sanity checks
   if(!m_initialized) {
@@ -481,82 +819,184 @@ void HandVu::AsyncSetup(int num_buffers, DisplayCallback* pDisplayCB)
     throw HVException("DisplayCallback can not be NULL");
   }
 
-  // allocate ring buffer
-  m_ring_buffer.resize(num_buffers);
-  m_ring_buffer_occupied.resize(num_buffers);
-  for (int b=0; b<num_buffers; b++) {
-    CvSize size = cvSize(m_img_width, m_img_height);
-    m_ring_buffer[b] = cvCreateImage(size, IPL_DEPTH_8U, 3);
-    m_ring_buffer_occupied[b] = false;
+  // allocate ring buffer, with room for registered buffers
+  m_ring_buffer.resize(MAX_ASYNC_BUFFERS);
+  m_ring_buffer_times.resize(MAX_ASYNC_BUFFERS);
+  for (int b=0; b<MAX_ASYNC_BUFFERS; b++) {
+    if (b<num_buffers) {
+      CvSize size = cvSize(m_img_width, m_img_height);
+      m_ring_buffer[b] = cvCreateImage(size, IPL_DEPTH_8U, 3);
+    } else {
+      m_ring_buffer[b] = NULL;
+    }
+    m_ring_buffer_times[b] = 0;
   }
+  m_frame_queue.Resize(num_buffers, MAX_ASYNC_BUFFERS);
+  m_frame_queue.SetReleaseHook(asyncRelease, this);
 
   m_pDisplayCallback = pDisplayCB;
+
+#if !defined(WIN32)
+  // start output thread, it will suspend itself if
+  // m_output_queue is empty
+  if (pipelined) {
+    m_pipelined = true;
+    m_pOutputThread = new Thread(asyncOutput, this);
+    m_pOutputThread->Start();
+  }
+#endif // WIN32
   
-  // start processing thread, it will suspended itself if
-  // m_process_queue is empty
+  // start processing thread, it will wait in m_frame_queue.Pop
+  // if no frame is queued
   m_pAsyncThread = new Thread(asyncProcessor, this);
   m_pAsyncThread->Start();
 }
 
 
-/* insert the frame in the processing queue
+/* insert the frame in the processing queue; the buffer must come
+ * from AsyncGetImageBuffer, or be a registered buffer that was
+ * released since its last use
  */
 void HandVu::AsyncProcessFrame(int id, RefTime& t)
 {
-  // insert in queue
-  GrabbedImage gi(m_ring_buffer[id], t, id);
-  m_process_queue.push_back(gi);
-  
-  // wake up processing thread
-  m_pAsyncThread->Resume();
+  if (id<0 || (int)m_ring_buffer.size()<=id || m_ring_buffer[id]==NULL) {
+    throw HVException("invalid ring buffer id");
+  }
+  if (m_frame_queue.IsPooled(id)!=m_frame_queue.IsOccupied(id)) {
+    throw HVException(m_frame_queue.IsPooled(id)
+                      ? "ring buffer was not taken with AsyncGetImageBuffer"
+                      : "registered buffer was not released yet");
+  }
+  // the queue publishes the time along with the id
+  m_ring_buffer_times[id] = t;
+  m_frame_queue.Push(id);
 }
 
 
 /* give the capture application a handle to an unused image in
-   the ring buffer
+   the ring buffer; if all are in use, the drop policy decides
+   whether to wait or to take back the oldest unprocessed frame
 */
 void HandVu::AsyncGetImageBuffer(IplImage** pImg, int* pID)
 {
-  // this is the only place where we occupy buffers, so we
-  // don't have to use a mutex (of course, we might fail
-  // for no good reason)
-  for (int b=0; b<(int)m_ring_buffer.size(); b++) {
-    if (!m_ring_buffer_occupied[b]) {
-      *pImg = m_ring_buffer[b];
-      *pID  = b;
-      return;
-    }
+  int b = m_frame_queue.Acquire();
+  if (b==-1) {
+    throw HVException("async processing has been stopped");
   }
-  throw HVException("exceeded ring buffer size");
+  *pImg = m_ring_buffer[b];
+  *pID  = b;
+}
+
+
+/* let the processing thread work on the application's memory rather
+ * than on a copy in a ring buffer: the frames must be 8-bit BGR in
+ * the initialized size.  The returned id can be used with
+ * AsyncProcessFrame, again and again once the ReleaseCallback
+ * returned it.  Buffers can not be unregistered.
+ */
+void HandVu::AsyncRegisterBuffer(char* data, int widthStep, int origin,
+                                 int* pID)
+{
+  if (m_pAsyncThread==NULL) {
+    throw HVException("async processing not set up, cannot register buffer");
+  }
+  if (data==NULL || widthStep<3*m_img_width) {
+    throw HVException("invalid buffer data or widthStep");
+  }
+  int id = m_frame_queue.Add();
+  if (id==-1) {
+    throw HVException("exceeded number of async buffers");
+  }
+  IplImage* img = cvCreateImageHeader(cvSize(m_img_width, m_img_height),
+                                      IPL_DEPTH_8U, 3);
+  cvSetData(img, data, widthStep);
+  img->origin = origin;
+  m_ring_buffer[id] = img;
+  *pID = id;
+}
+
+
+/* pReleaseCB is told when a registered buffer is done with, after
+ * processing and the DisplayCallback, or if it was dropped; it is
+ * called from the HandVu thread that is done with it, or from the
+ * one that calls AsyncGetImageBuffer
+ */
+void HandVu::AsyncSetReleaseCallback(ReleaseCallback* pReleaseCB)
+{
+  m_pReleaseCallback = pReleaseCB;
+}
+
+
+void HandVu::AsyncRelease(int id)
+{
+  if (m_pReleaseCallback) {
+    m_pReleaseCallback->Release(id);
+  }
+}
+
+
+/* what AsyncGetImageBuffer does if all buffers are in use
+ */
+void HandVu::SetAsyncDropPolicy(FrameQueue::DropPolicy policy)
+{
+  m_frame_queue.SetDropPolicy(policy);
 }
 
 
 void HandVu::AsyncProcessor()
 {
-  for (;;) {
-    // suspend this thread if processing queue is empty
-    m_pAsyncThread->Lock();
-    if (m_process_queue.empty()) {
-      m_pAsyncThread->Suspend();
+  // Pop waits while the queue is empty and fails once it is closed
+  int id;
+  while (m_frame_queue.Pop(id)) {
+    GrabbedImage gi(m_ring_buffer[id], m_ring_buffer_times[id], id);
+    m_metrics.SetCount(Metrics::MS_QUEUE_DROPPED,
+                       (unsigned int) m_frame_queue.GetNumDropped());
+
+    if (m_pipelined) {
+      // hand the frame over to the output thread; frames hold
+      // ring buffers, so the queue can not grow beyond their number
+      FrameResult result;
+      AnalyzeFrame(gi, NULL, result);
+      m_pOutputThread->Lock();
+      m_output_queue.push_back(result);
+      m_pOutputThread->Resume();
+      m_pOutputThread->Unlock();
+      continue;
     }
-    m_pAsyncThread->Unlock();
-    
-    while (!m_quit_thread && !m_process_queue.empty()) {
-      // get front of queue - don't lock
-      GrabbedImage gi = m_process_queue.front();
-      m_process_queue.pop_front();
-      
-      ASSERT(m_ring_buffer_occupied[gi.GetBufferID()]);
-      HVAction action = ProcessFrame(gi);
-      m_pDisplayCallback->Display(gi.GetImage(), action);
-      
-      // free up the buffer - we don't have to lock
-      m_ring_buffer_occupied[gi.GetBufferID()] = false;
+    HVAction action = ProcessFrame(gi);
+    m_pDisplayCallback->Display(gi.GetImage(), action);
+
+    // free up the buffer
+    m_frame_queue.Release(id);
+  }
+  m_pAsyncThread->Stop();
+}
+
+
+/* the output stage of the pipelined async mode: finishes the frames
+ * in the order AsyncProcessor analyzed them
+ */
+void HandVu::AsyncOutput()
+{
+  for (;;) {
+    m_pOutputThread->Lock();
+    while (!m_quit_thread && m_output_queue.empty()) {
+      m_pOutputThread->Suspend();
     }
-    
     if (m_quit_thread) {
-      m_pAsyncThread->Stop();
+      m_pOutputThread->Unlock();
+      m_pOutputThread->Stop();
+      return;
     }
+    FrameResult result = m_output_queue.front();
+    m_output_queue.pop_front();
+    m_pOutputThread->Unlock();
+
+    FinishFrame(result);
+    m_pDisplayCallback->Display(result.image, result.action);
+
+    // free up the buffer
+    m_frame_queue.Release(result.buffer_id);
   }
 }
 
@@ -566,6 +1006,7 @@ HandVu::HVAction HandVu::CheckLatency()
   ASSERT(m_pClock);
 
   m_t_start_processing = m_pClock->GetCurrentTimeUsec();
+  m_t_start_timing = m_pTimer->GetCurrentTimeUsec();
 
   RefTime incoming_latency = 
     max((RefTime)0, m_t_start_processing-m_sample_time);
@@ -627,12 +1068,20 @@ HandVu::HVAction HandVu::CheckLatency()
       }
       return HV_DROP_FRAME;
     }
-    VERBOSE1(3, "HandVu: skipping frame (latency %ldms)", incoming_latency/1000);
-    return HV_SKIP_FRAME;
+    // the quality controller rather lowers the quality
+    if (!m_quality.IsOn()) {
+      VERBOSE1(3, "HandVu: skipping frame (latency %ldms)", incoming_latency/1000);
+      return HV_SKIP_FRAME;
+    }
   }
 
   m_num_succ_dropped_frames = 0;
 
+  if (m_quality.SkipFrame()) {
+    VERBOSE0(3, "HandVu: skipping frame for the target frame time");
+    return HV_SKIP_FRAME;
+  }
+
   static bool quickreturn = false;
   //  quickreturn = !quickreturn;
   if (quickreturn) return HV_SKIP_FRAME;
@@ -641,47 +1090,25 @@ HandVu::HVAction HandVu::CheckLatency()
 }
 
 
-void HandVu::KeepStatistics(HVAction action)
+void HandVu::KeepStatistics(const FrameResult& result)
 {
-  // times of frames: all frames
   RefTime t_curr = m_pClock->GetCurrentTimeUsec();
-  m_frame_times.push_back(t_curr);
-  if (action==HV_PROCESS_FRAME) {
-    // completely processed frames
-    m_processed_frame_times.push_back(t_curr);
-  }
-  // processing time
-  RefTime prcs_time = t_curr-m_t_start_processing; // micro-second units
-  if (action==HV_PROCESS_FRAME || action==HV_SKIP_FRAME) {
-    m_prcs_times.push_back(prcs_time);
-  } else {
-    m_prcs_times.push_back(-1);
-  }
-
-  // keep only times from within the last second
-  // in the three _times arrays
-
-  // all frames that we saw
-  RefTime ago = t_curr-m_frame_times.front();
-  while (ago>1000000) { // 1 second
-    m_frame_times.erase(m_frame_times.begin());
-    m_prcs_times.erase(m_prcs_times.begin());
-    ago = t_curr-m_frame_times.front();
-    // we're guaranteed to have one element in there with ago==0,
-    // so we won't pop the list empty
-  }
-
-  // completed frames
-  while (!m_processed_frame_times.empty()) {
-    ago = t_curr-m_processed_frame_times.front();
-    if (ago<=1000000) { // 1 second
+  // processing time, micro-second units
+  double prcs_time =
+    (double) (m_pTimer->GetCurrentTimeUsec()-result.t_start_timing);
+  switch (result.action) {
+    case HV_PROCESS_FRAME:
+      m_metrics.AddFrame((double) t_curr, prcs_time, Metrics::MS_PROCESSED);
       break;
-    }
-    m_processed_frame_times.erase(m_processed_frame_times.begin());
+    case HV_SKIP_FRAME:
+      m_metrics.AddFrame((double) t_curr, prcs_time, Metrics::MS_SKIPPED);
+      break;
+    default:
+      m_metrics.AddFrame((double) t_curr, -1, Metrics::MS_DROPPED);
   }
 }
 
-void HandVu::DrawOverlay()
+void HandVu::DrawOverlay(const FrameResult& result)
 {
   if (m_overlay_level>=1) {
     CvFont font;
@@ -690,25 +1117,10 @@ void HandVu::DrawOverlay()
                 1 /* thickness */);
 
     // frames per second and min/max processing times
-    int fps = (int) m_frame_times.size();
-    int processed_fps = (int) m_processed_frame_times.size();
-    RefTime min_prcs_time=-1, max_prcs_time=-1;
-    for (int f=0; f<(int)m_prcs_times.size(); f++) {
-      if (m_prcs_times[f]==-1) {
-        continue;
-      }
-      if (m_prcs_times[f]<min_prcs_time || min_prcs_time==-1) {
-        min_prcs_time = m_prcs_times[f];
-      } 
-      if (m_prcs_times[f]>max_prcs_time || max_prcs_time==-1) {
-        max_prcs_time = m_prcs_times[f];
-      }
-    }
-    if (min_prcs_time==-1) {
-      ASSERT(max_prcs_time==-1);
-      min_prcs_time = 0;
-      max_prcs_time = 0;
-    }
+    int fps, processed_fps;
+    double min_prcs_time, max_prcs_time;
+    m_metrics.GetFrameRates((double) m_pClock->GetCurrentTimeUsec(),
+                            fps, processed_fps, min_prcs_time, max_prcs_time);
 
     char str[256];
     sprintf(str, "%d (%d) fps, %d-%dms", fps, processed_fps, 
@@ -716,41 +1128,42 @@ void HandVu::DrawOverlay()
     CvSize textsize;
     int underline;
     cvGetTextSize( str, &font, &textsize, &underline );
-    CvPoint pos = cvPoint(m_rgbImage->width-textsize.width-5, textsize.height+10);
-    cvPutText(m_rgbImage, str, pos, &font, CV_RGB(0, 255, 0));
+    CvPoint pos = cvPoint(result.image->width-textsize.width-5, textsize.height+10);
+    cvPutText(result.image, str, pos, &font, CV_RGB(0, 255, 0));
 
     VERBOSE4(3, "HandVu: %d (%d) fps, %d-%dms latency", 
              fps, processed_fps, (int)(min_prcs_time/1000), (int)(max_prcs_time/1000));
 
-    if (m_overlay_level>=2 && m_last_latencies.size()>0) {
-      RefTime last = m_last_latencies[m_last_latencies.size()-1];
+    if (m_overlay_level>=2 && result.last_latency!=-1) {
+      RefTime last = result.last_latency;
       char str[256];
       sprintf(str, "(in latency: %dms)", (unsigned int)(last/1000)); 
       CvSize textsize;
       int underline;
       cvGetTextSize(str, &font, &textsize, &underline );
-      CvPoint pos = cvPoint(m_rgbImage->width/2-textsize.width, textsize.height+10);
-      cvPutText(m_rgbImage, str, pos, &font, CV_RGB(0, 255, 0));
+      CvPoint pos = cvPoint(result.image->width/2-textsize.width, textsize.height+10);
+      cvPutText(result.image, str, pos, &font, CV_RGB(0, 255, 0));
     }
 
-    if (m_tracking) {
-      CvPoint pos = cvPoint(cvRound(m_center_pos.x), cvRound(m_center_pos.y));
-      cvCircle(m_rgbImage, pos, 13, CV_RGB(0, 0, 0), CV_FILLED);
-      cvCircle(m_rgbImage, pos, 10, CV_RGB(255, 255, 255), CV_FILLED);
-//      cvCircle(m_rgbImage, cvPoint(cvRound(m_center_pos.x), cvRound(m_center_pos.y)), 
-  //             5, CV_RGB(255, 0, 0), CV_FILLED);
+    for (int s=0; s<(int)result.states.size(); s++) {
+      const HVState& state = result.states[s];
+      if (!state.m_tracked) {
+        continue;
+      }
+      CvPoint pos = cvPoint(cvRound(state.m_center_xpos*m_img_width),
+                            cvRound(state.m_center_ypos*m_img_height));
+      cvCircle(result.image, pos, 13, CV_RGB(0, 0, 0), CV_FILLED);
+      cvCircle(result.image, pos, 10, CV_RGB(255, 255, 255), CV_FILLED);
     }
 
     if (m_overlay_level>=3) {
       char str[256];
       char* ptr = str;
-      if (!m_active) {
+      if (!result.active) {
         sprintf(ptr, "inactive ");
         ptr += 9;
       }
-      if (m_scan_area.left>=m_scan_area.right
-          || m_scan_area.top>=m_scan_area.bottom) 
-      {
+      if (result.zero_scan) {
         sprintf(ptr, "zero-scan ");
         ptr += 10;
       }
@@ -767,42 +1180,93 @@ void HandVu::DrawOverlay()
         int underline;
         cvGetTextSize(str, &font, &textsize, &underline);
         CvPoint pos = cvPoint(10, textsize.height+10);
-        cvPutText(m_rgbImage, str, pos, &font, CV_RGB(0, 255, 0));
+        cvPutText(result.image, str, pos, &font, CV_RGB(0, 255, 0));
       }
     }
   }
 }
 
-bool HandVu::DoDetection()
+/* true if the center of area lies in one of the areas
+*/
+static bool CenterInAny(const CRect& area, const CRectVector& areas)
 {
-  // scan cubicles
-  // todo RefTime before = m_pClock->GetCurrentTimeUsec();
-  m_pCubicle->Process(m_grayImages[m_curr_buf_indx]);
-  // todo RefTime after = m_pClock->GetCurrentTimeUsec();
-  // todo FILE* fp = fopen("c:\\hv_tmp\\times.txt", "a+");
-  // todo RefTime took = after-before;
-  // todo fprintf(fp, "%u\n", took);
-  // todo fclose(fp);
+  int x = (area.left+area.right)/2;
+  int y = (area.top+area.bottom)/2;
+  for (int ac=0; ac<(int)areas.size(); ac++) {
+    if (areas[ac].left<=x && x<areas[ac].right
+        && areas[ac].top<=y && y<areas[ac].bottom) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* looks for obj, away from the objects that are tracked already:
+* skin-colored blobs and matches on those are left out
+*/
+bool HandVu::DoDetection(TrackedObject& obj)
+{
+  CRectVector tracked_areas;
+  for (int other=0; other<MAX_OBJECTS; other++) {
+    if (m_objects[other] && m_objects[other]->tracking) {
+      tracked_areas.push_back(GetObjectArea(*m_objects[other]));
+    }
+  }
+  SetDetectionScanners();
+
+  // scan cubicles: either everywhere, or only around skin-colored
+  // blobs; the latter misses hands in bad light and on dark skin,
+  // so there's a full scan every so often
+  if (m_pConductor->m_dt_mode==VisionConductor::VC_DM_SKIN_BLOBS
+      && m_dt_frames_since_full_scan<m_pConductor->m_dt_full_scan_interval-1)
+  {
+    m_dt_frames_since_full_scan++;
+    // once the color of this user's hand has been learned, use it
+    const ProbDistrProvider* pColor = NULL;
+    if (m_time_to_learn_color>0) {
+      pColor = m_pLearnedColor;
+    }
+    const int cell_size = 4;  // pixels
+    const int min_cells = 6;
+    m_pSkincolor->FindBlobs(m_rgbImage, m_scan_area, pColor,
+                            cell_size, min_cells, m_dt_blobs);
+    if (tracked_areas.size()) {
+      int num_blobs = 0;
+      for (int bc=0; bc<(int)m_dt_blobs.size(); bc++) {
+        if (!CenterInAny(m_dt_blobs[bc], tracked_areas)) {
+          m_dt_blobs[num_blobs++] = m_dt_blobs[bc];
+        }
+      }
+      m_dt_blobs.resize(num_blobs);
+    }
+    m_pCubicle->ProcessAreas(m_grayImages[m_curr_buf_indx],
+                             m_pConductor->m_dt_cascades_start,
+                             m_pConductor->m_dt_cascades_end,
+                             m_dt_blobs);
+  } else {
+    m_dt_frames_since_full_scan = 0;
+    m_pCubicle->Process(m_grayImages[m_curr_buf_indx]);
+  }
+  m_pCubicle->RemoveMatchesIn(tracked_areas);
   if (m_pCubicle->GotMatches()) {
-    m_last_match = m_pCubicle->GetBestMatch();
+    CuScanMatch match = m_pCubicle->GetBestMatch();
 
     // got a match, but how and where?
     // if m_dt_min_match_duration>0, we need more than a single match 
     // but instead a succession of matches within a certain radius
     // from each other
     if (m_dt_first_match_time==0) {
-      m_dt_first_match = m_last_match;
+      m_dt_first_match = match;
       m_dt_first_match_time = m_pClock->GetCurrentTimeUsec();
     }
       
-    VERBOSE4(4, "HandVu detection: area %d, %d, %d, %d", 
-             m_last_match.left, m_last_match.top, 
-             m_last_match.right, m_last_match.bottom);
+    VERBOSE5(4, "HandVu detection: obj_id %d, area %d, %d, %d, %d", obj.id,
+             match.left, match.top, match.right, match.bottom);
 
     // was the match close enough to the first match to be considered 
     // within the same area?
-    int curr_center_x = (m_last_match.left+m_last_match.right)/2;
-    int curr_center_y = (m_last_match.top+m_last_match.bottom)/2;
+    int curr_center_x = (match.left+match.right)/2;
+    int curr_center_y = (match.top+match.bottom)/2;
     int first_center_x =
       (m_dt_first_match.left+m_dt_first_match.right)/2;
     int first_center_y =
@@ -817,20 +1281,23 @@ bool HandVu::DoDetection()
           >= m_pConductor->m_dt_min_match_duration) 
       {
         // color verification
-        bool mostly_skin = VerifyColor();
+        bool mostly_skin = VerifyColor(match);
         if (mostly_skin) {
           // that's it!
-          // turn off detection
-          for (int cc=0; cc<m_pConductor->m_dt_cascades_end; cc++) {
-            cuSetScannerActive((CuCascadeID)cc, false);
-          }
+          obj.last_match = match;
           m_dt_first_match_time = 0;
 
+          // look here first next time detection scans with the prior
+          if (m_pConductor->m_dt_order==VisionConductor::VC_DO_PRIOR) {
+            for (int cc=m_pConductor->m_dt_cascades_start;
+                 cc<m_pConductor->m_dt_cascades_end; cc++) {
+              cuAddScanPrior((CuCascadeID)cc, 
+                             match.left, match.top, match.right, match.bottom);
+            }
+          }
+
           // set scan area for tracking and recognition
-          int halfwidth = (m_last_match.right-m_last_match.left)/2;
-          int halfheight = (m_last_match.bottom-m_last_match.top)/2;
-          SetScanAreaVerified(CRect(m_last_match.left-halfwidth, m_last_match.top-halfheight, 
-                                    m_last_match.right+halfwidth, m_last_match.bottom+halfheight));
+          SetScanAreaAround(obj, match);
 
           return true;
         }
@@ -844,43 +1311,45 @@ bool HandVu::DoDetection()
   return false;
 }
 
-bool HandVu::DoRecognition()
+bool HandVu::DoRecognition(TrackedObject& obj)
 {
-  // set scan areas and
-  // activate detection scanners
+  // de-activate detection scanners, set scan areas and
+  // activate recognition scanners
+  for (int cc=0; cc<m_pConductor->m_dt_cascades_end; cc++) {
+    cuSetScannerActive((CuCascadeID)cc, false);
+  }
   for (int cc=m_pConductor->m_rc_cascades_start;
        cc<m_pConductor->m_rc_cascades_end; cc++) {
-    cuSetScanArea((CuCascadeID)cc, 
-      m_scan_area.left, m_scan_area.top, m_scan_area.right, m_scan_area.bottom);
+    cuSetScanArea((CuCascadeID)cc, obj.scan_area.left, obj.scan_area.top,
+                  obj.scan_area.right, obj.scan_area.bottom);
     double sct = m_pConductor->m_rc_scale_tolerance;
-    cuSetScanScales((CuCascadeID)cc, m_last_match.scale/sct,
-                                 m_last_match.scale*sct);
+    cuSetScanScales((CuCascadeID)cc, obj.last_match.scale/sct,
+                                 obj.last_match.scale*sct);
     cuSetScannerActive((CuCascadeID)cc, true);
   }
 
   m_pCubicle->Process(m_grayImages[m_curr_buf_indx]);
   if (m_pCubicle->GotMatches()) {
-    m_last_match = m_pCubicle->GetBestMatch();
-    VERBOSE4(4, "HandVu detection: area %d, %d, %d, %d", 
-             m_last_match.left, m_last_match.top, 
-             m_last_match.right, m_last_match.bottom);
+    obj.last_match = m_pCubicle->GetBestMatch();
+    VERBOSE5(4, "HandVu recognition: obj_id %d, area %d, %d, %d, %d", obj.id,
+             obj.last_match.left, obj.last_match.top, 
+             obj.last_match.right, obj.last_match.bottom);
 
     // set scan area for future
-    int halfwidth = (m_last_match.right-m_last_match.left)/2;
-    int halfheight = (m_last_match.bottom-m_last_match.top)/2;
-    SetScanAreaVerified(CRect(m_last_match.left-halfwidth, m_last_match.top-halfheight, 
-                              m_last_match.right+halfwidth, m_last_match.bottom+halfheight));
+    SetScanAreaAround(obj, obj.last_match);
 
     return true;
   }
   return false;
 }
 
-bool HandVu::VerifyColor()
+bool HandVu::VerifyColor(const CuScanMatch& match)
 {
-  ConstMaskIt mask = m_pConductor->GetMask(m_last_match.name);
+  ConstMaskIt mask = m_pConductor->GetMask(cuGetMatchName(match),
+                                           match.cascadeID);
 
-  CRect roi(m_last_match);
+  CRect roi(match);
+  m_dt_verified_area = roi;
   double coverage =
     m_pSkincolor->GetCoverage(m_rgbImage, roi, mask, false);
   VERBOSE0(3, "HandVu verifyed color");
@@ -894,58 +1363,117 @@ bool HandVu::VerifyColor()
   return sufficient;
 }
 
-void HandVu::InitializeTracking()
+void HandVu::InitializeTracking(TrackedObject& obj)
 {
-  ConstMaskIt mask = m_pConductor->GetMask(m_last_match.name);
+  ConstMaskIt mask = m_pConductor->GetMask(cuGetMatchName(obj.last_match),
+                                           obj.last_match.cascadeID);
 
   // if we haven't done so for some time, and the image was taken after
   // m_time_to_learn_color:
   if (m_time_to_learn_color<=m_sample_time) {
     // learn the RGB lookup table and 
     // use it for subsequent segmentations
-    m_pLearnedColor->LearnFromGroundTruth(m_rgbImage, m_last_match, mask);
+    RefTime t_learn_start = m_pTimer->GetCurrentTimeUsec();
+    {
+      CuTraceSpan learn_span("color_learning");
+      m_pLearnedColor->LearnFromGroundTruth(m_rgbImage, obj.last_match, mask);
+    }
+    m_metrics.AddTime(Metrics::MS_COLOR_LEARNING,
+      (double) (m_pTimer->GetCurrentTimeUsec()-t_learn_start));
     m_time_to_learn_color = m_sample_time + m_min_time_between_learning_color;
   }
 
   if (m_pConductor->m_tr_type==VisionConductor::VC_TT_CAMSHIFT_HSV) {
-    m_pCamShift->PrepareTracking(m_rgbImage, NULL, CRect(m_last_match));
+    obj.pCamShift->PrepareTracking(m_rgbImage, NULL, CRect(obj.last_match));
 
   } else if (m_pConductor->m_tr_type==VisionConductor::VC_TT_CAMSHIFT_LEARNED) {
-    m_pCamShift->PrepareTracking(m_rgbImage, m_pLearnedColor, CRect(m_last_match));
+    obj.pCamShift->PrepareTracking(m_rgbImage, m_pLearnedColor,
+                                   CRect(obj.last_match));
 
   } else {
+    // fewer features at lower quality, but enough to keep tracking
+    int num_features = m_pConductor->m_tr_num_KLT_features;
+    if (m_quality.IsOn()) {
+      int min_features = min(num_features, 2*m_pConductor->m_tr_min_KLT_features);
+      num_features = max(min_features,
+                         cvRound(num_features*m_quality.GetTrackQuality()));
+    }
     // color segmentation provides a probability distribution to the
     // optical flow filter to place features
-    m_pOpticalFlow->PrepareTracking(m_rgbImage,
-                                    m_grayImages[m_curr_buf_indx],
-                                    m_curr_buf_indx,
-                                    m_pLearnedColor, 
-                                    m_last_match,
-                                    mask,
-                                    m_pConductor->m_tr_num_KLT_features,
-                                    m_pConductor->m_tr_winsize_width,
-                                    m_pConductor->m_tr_winsize_height,
-                                    m_pConductor->m_tr_min_feature_distance,
-                                    m_pConductor->m_tr_max_feature_error);
+    obj.pOpticalFlow->PrepareTracking(m_rgbImage,
+                                      m_grayImages[m_curr_buf_indx],
+                                      m_curr_buf_indx,
+                                      m_pLearnedColor, 
+                                      obj.last_match,
+                                      mask,
+                                      num_features,
+                                      m_pConductor->m_tr_winsize_width,
+                                      m_pConductor->m_tr_winsize_height,
+                                      m_pConductor->m_tr_min_feature_distance,
+                                      m_pConductor->m_tr_max_feature_error);
+  }
+
+  obj.center_pos.x = (obj.last_match.right+obj.last_match.left)/2.0f;
+  obj.center_pos.y = (obj.last_match.bottom+obj.last_match.top)/2.0f;
+}
+
+/* C/C++ interface for TrackObjects: tracks one object
+ */
+void trackObject(void* arg, int task)
+{
+  HandVu::TrackingTasks* pTasks = (HandVu::TrackingTasks*) arg;
+  HandVu::TrackedObject* pObj = pTasks->objects[task];
+  CuTraceSpan span("track_object", "object", pObj->id);
+  try {
+    pObj->lost = !pTasks->pHandVu->DoTracking(*pObj);
+  } catch (HVException& hve) {
+    pTasks->errors[task] = hve.GetMessage();
   }
+}
 
-  m_center_pos.x = (m_last_match.right+m_last_match.left)/2.0f;
-  m_center_pos.y = (m_last_match.bottom+m_last_match.top)/2.0f;
+/* tracks all tracked objects, on cubicles' worker threads; objects
+* that are lost are searched for again
+*/
+void HandVu::TrackObjects()
+{
+  TrackingTasks tasks;
+  tasks.pHandVu = this;
+  for (int obj=0; obj<MAX_OBJECTS; obj++) {
+    if (m_objects[obj] && m_objects[obj]->tracking) {
+      tasks.objects.push_back(m_objects[obj]);
+    }
+  }
+  tasks.errors.resize(tasks.objects.size());
+  cuRunTasks(trackObject, &tasks, (int) tasks.objects.size());
+
+  for (int task=0; task<(int)tasks.objects.size(); task++) {
+    if (tasks.errors[task]!="") {
+      throw HVException(tasks.errors[task]);
+    }
+    if (tasks.objects[task]->lost) {
+      // lost tracking
+      tasks.objects[task]->tracking = false;
+      RestartDetection();
+    }
+  }
 }
 
-bool HandVu::DoTracking()
+/* called concurrently for all objects, so that it must not change
+* anything but obj
+*/
+bool HandVu::DoTracking(TrackedObject& obj)
 {
   // the size of the last Cubicle match determines how far we let
   // KLT features spread (during the call to Track)
-  int last_width  = m_last_match.right-m_last_match.left;
-  int last_height = m_last_match.bottom-m_last_match.top;
+  int last_width  = obj.last_match.right-obj.last_match.left;
+  int last_height = obj.last_match.bottom-obj.last_match.top;
 
 
   if (m_pConductor->m_tr_type & VisionConductor::VC_TT_CAMSHIFT) {
-    m_pCamShift->Track(m_rgbImage);
-    m_pCamShift->GetArea(m_scan_area);
-    m_center_pos.x = (m_scan_area.right+m_scan_area.left)/2.0f;
-    m_center_pos.y = (m_scan_area.bottom+m_scan_area.top)/2.0f;
+    obj.pCamShift->Track(m_rgbImage);
+    obj.pCamShift->GetArea(obj.scan_area);
+    obj.center_pos.x = (obj.scan_area.right+obj.scan_area.left)/2.0f;
+    obj.center_pos.y = (obj.scan_area.bottom+obj.scan_area.top)/2.0f;
 
   } else {
     bool flock = m_pConductor->m_tr_type==VisionConductor::VC_TT_OPTICAL_FLOW_FLOCK;
@@ -954,12 +1482,12 @@ bool HandVu::DoTracking()
       flock = color = true;
     }
     int num_tracked =
-      m_pOpticalFlow->Track(m_rgbImage,
-                            m_grayImages[m_prev_buf_indx],
-                            m_grayImages[m_curr_buf_indx],
-                            m_prev_buf_indx, m_curr_buf_indx,
-                            last_width, last_height,
-                            flock, color);
+      obj.pOpticalFlow->Track(m_rgbImage,
+                              m_grayImages[m_prev_buf_indx],
+                              m_grayImages[m_curr_buf_indx],
+                              m_prev_buf_indx, m_curr_buf_indx,
+                              last_width, last_height,
+                              flock, color);
     
     if (num_tracked<m_pConductor->m_tr_min_KLT_features) {
       // lost tracking for sure
@@ -968,13 +1496,13 @@ bool HandVu::DoTracking()
       return false;
     }
 
-    m_pOpticalFlow->GetMeanFeaturePos(m_center_pos);
+    obj.pOpticalFlow->GetMeanFeaturePos(obj.center_pos);
     // VERBOSE1(4, "OpticalFlow features: %d\n", event.m_num_features_tracked);
   }
 
-  int rnx = cvRound(m_center_pos.x), rny = cvRound(m_center_pos.y);
-  SetScanAreaVerified(CRect(rnx-last_width, rny-last_height, 
-			    rnx+last_width, rny+last_height));
+  int rnx = cvRound(obj.center_pos.x), rny = cvRound(obj.center_pos.y);
+  SetScanAreaVerified(obj, CRect(rnx-last_width, rny-last_height, 
+			         rnx+last_width, rny+last_height));
 
   return true;
 }
@@ -1052,22 +1580,30 @@ void HandVu::CheckAndCorrectExposure()
   }
 }
 
-void HandVu::FindSecondHand()
+void HandVu::AddGestureServer(GestureServer* pServer)
 {
-  if (m_id1_on) {
-    CvPoint2D32f pos;
-    m_pOpticalFlow->GetMeanFeaturePos(pos);
-    double w = m_last_match.right - m_last_match.left;
-    double h = m_last_match.bottom - m_last_match.top;
-    CRect area(10, cvRound(pos.y+h/3), cvRound(pos.x-w/3), m_rgbImage->height-10);
-    // pos is output parameter:
-    m_pLearnedColor->GetMostRightUpBlob(m_rgbImage, area, pos);
-    m_id1_x = pos.x;
-    m_id1_y = pos.y;
+  m_servers.push_back(pServer);
+}
+
+/* one event per object, object 0 first
+*/
+void HandVu::SendEvent(const vector<HVState>& states) const
+{
+  if (m_servers.empty()) {
+    return;
+  }
+  for (int o=0; o<(int)states.size(); o++) {
+    HVState stamped = states[o];
+    stamped.m_tstamp_event = m_pClock->GetCurrentTimeUsec();
+    for (int s=0; s<(int)m_servers.size(); s++) {
+      m_servers[s]->Send(stamped);
+    }
   }
 }
 
-void HandVu::CalculateDepth(const IplImage* rightImage, const CvRect& area)
+/* the mean disparity in area, which is drawn into the image
+*/
+double HandVu::CalculateDepth(const IplImage* rightImage, const CvRect& area)
 {
 	cvSetImageROI((IplImage*)rightImage, area);
 	cvSetImageROI(m_rightGrayImage, area);
@@ -1092,7 +1628,7 @@ void HandVu::CalculateDepth(const IplImage* rightImage, const CvRect& area)
   cvResetImageROI(m_rgbImage);
 
   CvScalar s = cvAvg(m_depthImage);
-  m_center_depth = s.val[0];
+  return s.val[0];
 }
 
 /* SetDetectionArea sets the detection scan area in the video. 
@@ -1104,10 +1640,14 @@ void HandVu::SetDetectionArea(int left, int top, int right, int bottom)
   // righten area, smaller numbers to left and up
   CRect scan_area(min(left, right), min(top, bottom),
                   max(left, right), max(top, bottom));
+  if (!ConductorLoaded()) {
+    return;
+  }
+  m_pCubicle->MakeCurrent();
   for (int scc=0; scc<m_pConductor->m_dt_cascades_end; scc++) {
     cuSetScanArea((CuCascadeID)scc, 
       scan_area.left, scan_area.top, scan_area.right, scan_area.bottom);
-    m_pConductor->m_orig_areas[scc].fromRect(scan_area, m_img_width, m_img_height);
+    m_orig_areas[scc].fromRect(scan_area, m_img_width, m_img_height);
   }
 }
 
@@ -1116,8 +1656,9 @@ void HandVu::GetDetectionArea(CQuadruple& area) const
   // righten area, smaller numbers to left and up
   area.left = area.top = 1.0;
   area.right = area.bottom = 0.0;
-  for (int scc=0; scc<m_pConductor->m_dt_cascades_end; scc++) {
-    const CQuadruple& curr = m_pConductor->m_orig_areas[scc];
+  int num_dt_cascades = ConductorLoaded() ? m_pConductor->m_dt_cascades_end : 0;
+  for (int scc=0; scc<num_dt_cascades; scc++) {
+    const CQuadruple& curr = m_orig_areas[scc];
     area.left = min(area.left, curr.left);
     area.right = max(area.right, curr.right);
     area.top = min(area.top, curr.top);
@@ -1199,53 +1740,49 @@ void HandVu::GetState(int id, HVState& state) const
 {
   ASSERT(m_pClock);
   state.m_tstamp = m_sample_time;
+  state.m_tstamp_processing = m_t_start_processing;
+  state.m_tstamp_event = m_pClock->GetCurrentTimeUsec();
   state.m_obj_id = id;
+  m_pCubicle->MakeCurrent();
 
+  if (id<0 || id>=MAX_OBJECTS) {
+    throw HVException("nothing known about this ID");
+  }
   if (!m_active) {
     state.m_tracked = false;
     state.m_recognized = false;
     return;
   }
 
-  if (id==0) {
-    state.m_tracked = m_tracking;
-    state.m_recognized = m_recognized;
-    if (m_tracking || m_recognized) {
-      state.m_center_xpos = m_center_pos.x/(float)m_img_width;
-      state.m_center_ypos = m_center_pos.y/(float)m_img_height;
-      state.m_scale = m_center_depth?m_center_depth:m_last_match.scale;
-    } else {
-      state.m_center_xpos = -1;
-      state.m_center_ypos = -1;
-      state.m_scale = 0;
+  const TrackedObject* pObj = m_objects[id];
+  if (pObj==NULL || !pObj->on) {
+    if (id!=0) {
+      throw HVException("object ID is not being searched for");
     }
-    if (m_recognized) {
-      state.m_posture = m_last_match.name;
-    } else {
-      state.m_posture = "";
-    }
-    
-  } else if (id==1) {
-    if (!m_id1_on) {
-      throw HVException("object ID1 is not being searched for");
-    }
-    if (m_id1_x==-1 || m_id1_y==-1) {
-      state.m_tracked = false;
-      state.m_center_xpos = -1;
-      state.m_center_ypos = -1;
-      state.m_recognized = false;
-      state.m_posture = "";
-      
-    } else {
-      state.m_tracked = true;
-      state.m_center_xpos = m_id1_x / m_img_width;
-      state.m_center_ypos = m_id1_y / m_img_height;
-      state.m_recognized = false;
-      state.m_posture = "";
-    }
-    
+    state.m_tracked = false;
+    state.m_recognized = false;
+    state.m_center_xpos = -1;
+    state.m_center_ypos = -1;
+    state.m_scale = 0;
+    state.m_posture = "";
+    return;
+  }
+
+  state.m_tracked = pObj->tracking;
+  state.m_recognized = pObj->recognized;
+  if (pObj->tracking || pObj->recognized) {
+    state.m_center_xpos = pObj->center_pos.x/(float)m_img_width;
+    state.m_center_ypos = pObj->center_pos.y/(float)m_img_height;
+    state.m_scale = pObj->center_depth?pObj->center_depth:pObj->last_match.scale;
   } else {
-    throw HVException("nothing known about this ID");
+    state.m_center_xpos = -1;
+    state.m_center_ypos = -1;
+    state.m_scale = 0;
+  }
+  if (pObj->recognized) {
+    state.m_posture = cuGetMatchName(pObj->last_match);
+  } else {
+    state.m_posture = "";
   }
 }
 
@@ -1272,29 +1809,88 @@ coverage, TestLearned
 */
 }
 
-void HandVu::SetScanAreaVerified(const CRect& area)
+/* around a match, by half its size on each side at full quality,
+* by a quarter at minimum quality
+*/
+void HandVu::SetScanAreaAround(TrackedObject& obj, const CuScanMatch& match)
+{
+  double margin = 0.5;
+  if (m_quality.IsOn()) {
+    margin *= max(0.5, sqrt(m_quality.GetScanQuality()));
+  }
+  int marginwidth = (int)((match.right-match.left)*margin);
+  int marginheight = (int)((match.bottom-match.top)*margin);
+  SetScanAreaVerified(obj,
+                      CRect(match.left-marginwidth, match.top-marginheight, 
+                            match.right+marginwidth, match.bottom+marginheight));
+}
+
+/* the scan quality is about the fraction of the windows of a full
+* quality scan: the translation increments and the logarithm of the
+* scale increment factor grow by its inverse cube root each.  Called
+* by the processing thread only, so that the scanners do not change
+* during a scan.
+*/
+void HandVu::ApplyScanQuality()
+{
+  double quality = m_quality.GetScanQuality();
+  if (quality==m_applied_scan_quality) {
+    return;
+  }
+  double inc = pow(quality, -1.0/3.0);
+  for (int cc=0; cc<(int)m_full_quality_params.size(); cc++) {
+    const CuScannerParameters& full = m_full_quality_params[cc];
+    CuScannerParameters sp;
+    // keep scan area, scales and activity as set for this frame
+    cuGetScannerParameters((CuCascadeID)cc, sp);
+    sp.translation_inc_x = full.translation_inc_x*inc;
+    sp.translation_inc_y = full.translation_inc_y*inc;
+    sp.scale_inc_factor = pow(full.scale_inc_factor, inc);
+    cuSetScannerParameters((CuCascadeID)cc, sp);
+  }
+  m_applied_scan_quality = quality;
+  VERBOSE1(3, "HandVu: scan quality %f", quality);
+}
+
+/* a target for the processing time of one frame; rather than skip
+* frames when they come in late, HandVu then adapts the quality of
+* scanning and tracking to the time the frames take.  0 turns it
+* off and uses full quality.
+*/
+void HandVu::SetTargetFrameTime(RefTime usec)
+{
+  m_quality.SetTargetFrameTime((double)usec);
+}
+
+RefTime HandVu::GetTargetFrameTime() const
+{
+  return (RefTime) m_quality.GetTargetFrameTime();
+}
+
+void HandVu::SetScanAreaVerified(TrackedObject& obj, const CRect& area)
 {
   double maxwidth = m_img_width*m_pConductor->m_rc_max_scan_width;
   if (area.right-area.left > maxwidth) {
     double halfwidth = maxwidth/2.0;
     double center = (double)(area.right+area.left)/2.0;
-    m_scan_area.left = (int)(center-halfwidth);
-    m_scan_area.right = (int)(center+halfwidth);
+    obj.scan_area.left = (int)(center-halfwidth);
+    obj.scan_area.right = (int)(center+halfwidth);
   } else {
-    m_scan_area.left = area.left;
-    m_scan_area.right = area.right;
+    obj.scan_area.left = area.left;
+    obj.scan_area.right = area.right;
   }
   double maxheight = m_img_height*m_pConductor->m_rc_max_scan_height;
   if (area.bottom-area.top > maxheight) {
     double halfheight = maxheight/2.0;
     double center = (double)(area.top+area.bottom)/2.0;
-    m_scan_area.top = (int)(center-halfheight);
-    m_scan_area.bottom = (int)(center+halfheight);
+    obj.scan_area.top = (int)(center-halfheight);
+    obj.scan_area.bottom = (int)(center+halfheight);
   } else {
-    m_scan_area.top = area.top;
-    m_scan_area.bottom = area.bottom;
+    obj.scan_area.top = area.top;
+    obj.scan_area.bottom = area.bottom;
   }
-  VERBOSE4(4, "Set scan area to %d, %d, %d, %d", 
-           m_scan_area.left, m_scan_area.top, m_scan_area.right, m_scan_area.bottom);
+  VERBOSE5(4, "Set scan area of obj_id %d to %d, %d, %d, %d", obj.id,
+           obj.scan_area.left, obj.scan_area.top,
+           obj.scan_area.right, obj.scan_area.bottom);
 }
 
@@ -41,6 +41,11 @@ typedef REFERENCE_TIME RefTime;
 typedef long long RefTime;
 #endif // WIN32
 
+/* objects such as hands have obj_ids 0 to HV_MAX_OBJECTS-1;
+* the same as HandVu::MAX_OBJECTS
+*/
+#define HV_MAX_OBJECTS 8
+
 /* state for an object such as the right hand
 */
 typedef struct _hvState {
@@ -50,7 +55,9 @@ typedef struct _hvState {
   double     center_xpos, center_ypos;
   double     scale;
   string     posture;
-  RefTime    tstamp;
+  RefTime    tstamp;            // capture time of the frame
+  RefTime    tstamp_processing; // processing of the frame started
+  RefTime    tstamp_event;      // the state was queried or sent
 } hvState;
 
 enum hvAction {         // specify recommendations to application:
@@ -59,28 +66,119 @@ enum hvAction {         // specify recommendations to application:
   HV_SKIP_FRAME = 2,    // display but do not further process
   HV_DROP_FRAME = 3     // do not display the frame
 };
+
+enum hvStage {            // processing stages that hvGetMetrics times:
+  HV_STAGE_CONVERT = 0,         // gray scale conversion
+  HV_STAGE_TRACK = 1,
+  HV_STAGE_DETECT = 2,
+  HV_STAGE_RECOGNIZE = 3,
+  HV_STAGE_COLOR_LEARNING = 4,
+  HV_STAGE_OVERLAY = 5,
+  HV_STAGE_SEND = 6,
+  HV_STAGE_FRAME = 7,           // all of a fully processed frame
+  HV_STAGE_LATENCY = 8,         // capture to event
+  HV_NUM_STAGES = 9
+};
+
+/* times in micro-seconds, the percentiles are rounded up by at most
+ * 1/16th
+ */
+typedef struct _hvStageMetrics {
+  int        count;
+  double     mean, max;
+  double     p50, p95, p99;
+} hvStageMetrics;
+
+/* since hvInitialize or hvResetMetrics
+*/
+typedef struct _hvMetrics {
+  int        frames_processed;
+  int        frames_skipped;
+  int        frames_dropped;        // too late to process or display
+  int        frames_queue_dropped;  // async frames replaced before processing
+  int        fps, processed_fps;    // in the last second
+  hvStageMetrics stages[HV_NUM_STAGES];
+} hvMetrics;
+
+enum hvAsyncDropPolicy { // if hvAsyncGetImageBuffer finds all buffers in use:
+  HV_ASYNC_BLOCK = 0,       // wait until one was processed
+  HV_ASYNC_DROP_OLDEST = 1, // drop the oldest unprocessed frame (default)
+  HV_ASYNC_LATEST_WINS = 2  // same, and process only the newest queued one
+};
+
+/** one HandVu pipeline; see hvCreate below
+*/
+typedef struct _hvContext hvContext;
   
+/** the functions without a hvContext argument work on the context
+ *  that hvInitialize creates and hvUninitialize destroys
+ */
 void hvInitialize(int width, int height);
 void hvUninitialize();
 
 void hvLoadConductor(const string& filename);
 bool hvConductorLoaded();
 
+/** objects are searched for one after the other, each away from
+ *  those that are tracked already, and all are tracked at once, on
+ *  cubicles' threads (cuSetNumThreads); each sends its own events
+ */
 void hvStartRecognition(int obj_id=0);
 void hvStopRecognition(int obj_id=0);
 
+/** time stamps are in micro-seconds of a monotonic clock; frames are
+ *  stamped when they are passed to HandVu unless the application gives
+ *  their capture time, which it should take from hvGetCurrentTime
+ */
+RefTime hvGetCurrentTime();
+/** Replay: from the first call on, HandVu's clock stands at usec
+ *  until the next call, for example at the recorded capture time of
+ *  each frame, so that the same frames lead to the same actions and
+ *  events however fast they are processed; the stage times of
+ *  hvGetMetrics are still measured.  For hvProcessFrame only.
+ */
+void hvSetReplayTime(RefTime usec);
 hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage=NULL);
+hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage,
+                        RefTime capture_time);
 bool hvIsActive();
 
-void hvAsyncSetup(int num_buffers, void (*cb)(IplImage* img, hvAction action));
+/** if pipelined, the overlay, event and callback of a frame run in
+ *  a second thread while the next frame is processed (not on WIN32)
+ */
+void hvAsyncSetup(int num_buffers, void (*cb)(IplImage* img, hvAction action),
+                  bool pipelined=false);
 void hvAsyncGetImageBuffer(IplImage** pImage, int* pBufferID);
 void hvAsyncProcessFrame(int bufferID);
+void hvAsyncProcessFrame(int bufferID, RefTime capture_time);
+
+/** zero-copy alternative to hvAsyncGetImageBuffer: HandVu processes
+ *  the frame in the application's memory, 8-bit BGR of the initialized
+ *  size, widthStep bytes per row; origin as in IplImage.  Call after
+ *  hvAsyncSetup.  HandVu draws into the frame.  Once a buffer was
+ *  passed to hvAsyncProcessFrame, it belongs to HandVu until the
+ *  release callback returns it, after the display callback or if the
+ *  frame was dropped.
+ */
+void hvAsyncRegisterBuffer(char* data, int widthStep, int origin,
+                           int* pBufferID);
+void hvAsyncSetReleaseCallback(void (*cb)(int bufferID));
+void hvAsyncSetDropPolicy(hvAsyncDropPolicy policy);
 
 void hvGetState(int obj_id, hvState& state);
 
 void hvSetDetectionArea(int left, int top, int right, int bottom);
 void hvGetDetectionArea(int* pLeft, int* pTop, int* pRight, int* pBottom);
 void hvRecomputeNormalLatency();
+/** rather than skip frames that come in late, adapt the scan and
+ *  tracking quality so that processing a frame takes about usec
+ *  micro-seconds; frames are skipped only if that can not be met even
+ *  at the lowest quality.  0 turns this off (the default).
+ */
+void hvSetTargetFrameTime(RefTime usec);
+
+void hvGetMetrics(hvMetrics& metrics);
+void hvResetMetrics();
 
 void hvSetOverlayLevel(int level);
 int hvGetOverlayLevel();
@@ -104,6 +202,96 @@ void hvStartGestureServer(int port, int max_num_clients=10);
 void hvStartOSCServer(const string& desthost, int destport);
 void hvStopGestureServer(int port);
 void hvStopOSCServer(const string& desthost, int destport);
+/** answers HTTP requests on localhost with the metrics in Prometheus
+ *  text format, once per processed frame
+ */
+void hvStartMetricsServer(int port);
+
+/** Tracing: spans of every stage of processing a frame, and of the
+ *  scanners and scales, are kept for the most recent frames.  While
+ *  tracing is off, which is the default, they cost next to nothing.
+ *  hvWriteTrace writes them in the Chrome trace JSON format for
+ *  chrome://tracing or ui.perfetto.dev, in the background.
+ */
+void hvSetTracing(bool on);
+void hvWriteTrace(const string& filename);
+
+/** Contexts: each is a pipeline of its own, for example one per
+ *  camera, and may run on its own thread.  Conductor and cascade
+ *  files are parsed only once per process, and the contexts share
+ *  the conductors.  Every context scans with copies of the cascades,
+ *  though, since scanning scales their features (see
+ *  cuCreateContext).  Tracing and the version are per process.
+ */
+hvContext* hvCreate(int width, int height);
+void hvDestroy(hvContext* pContext);
+
+void hvLoadConductor(hvContext* pContext, const string& filename);
+bool hvConductorLoaded(hvContext* pContext);
+void hvStartRecognition(hvContext* pContext, int obj_id=0);
+void hvStopRecognition(hvContext* pContext, int obj_id=0);
+
+RefTime hvGetCurrentTime(hvContext* pContext);
+void hvSetReplayTime(hvContext* pContext, RefTime usec);
+hvAction hvProcessFrame(hvContext* pContext, IplImage* inOutImage,
+                        IplImage* rightImage=NULL);
+hvAction hvProcessFrame(hvContext* pContext, IplImage* inOutImage,
+                        IplImage* rightImage, RefTime capture_time);
+bool hvIsActive(hvContext* pContext);
+
+void hvAsyncSetup(hvContext* pContext, int num_buffers,
+                  void (*cb)(IplImage* img, hvAction action),
+                  bool pipelined=false);
+void hvAsyncGetImageBuffer(hvContext* pContext, IplImage** pImage,
+                           int* pBufferID);
+void hvAsyncProcessFrame(hvContext* pContext, int bufferID);
+void hvAsyncProcessFrame(hvContext* pContext, int bufferID,
+                         RefTime capture_time);
+void hvAsyncRegisterBuffer(hvContext* pContext, char* data, int widthStep,
+                           int origin, int* pBufferID);
+void hvAsyncSetReleaseCallback(hvContext* pContext,
+                               void (*cb)(int bufferID));
+void hvAsyncSetDropPolicy(hvContext* pContext, hvAsyncDropPolicy policy);
+
+void hvGetState(hvContext* pContext, int obj_id, hvState& state);
+
+void hvSetDetectionArea(hvContext* pContext,
+                        int left, int top, int right, int bottom);
+void hvGetDetectionArea(hvContext* pContext,
+                        int* pLeft, int* pTop, int* pRight, int* pBottom);
+void hvRecomputeNormalLatency(hvContext* pContext);
+void hvSetTargetFrameTime(hvContext* pContext, RefTime usec);
+
+void hvGetMetrics(hvContext* pContext, hvMetrics& metrics);
+void hvResetMetrics(hvContext* pContext);
+
+void hvSetOverlayLevel(hvContext* pContext, int level);
+int hvGetOverlayLevel(hvContext* pContext);
+
+void hvCorrectDistortion(hvContext* pContext, bool enable=true);
+bool hvIsCorrectingDistortion(hvContext* pContext);
+bool hvCanCorrectDistortion(hvContext* pContext);
+
+void hvSetAdjustExposure(hvContext* pContext, bool enable=true);
+bool hvCanAdjustExposure(hvContext* pContext);
+bool hvIsAdjustingExposure(hvContext* pContext);
+
+void hvSetLogfile(hvContext* pContext, const string& filename);
+void hvSaveScannedArea(hvContext* pContext, IplImage* pImg, string& picfile);
+void hvSaveImageArea(hvContext* pContext, IplImage* pImg,
+                     int left, int top, int right, int bottom, string& picfile);
+void hvSetSaveFilenameRoot(hvContext* pContext, const string& fname_root);
+
+void hvSetDoTrack(hvContext* pContext, bool do_track);
+
+void hvStartGestureServer(hvContext* pContext, int port,
+                          int max_num_clients=10);
+void hvStartOSCServer(hvContext* pContext, const string& desthost,
+                      int destport);
+void hvStopGestureServer(hvContext* pContext, int port);
+void hvStopOSCServer(hvContext* pContext, const string& desthost,
+                     int destport);
+void hvStartMetricsServer(hvContext* pContext, int port);
 
 /** verbosity: 0 minimal, 3 maximal
 */
@@ -35,6 +35,9 @@ using namespace std;
 #include "Quadruple.h"
 #include "Rect.h"
 #include "Thread.h"
+#include "FrameQueue.h"
+#include "QualityController.h"
+#include "Metrics.h"
 
 
 #ifdef USE_MFC
@@ -55,6 +58,8 @@ class Undistortion;
 class VisionConductor;
 class CamShift;
 class DisplayCallback;
+class ReleaseCallback;
+class GestureServer;
 
 
 /*
@@ -104,6 +109,7 @@ typedef vector<RefTime> RefTimeVector;
 // times in micro-seconds (Usec)
 class RefClock {
 public:
+  virtual ~RefClock() {}
   virtual RefTime GetCurrentTimeUsec() const = 0;
 };
 
@@ -120,7 +126,9 @@ class GrabbedImage {
   int       m_bufferID;
 };
 
-/* state for an object such as the right hand
+/* state for an object such as the right hand; the time stamps are
+* of the RefClock: when the frame was captured, when its processing
+* started, and when the state was sent or queried
 */
 class HVState {
  public:
@@ -131,6 +139,8 @@ class HVState {
   double     m_scale;
   string     m_posture;
   RefTime    m_tstamp;
+  RefTime    m_tstamp_processing;
+  RefTime    m_tstamp_event;
 };
 
 class HandVu {
@@ -142,7 +152,9 @@ class HandVu {
     HV_DROP_FRAME = 3     // do not display the frame
   };
   enum {
-    MAX_OVERLAY_LEVEL = 3
+    MAX_OVERLAY_LEVEL = 3,
+    MAX_ASYNC_BUFFERS = 100, // pooled and registered
+    MAX_OBJECTS = 8          // obj_ids 0 to MAX_OBJECTS-1, HV_MAX_OBJECTS
   };
 
   
@@ -152,6 +164,7 @@ class HandVu {
 
   void Initialize(int width, int height, RefClock* pClock, 
 		  CameraController* pCamCon);
+  void SetReferenceClock(RefClock* pClock);
   void LoadConductor(const string& filename);
   bool ConductorLoaded() const;
   void StartRecognition(int obj_id=0);
@@ -160,15 +173,23 @@ class HandVu {
   HVAction ProcessFrame(GrabbedImage& inOutImage,
                         const IplImage* rightImage=NULL);
 
-  void AsyncSetup(int num_buffers, DisplayCallback* pDisplayCB);
+  void AsyncSetup(int num_buffers, DisplayCallback* pDisplayCB,
+                  bool pipelined=false);
   void AsyncProcessFrame(int id, RefTime& t);
   void AsyncGetImageBuffer(IplImage** pImg, int* pID);
+  void AsyncRegisterBuffer(char* data, int widthStep, int origin, int* pID);
+  void AsyncSetReleaseCallback(ReleaseCallback* pReleaseCB);
+  void SetAsyncDropPolicy(FrameQueue::DropPolicy policy);
 
   void GetState(int obj_id, HVState& state) const;
 
   void SetDetectionArea(int left, int top, int right, int bottom);
   void GetDetectionArea(CQuadruple& area) const;
   void RecomputeNormalLatency() { m_determine_normal_latency = true; }
+  void SetTargetFrameTime(RefTime usec);
+  RefTime GetTargetFrameTime() const;
+  const Metrics& GetMetrics() const { return m_metrics; }
+  void ResetMetrics() { m_metrics.Reset(); }
 
   void SetOverlayLevel(int level);
   int GetOverlayLevel();
@@ -187,23 +208,85 @@ class HandVu {
 
   void SetDoTrack(bool do_track) { m_do_track = do_track; }
 
+  // events go to all servers added; they are not owned
+  void AddGestureServer(GestureServer* pServer);
+
   void SetLogfile(const string& filename);
   void GetVersion(string& version, int verbosity) const;
 
  protected:
-  void InitializeTracking();
-  bool VerifyColor();
-  bool DoDetection();
-  bool DoTracking();
-  bool DoRecognition();
+  // what the output stage of a frame needs from its analysis: the
+  // action, and a snapshot of the state that is drawn and sent, so
+  // that the next frame can be analyzed while this one is finished
+  class FrameResult {
+   public:
+    IplImage*             image;
+    int                   buffer_id;
+    HVAction              action;
+    bool                  undistort;
+    RefTime               t_start_processing;
+    RefTime               t_start_timing; // on m_pTimer
+    RefTime               last_latency; // -1 if not known
+    bool                  active;
+    bool                  zero_scan;
+    RefTime               overlay_time; // of the components' overlays
+    vector<HVState>       states;       // of object 0 and all started ones
+  };
+
+  // an object that is searched for and tracked, each with trackers
+  // of its own; all share the detection and the learned color
+  class TrackedObject {
+   public:
+    TrackedObject(int obj_id);
+    ~TrackedObject();
+
+    int                   id;
+    bool                  on;           // started
+    bool                  tracking;
+    bool                  recognized;
+    bool                  lost;         // tracking, by the last DoTracking
+    CuScanMatch           last_match;
+    CRect                 scan_area;    // for tracking and recognition
+    CvPoint2D32f          center_pos;
+    double                center_depth;
+    OpticalFlow*          pOpticalFlow;
+    CamShift*             pCamShift;
+  };
+
+  // the tracking of one frame: one cuRunTasks task per object
+  class TrackingTasks {
+   public:
+    HandVu*               pHandVu;
+    vector<TrackedObject*> objects;
+    vector<string>        errors;       // "" if the task succeeded
+  };
+
+ protected:
+  void InitializeTracking(TrackedObject& obj);
+  bool VerifyColor(const CuScanMatch& match);
+  bool DoDetection(TrackedObject& obj);
+  bool DoTracking(TrackedObject& obj);
+  bool DoRecognition(TrackedObject& obj);
+  void TrackObjects();
+  void SetDetectionScanners();
+  void RestartDetection();
+  void UpdateScanArea();
+  TrackedObject* GetSearchedObject() const;
+  int GetNumTracking() const;
+  CRect GetObjectArea(const TrackedObject& obj) const;
   HVAction CheckLatency();
-  void DrawOverlay();
+  HVAction AnalyzeFrame(GrabbedImage& inOutImage, const IplImage* rightImage,
+                        FrameResult& result);
+  void TakeSnapshot(HVAction action, bool undistort, FrameResult& result) const;
+  void FinishFrame(const FrameResult& result);
+  void DrawOverlay(const FrameResult& result);
   void CheckAndCorrectExposure();
-  void FindSecondHand();
-  void SetScanAreaVerified(const CRect& area);
-  void KeepStatistics(HVAction action);
-  void SendEvent() const;
-  void CalculateDepth(const IplImage* rightImage, const CvRect& area);
+  void SetScanAreaVerified(TrackedObject& obj, const CRect& area);
+  void SetScanAreaAround(TrackedObject& obj, const CuScanMatch& match);
+  void ApplyScanQuality();
+  void KeepStatistics(const FrameResult& result);
+  void SendEvent(const vector<HVState>& states) const;
+  double CalculateDepth(const IplImage* rightImage, const CvRect& area);
 
   string GetNextSnapshotFilename(const string& base, const string& extension);
   void WriteAreaAsBMP(IplImage* pImg, const CRect& area, const string& picfile);
@@ -212,21 +295,26 @@ class HandVu {
   void WriteAreaAsPGM_Gray(IplImage* pImg, const CRect& area, const string& picfile);
 
   void AsyncProcessor();
+  void AsyncOutput();
+  void AsyncRelease(int id);
   friend void* asyncProcessor(void* arg);
+  friend void* asyncOutput(void* arg);
+  friend void asyncRelease(void* arg, int id);
+  friend void trackObject(void* arg, int task);
   
   
  protected:
-  // processing state
+  // processing state: active if any object is started
   bool                    m_active;
-  bool                    m_tracking;
-  bool                    m_recognized;
+  TrackedObject*          m_objects[MAX_OBJECTS]; // NULL until started
 
   CubicleWrapper*         m_pCubicle;
   Skincolor*              m_pSkincolor;
   LearnedColor*           m_pLearnedColor;
-  OpticalFlow*            m_pOpticalFlow;
-  VisionConductor*        m_pConductor;
-  CamShift*               m_pCamShift;
+  VisionConductor*        m_pConductor;   // shared, NULL until loaded
+  CQuadrupleVector        m_orig_areas;   // of the cascades, relative;
+                                          // the conductor's until
+                                          // SetDetectionArea
 
   // general
   int                     m_video_width;
@@ -241,18 +329,25 @@ class HandVu {
   int                     m_img_width;
   int                     m_img_height;
   int                     m_overlay_level;
-  CRect                   m_scan_area;
-  CuScanMatch             m_last_match;
+  CRect                   m_scan_area;    // around all objects
   string                  m_logfile_name; // currently unused
   string                  m_img_fname_root; // for saving image areas
 
   // Async (internal buffering)
-  deque<GrabbedImage>     m_process_queue;
   vector<IplImage*>       m_ring_buffer;
-  vector<bool>            m_ring_buffer_occupied;
+  RefTimeVector           m_ring_buffer_times;
+  FrameQueue              m_frame_queue;
   bool                    m_quit_thread;
   DisplayCallback*        m_pDisplayCallback;
+  ReleaseCallback*        m_pReleaseCallback;
   Thread*                 m_pAsyncThread;
+
+  // pipelined async: the analysis runs in m_pAsyncThread, the output
+  // stage in m_pOutputThread; the queue between them holds at most
+  // one entry per ring buffer
+  bool                    m_pipelined;
+  deque<FrameResult>      m_output_queue;
+  Thread*                 m_pOutputThread;
   
   // undistortion
   bool                    m_undistort;
@@ -272,36 +367,53 @@ class HandVu {
   RefTime                 m_t_start_processing;
   bool                    m_determine_normal_latency;
   RefTimeVector           m_last_latencies;
-  RefTimeVector           m_frame_times;
-  RefTimeVector           m_processed_frame_times;
-  RefTimeVector           m_prcs_times;
   RefClock*               m_pClock;
+  RefClock*               m_pTimer;       // for the stage times
+  RefTime                 m_t_start_timing;
+
+  // stage times, frame counts and rates
+  Metrics                 m_metrics;
+
+  // adaptive quality: the scanner parameters of the conductor are
+  // those for full quality
+  QualityController       m_quality;
+  vector<CuScannerParameters> m_full_quality_params;
+  double                  m_applied_scan_quality;
+  RefTime                 m_finish_time;  // of the last FinishFrame
 
   // detection
   CuScanMatch             m_dt_first_match;
   RefTime                 m_dt_first_match_time;
+  int                     m_dt_frames_since_full_scan;
+  CRectVector             m_dt_blobs;
+  CRect                   m_dt_verified_area; // by color, for the overlay
 
   // tracking
   bool                    m_do_track;
   int                     m_buf_indx_cycler;
   int                     m_prev_buf_indx;
   int                     m_curr_buf_indx;
-  CvPoint2D32f            m_center_pos;
-  double                  m_center_depth;
   RefTime                 m_time_to_learn_color;
   RefTime                 m_min_time_between_learning_color;
 
-  // second object (left hand)
-  bool                    m_id1_on;
-  double                  m_id1_x, m_id1_y;
+  // events
+  vector<GestureServer*>  m_servers;
 };
 
 
 class DisplayCallback {
  public:
+  virtual ~DisplayCallback() {}
   virtual void Display(IplImage* img, HandVu::HVAction action) = 0;
 };
 
+// returns a registered buffer to the application
+class ReleaseCallback {
+ public:
+  virtual ~ReleaseCallback() {}
+  virtual void Release(int bufferID) = 0;
+};
+
 
 
 #endif // __HANDVU_HPP__INCLUDED_
@@ -30,42 +30,90 @@
 #include "GestureServer.h"
 
 
+/* HandVu.h repeats some constants of HandVu.hpp, so that the C
+* interface need not include the latter; these do not compile if
+* the two disagree
+*/
+typedef char hv_max_objects_check[
+  (int) HV_MAX_OBJECTS==(int) HandVu::MAX_OBJECTS ? 1 : -1];
+typedef char hv_num_stages_check[
+  (int) HV_NUM_STAGES==(int) Metrics::MS_NUM_STAGES ? 1 : -1];
+
+
 #if defined(WIN32)
 
 #if defined(GetMessage)
 #undef GetMessage
 #endif
 
-#include <time.h>
-#define CLOCKS_PER_USEC ((double)(CLOCKS_PER_SEC)/1000000.0)
+/* wall time since some fixed point, not affected by clock changes;
+* clock() would measure the CPU time of the process instead
+*/
 class RefClockWindows : public RefClock {
 public:
+  RefClockWindows();
   virtual RefTime GetCurrentTimeUsec() const;
+protected:
+  LARGE_INTEGER m_frequency;
 };
+RefClockWindows::RefClockWindows()
+{
+  if (!QueryPerformanceFrequency(&m_frequency)) {
+    throw HVException("no high-resolution performance counter");
+  }
+}
 RefTime RefClockWindows::GetCurrentTimeUsec() const
 {
-  clock_t ct = clock();
-  return (RefTime) (ct/CLOCKS_PER_USEC);
+  LARGE_INTEGER count;
+  QueryPerformanceCounter(&count);
+  // split to avoid an overflow of count*1000000
+  RefTime secs = count.QuadPart/m_frequency.QuadPart;
+  RefTime rest = count.QuadPart%m_frequency.QuadPart;
+  return secs*1000000 + rest*1000000/m_frequency.QuadPart;
 }
 #define RefClockArch RefClockWindows
 
 #else //WIN32
 
-#define CLOCKS_PER_USEC ((double)(CLOCKS_PER_SEC)/1000000.0)
+#include <time.h>
+#include <sys/time.h>
+
+/* monotonic wall time if available, otherwise the time of day;
+* clock() would measure the CPU time of the process instead
+*/
 class RefClockLinux : public RefClock {
 public:
   virtual RefTime GetCurrentTimeUsec() const;
 };
 RefTime RefClockLinux::GetCurrentTimeUsec() const
 {
-  clock_t ct = clock();
-  return (RefTime) (ct/CLOCKS_PER_USEC);
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)==0) {
+    return (RefTime) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+  }
+#endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (RefTime) tv.tv_sec*1000000 + tv.tv_usec;
 }
 #define RefClockArch RefClockLinux
 
 #endif //WIN32
 
 
+/* stands still at the time it was last set to
+*/
+class RefClockReplay : public RefClock {
+public:
+  RefClockReplay() : m_time(0) {}
+  virtual RefTime GetCurrentTimeUsec() const { return m_time; }
+  void SetTime(RefTime time) { m_time = time; }
+protected:
+  RefTime m_time;
+};
+
+
 class DisplayCallbackCintf : public DisplayCallback {
  public:
   DisplayCallbackCintf(void (*cb)(IplImage* img, hvAction action)) :
@@ -95,52 +143,117 @@ void DisplayCallbackCintf::Display(IplImage* img, HandVu::HVAction action)
   __END__;
 }
 
+class ReleaseCallbackCintf : public ReleaseCallback {
+ public:
+  ReleaseCallbackCintf(void (*cb)(int bufferID)) :
+    m_cb(cb) {}
+  virtual void Release(int bufferID) { m_cb(bufferID); }
+ protected:
+  void (*m_cb)(int);
+};
+
 
 typedef GestureServer* GestureServerPtr;
-vector<GestureServerPtr> g_pservers;
-HandVu* g_pHandVu = NULL;
-RefClockArch* g_pClock = NULL;
-DisplayCallbackCintf* g_displayCallback = NULL;
 
-void hvInitialize(int image_width, int image_height)
+/* one pipeline: the HandVu object with its clock, and the callbacks
+* and servers that it was given through the C interface
+*/
+struct _hvContext {
+  HandVu* pHandVu;
+  RefClockArch* pClock;
+  RefClockReplay* pReplayClock;   // NULL unless replaying
+  DisplayCallbackCintf* pDisplayCallback;
+  ReleaseCallbackCintf* pReleaseCallback;
+  vector<GestureServerPtr> servers;
+
+  RefTime GetCurrentTimeUsec() const;
+  void AddServer(GestureServer* pServer);
+};
+
+/* on the clock that HandVu goes by
+*/
+RefTime _hvContext::GetCurrentTimeUsec() const
 {
-  CV_FUNCNAME( "hvInitialize" ); // declare cvFuncName
+  if (pReplayClock) {
+    return pReplayClock->GetCurrentTimeUsec();
+  }
+  return pClock->GetCurrentTimeUsec();
+}
+
+/* the server is deleted if it can not be started
+*/
+void _hvContext::AddServer(GestureServer* pServer)
+{
+  try {
+    pServer->Start();
+  } catch (HVException&) {
+    delete pServer;
+    throw;
+  }
+  servers.push_back(pServer);
+  pHandVu->AddGestureServer(pServer);
+}
+
+#define CHECK_CONTEXT \
+  if (pContext==NULL || pContext->pHandVu==NULL) { \
+    CV_ERROR(CV_StsError, "HandVu not initialized"); \
+  }
+
+// the context of the functions without a context argument
+hvContext* g_pContext = NULL;
+
+hvContext* hvCreate(int image_width, int image_height)
+{
+  hvContext* pContext = NULL;
+
+  CV_FUNCNAME( "hvCreate" ); // declare cvFuncName
   __BEGIN__;
   if (image_width<0 || image_height<0) {
     CV_ERROR(CV_BadImageSize, "negative image width or height");
   }
-  if (g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu already initialized");
-  }
+  pContext = new hvContext;
+  pContext->pHandVu = NULL;
+  pContext->pClock = NULL;
+  pContext->pReplayClock = NULL;
+  pContext->pDisplayCallback = NULL;
+  pContext->pReleaseCallback = NULL;
   try {
-    g_pHandVu = new HandVu();
-    g_pClock = new RefClockArch();
-    g_pHandVu->Initialize(image_width, image_height, g_pClock, NULL);
+    pContext->pHandVu = new HandVu();
+    pContext->pClock = new RefClockArch();
+    pContext->pHandVu->Initialize(image_width, image_height,
+                                  pContext->pClock, NULL);
   } catch (HVException& hve) {
+    delete pContext->pHandVu;
+    delete pContext->pClock;
+    delete pContext;
+    pContext = NULL;
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
+  return pContext;
 }
 
-void hvUninitialize()
+/* the HandVu object first: its threads may still use the callbacks
+* and servers until it is gone
+*/
+void hvDestroy(hvContext* pContext)
 {
-  CV_FUNCNAME( "hvUninitialize" ); // declare cvFuncName
+  CV_FUNCNAME( "hvDestroy" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->~HandVu();
-    g_pHandVu = NULL;
-    delete g_pClock;
-    g_pClock = NULL;
-    if (g_displayCallback) {
-      delete g_displayCallback;
-    }
+    delete pContext->pHandVu;
+    pContext->pHandVu = NULL;
+    delete pContext->pClock;
+    delete pContext->pReplayClock;
+    delete pContext->pDisplayCallback;
+    delete pContext->pReleaseCallback;
 
     // gesture servers
-    for (int i=0; i<(int)g_pservers.size(); i++) delete g_pservers[i];
-    g_pservers.clear();
+    for (int i=0; i<(int)pContext->servers.size(); i++) {
+      delete pContext->servers[i];
+    }
+    delete pContext;
 
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
@@ -148,30 +261,49 @@ void hvUninitialize()
   __END__;
 }
 
-void hvLoadConductor(const string& filename)
+void hvInitialize(int image_width, int image_height)
 {
-  CV_FUNCNAME( "hvLoadConductor" ); // declare cvFuncName
+  CV_FUNCNAME( "hvInitialize" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
+  if (g_pContext) {
+    CV_ERROR(CV_StsError, "HandVu already initialized");
+  }
+  g_pContext = hvCreate(image_width, image_height);
+  __END__;
+}
+
+void hvUninitialize()
+{
+  CV_FUNCNAME( "hvUninitialize" ); // declare cvFuncName
+  __BEGIN__;
+  if (!g_pContext) {
     CV_ERROR(CV_StsError, "HandVu not initialized");
   }
+  hvDestroy(g_pContext);
+  g_pContext = NULL;
+  __END__;
+}
+
+void hvLoadConductor(hvContext* pContext, const string& filename)
+{
+  CV_FUNCNAME( "hvLoadConductor" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->LoadConductor(filename);
+    pContext->pHandVu->LoadConductor(filename);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-bool hvConductorLoaded()
+bool hvConductorLoaded(hvContext* pContext)
 {
   CV_FUNCNAME( "hvConductorLoaded" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    return g_pHandVu->ConductorLoaded();
+    return pContext->pHandVu->ConductorLoaded();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
@@ -179,47 +311,78 @@ bool hvConductorLoaded()
 }
 
 
-void hvStartRecognition(int obj_id)
+void hvStartRecognition(hvContext* pContext, int obj_id)
 {
   CV_FUNCNAME( "hvStartRecognition" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->StartRecognition(obj_id);
+    pContext->pHandVu->StartRecognition(obj_id);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvStopRecognition(int obj_id)
+void hvStopRecognition(hvContext* pContext, int obj_id)
 {
   CV_FUNCNAME( "hvStopRecognition" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->pHandVu->StopRecognition(obj_id);
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+RefTime hvGetCurrentTime(hvContext* pContext)
+{
+  CV_FUNCNAME( "hvGetCurrentTime" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
+  return pContext->GetCurrentTimeUsec();
+  __END__;
+}
+
+void hvSetReplayTime(hvContext* pContext, RefTime usec)
+{
+  CV_FUNCNAME( "hvSetReplayTime" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->StopRecognition(obj_id);
+    if (!pContext->pReplayClock) {
+      pContext->pReplayClock = new RefClockReplay();
+      pContext->pHandVu->SetReferenceClock(pContext->pReplayClock);
+    }
+    pContext->pReplayClock->SetTime(usec);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage)
+hvAction hvProcessFrame(hvContext* pContext, IplImage* inOutImage,
+                        IplImage* rightImage)
 {
   CV_FUNCNAME( "hvProcessFrame" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
+  return hvProcessFrame(pContext, inOutImage, rightImage,
+                        pContext->GetCurrentTimeUsec());
+  __END__;
+}
+
+hvAction hvProcessFrame(hvContext* pContext, IplImage* inOutImage,
+                        IplImage* rightImage, RefTime capture_time)
+{
+  CV_FUNCNAME( "hvProcessFrame" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    RefTime t = g_pClock->GetCurrentTimeUsec();
-    GrabbedImage gi(inOutImage, t, -1);
-    HandVu::HVAction action = g_pHandVu->ProcessFrame(gi, rightImage);
+    GrabbedImage gi(inOutImage, capture_time, -1);
+    HandVu::HVAction action = pContext->pHandVu->ProcessFrame(gi, rightImage);
     switch (action) {
       case HandVu::HV_INVALID_ACTION:
         return HV_INVALID_ACTION;
@@ -239,15 +402,13 @@ hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage)
   __END__;
 }
 
-bool hvIsActive()
+bool hvIsActive(hvContext* pContext)
 {
   CV_FUNCNAME( "hvIsActive" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    bool active = g_pHandVu->IsActive();
+    bool active = pContext->pHandVu->IsActive();
     return active;
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
@@ -255,19 +416,19 @@ bool hvIsActive()
   __END__;
 }
 
-void hvAsyncSetup(int num_buffers, void (*cb)(IplImage* img, hvAction action))
+void hvAsyncSetup(hvContext* pContext, int num_buffers,
+                  void (*cb)(IplImage* img, hvAction action), bool pipelined)
 {
   CV_FUNCNAME( "hvAsyncSetup" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    if (g_displayCallback) {
-      delete g_displayCallback;
+    if (pContext->pDisplayCallback) {
+      delete pContext->pDisplayCallback;
     }
-    g_displayCallback = new DisplayCallbackCintf(cb);
-    g_pHandVu->AsyncSetup(num_buffers, g_displayCallback);
+    pContext->pDisplayCallback = new DisplayCallbackCintf(cb);
+    pContext->pHandVu->AsyncSetup(num_buffers, pContext->pDisplayCallback,
+                                  pipelined);
     
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
@@ -275,48 +436,108 @@ void hvAsyncSetup(int num_buffers, void (*cb)(IplImage* img, hvAction action))
   __END__;
 }
 
-void hvAsyncGetImageBuffer(IplImage** pImage, int* pBufferID)
+void hvAsyncGetImageBuffer(hvContext* pContext, IplImage** pImage,
+                           int* pBufferID)
 {
   CV_FUNCNAME( "hvAsyncGetImageBuffer" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->pHandVu->AsyncGetImageBuffer(pImage, pBufferID);
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+void hvAsyncRegisterBuffer(hvContext* pContext, char* data, int widthStep,
+                           int origin, int* pBufferID)
+{
+  CV_FUNCNAME( "hvAsyncRegisterBuffer" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->AsyncGetImageBuffer(pImage, pBufferID);
+    pContext->pHandVu->AsyncRegisterBuffer(data, widthStep, origin, pBufferID);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvAsyncProcessFrame(int bufferID)
+void hvAsyncSetReleaseCallback(hvContext* pContext, void (*cb)(int bufferID))
 {
-  CV_FUNCNAME( "hvAsyncProcessFrame" ); // declare cvFuncName
+  CV_FUNCNAME( "hvAsyncSetReleaseCallback" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    ReleaseCallbackCintf* old = pContext->pReleaseCallback;
+    pContext->pReleaseCallback = cb ? new ReleaseCallbackCintf(cb) : NULL;
+    pContext->pHandVu->AsyncSetReleaseCallback(pContext->pReleaseCallback);
+    delete old;
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+void hvAsyncSetDropPolicy(hvContext* pContext, hvAsyncDropPolicy policy)
+{
+  CV_FUNCNAME( "hvAsyncSetDropPolicy" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    RefTime t = g_pClock->GetCurrentTimeUsec();
-    g_pHandVu->AsyncProcessFrame(bufferID, t);
+    switch (policy) {
+      case HV_ASYNC_BLOCK:
+        pContext->pHandVu->SetAsyncDropPolicy(FrameQueue::FQ_BLOCK);
+        break;
+      case HV_ASYNC_DROP_OLDEST:
+        pContext->pHandVu->SetAsyncDropPolicy(FrameQueue::FQ_DROP_OLDEST);
+        break;
+      case HV_ASYNC_LATEST_WINS:
+        pContext->pHandVu->SetAsyncDropPolicy(FrameQueue::FQ_LATEST_WINS);
+        break;
+      default:
+        CV_ERROR(CV_StsError, "unknown hvAsyncDropPolicy");
+    }
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
+void hvAsyncProcessFrame(hvContext* pContext, int bufferID)
+{
+  CV_FUNCNAME( "hvAsyncProcessFrame" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
+  hvAsyncProcessFrame(pContext, bufferID,
+                      pContext->GetCurrentTimeUsec());
+  __END__;
+}
 
-void hvGetState(int obj_id, hvState& state)
+void hvAsyncProcessFrame(hvContext* pContext, int bufferID,
+                         RefTime capture_time)
 {
-  CV_FUNCNAME( "hvGetState" ); // declare cvFuncName
+  CV_FUNCNAME( "hvAsyncProcessFrame" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->pHandVu->AsyncProcessFrame(bufferID, capture_time);
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+
+void hvGetState(hvContext* pContext, int obj_id, hvState& state)
+{
+  CV_FUNCNAME( "hvGetState" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
     HVState hsta;
-    g_pHandVu->GetState(obj_id, hsta);
+    pContext->pHandVu->GetState(obj_id, hsta);
     state.obj_id = hsta.m_obj_id;
     state.tracked = hsta.m_tracked;
     state.recognized = hsta.m_recognized;
@@ -325,6 +546,8 @@ void hvGetState(int obj_id, hvState& state)
     state.scale = hsta.m_scale;
     state.posture = hsta.m_posture;
     state.tstamp = hsta.m_tstamp;
+    state.tstamp_processing = hsta.m_tstamp_processing;
+    state.tstamp_event = hsta.m_tstamp_event;
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
@@ -332,31 +555,29 @@ void hvGetState(int obj_id, hvState& state)
 }
 
 
-void hvSetDetectionArea(int left, int top, int right, int bottom)
+void hvSetDetectionArea(hvContext* pContext,
+                        int left, int top, int right, int bottom)
 {
   CV_FUNCNAME( "hvSetDetectionArea" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetDetectionArea(left, top, right, bottom);
+    pContext->pHandVu->SetDetectionArea(left, top, right, bottom);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvGetDetectionArea(int* pLeft, int* pTop, int* pRight, int* pBottom)
+void hvGetDetectionArea(hvContext* pContext,
+                        int* pLeft, int* pTop, int* pRight, int* pBottom)
 {
   CV_FUNCNAME( "hvAsyncProcessFrame" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
     CQuadruple area;
-    g_pHandVu->GetDetectionArea(area);
+    pContext->pHandVu->GetDetectionArea(area);
     *pLeft = (int) area.left;
     *pTop = (int) area.top;
     *pRight = (int) area.right;
@@ -367,45 +588,98 @@ void hvGetDetectionArea(int* pLeft, int* pTop, int* pRight, int* pBottom)
   __END__;
 }
 
-void hvRecomputeNormalLatency()
+void hvRecomputeNormalLatency(hvContext* pContext)
 {
   CV_FUNCNAME( "hvRecomputeNormalLatency" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->pHandVu->RecomputeNormalLatency();
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+void hvSetTargetFrameTime(hvContext* pContext, RefTime usec)
+{
+  CV_FUNCNAME( "hvSetTargetFrameTime" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->RecomputeNormalLatency();
+    pContext->pHandVu->SetTargetFrameTime(usec);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvSetOverlayLevel(int level)
+void hvGetMetrics(hvContext* pContext, hvMetrics& metrics)
 {
-  CV_FUNCNAME( "hvSetOverlayLevel" ); // declare cvFuncName
+  CV_FUNCNAME( "hvGetMetrics" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    const Metrics& hmet = pContext->pHandVu->GetMetrics();
+    metrics.frames_processed = hmet.GetCount(Metrics::MS_PROCESSED);
+    metrics.frames_skipped = hmet.GetCount(Metrics::MS_SKIPPED);
+    metrics.frames_dropped = hmet.GetCount(Metrics::MS_DROPPED);
+    metrics.frames_queue_dropped = hmet.GetCount(Metrics::MS_QUEUE_DROPPED);
+    double min_prcs_time, max_prcs_time;
+    hmet.GetFrameRates((double) pContext->GetCurrentTimeUsec(),
+                       metrics.fps, metrics.processed_fps,
+                       min_prcs_time, max_prcs_time);
+    // hvStage has the order of Metrics::Stage
+    for (int s=0; s<HV_NUM_STAGES; s++) {
+      Metrics::StageSummary summary;
+      hmet.GetStage((Metrics::Stage) s, summary);
+      hvStageMetrics& stage = metrics.stages[s];
+      stage.count = summary.count;
+      stage.mean = summary.count ? summary.sum/summary.count : 0;
+      stage.max = summary.max;
+      stage.p50 = summary.p50;
+      stage.p95 = summary.p95;
+      stage.p99 = summary.p99;
+    }
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+void hvResetMetrics(hvContext* pContext)
+{
+  CV_FUNCNAME( "hvResetMetrics" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetOverlayLevel(level);
+    pContext->pHandVu->ResetMetrics();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-int hvGetOverlayLevel()
+void hvSetOverlayLevel(hvContext* pContext, int level)
 {
-  CV_FUNCNAME( "hvRecomputeNormalLatency" ); // declare cvFuncName
+  CV_FUNCNAME( "hvSetOverlayLevel" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->pHandVu->SetOverlayLevel(level);
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+int hvGetOverlayLevel(hvContext* pContext)
+{
+  CV_FUNCNAME( "hvRecomputeNormalLatency" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    int level = g_pHandVu->GetOverlayLevel();
+    int level = pContext->pHandVu->GetOverlayLevel();
     return level;
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
@@ -414,90 +688,78 @@ int hvGetOverlayLevel()
 }
 
 
-void hvCorrectDistortion(bool enable)
+void hvCorrectDistortion(hvContext* pContext, bool enable)
 {
   CV_FUNCNAME( "hvCorrectDistortion" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->CorrectDistortion(enable);
+    pContext->pHandVu->CorrectDistortion(enable);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-bool hvIsCorrectingDistortion()
+bool hvIsCorrectingDistortion(hvContext* pContext)
 {
   CV_FUNCNAME( "hvIsCorrectingDistortion" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    return g_pHandVu->IsCorrectingDistortion();
+    return pContext->pHandVu->IsCorrectingDistortion();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-bool hvCanCorrectDistortion()
+bool hvCanCorrectDistortion(hvContext* pContext)
 {
   CV_FUNCNAME( "hvCanCorrectDistortion" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    return g_pHandVu->CanCorrectDistortion();
+    return pContext->pHandVu->CanCorrectDistortion();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvSetAdjustExposure(bool enable)
+void hvSetAdjustExposure(hvContext* pContext, bool enable)
 {
   CV_FUNCNAME( "hvSetAdjustExposure" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetAdjustExposure(enable);
+    pContext->pHandVu->SetAdjustExposure(enable);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-bool hvCanAdjustExposure()
+bool hvCanAdjustExposure(hvContext* pContext)
 {
   CV_FUNCNAME( "hvCanAdjustExposure" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    return g_pHandVu->CanAdjustExposure();
+    return pContext->pHandVu->CanAdjustExposure();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-bool hvIsAdjustingExposure()
+bool hvIsAdjustingExposure(hvContext* pContext)
 {
   CV_FUNCNAME( "hvIsAdjustingExposure" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    return g_pHandVu->IsAdjustingExposure();
+    return pContext->pHandVu->IsAdjustingExposure();
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
@@ -505,60 +767,54 @@ bool hvIsAdjustingExposure()
 }
 
 
-void hvSetLogfile(const string& filename)
+void hvSetLogfile(hvContext* pContext, const string& filename)
 {
   CV_FUNCNAME( "hvSetLogfile" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetLogfile(filename);
+    pContext->pHandVu->SetLogfile(filename);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvSaveScannedArea(IplImage* pImg, string& picfile)
+void hvSaveScannedArea(hvContext* pContext, IplImage* pImg, string& picfile)
 {
   CV_FUNCNAME( "hvSaveScannedArea" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SaveScannedArea(pImg, picfile);
+    pContext->pHandVu->SaveScannedArea(pImg, picfile);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvSaveImageArea(IplImage* pImg, int left, int top, int right, int bottom, string& picfile)
+void hvSaveImageArea(hvContext* pContext, IplImage* pImg,
+                     int left, int top, int right, int bottom, string& picfile)
 {
   CV_FUNCNAME( "hvSaveImageArea" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SaveImageArea(pImg, CRect(left, top, right, bottom), picfile);
+    pContext->pHandVu->SaveImageArea(pImg, CRect(left, top, right, bottom),
+                                     picfile);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvSetSaveFilenameRoot(const string& fname_root)
+void hvSetSaveFilenameRoot(hvContext* pContext, const string& fname_root)
 {
   CV_FUNCNAME( "hvSetSaveFilenameRoot" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetSaveFilenameRoot(fname_root);
+    pContext->pHandVu->SetSaveFilenameRoot(fname_root);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
@@ -566,15 +822,13 @@ void hvSetSaveFilenameRoot(const string& fname_root)
 }
 
 
-void hvSetDoTrack(bool do_track)
+void hvSetDoTrack(hvContext* pContext, bool do_track)
 {
   CV_FUNCNAME( "hvSetDoTrack" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pHandVu->SetDoTrack(do_track);
+    pContext->pHandVu->SetDoTrack(do_track);
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
@@ -582,45 +836,61 @@ void hvSetDoTrack(bool do_track)
 }
 
 
-void hvStartGestureServer(int port, int max_num_clients)
+void hvStartGestureServer(hvContext* pContext, int port, int max_num_clients)
 {
   CV_FUNCNAME( "hvStartGestureServer" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
-    g_pservers.push_back(new GestureServerStream(port, max_num_clients));
-    g_pservers.back()->Start();
+    pContext->AddServer(new GestureServerStream(port, max_num_clients));
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvStartOSCServer(const string& desthost, int destport)
+void hvStartOSCServer(hvContext* pContext, const string& desthost, int destport)
 {
   CV_FUNCNAME( "hvStartOSCServer" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
+  CHECK_CONTEXT;
+  try {
+    pContext->AddServer(new GestureServerOSC(desthost, destport));
+  } catch (HVException& hve) {
+    CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
+  __END__;
+}
+
+void hvStartMetricsServer(hvContext* pContext, int port)
+{
+  CV_FUNCNAME( "hvStartMetricsServer" ); // declare cvFuncName
+  __BEGIN__;
+  CHECK_CONTEXT;
   try {
-    g_pservers.push_back(new GestureServerOSC(desthost, destport));
-    g_pservers.back()->Start();
+    pContext->AddServer(
+      new MetricsServer(port, &pContext->pHandVu->GetMetrics()));
   } catch (HVException& hve) {
     CV_ERROR(CV_StsError, hve.GetMessage().c_str());
   }
   __END__;
 }
 
-void hvStopGestureServer(int /*port*/)
+void hvSetTracing(bool on)
+{
+  cuSetTracing(on);
+}
+
+void hvWriteTrace(const string& filename)
+{
+  cuWriteTrace(filename);
+}
+
+void hvStopGestureServer(hvContext* pContext, int /*port*/)
 {
   CV_FUNCNAME( "hvStopGestureServer" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
     throw HVException("sorry, stop server not implemented");
   } catch (HVException& hve) {
@@ -629,13 +899,12 @@ void hvStopGestureServer(int /*port*/)
   __END__;
 }
 
-void hvStopOSCServer(const string& /*desthost*/, int /*destport*/)
+void hvStopOSCServer(hvContext* pContext, const string& /*desthost*/,
+                     int /*destport*/)
 {
   CV_FUNCNAME( "hvStopOSCServer" ); // declare cvFuncName
   __BEGIN__;
-  if (!g_pHandVu) {
-    CV_ERROR(CV_StsError, "HandVu not initialized");
-  }
+  CHECK_CONTEXT;
   try {
     throw HVException("sorry, stop server not implemented");
   } catch (HVException& hve) {
@@ -644,13 +913,217 @@ void hvStopOSCServer(const string& /*desthost*/, int /*destport*/)
   __END__;
 }
 
-void HandVu::SendEvent() const
+
+/////////////////////////////////////////////////////////////////////////////
+// the same on the context of hvInitialize
+
+void hvLoadConductor(const string& filename)
 {
-  HVState state;
-  GetState(0, state);
-  for (int s=0; s<(int)g_pservers.size(); s++) {
-    g_pservers[s]->Send(state);
-  }
+  hvLoadConductor(g_pContext, filename);
+}
+
+bool hvConductorLoaded()
+{
+  return hvConductorLoaded(g_pContext);
+}
+
+void hvStartRecognition(int obj_id)
+{
+  hvStartRecognition(g_pContext, obj_id);
+}
+
+void hvStopRecognition(int obj_id)
+{
+  hvStopRecognition(g_pContext, obj_id);
+}
+
+RefTime hvGetCurrentTime()
+{
+  return hvGetCurrentTime(g_pContext);
+}
+
+void hvSetReplayTime(RefTime usec)
+{
+  hvSetReplayTime(g_pContext, usec);
+}
+
+hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage)
+{
+  return hvProcessFrame(g_pContext, inOutImage, rightImage);
+}
+
+hvAction hvProcessFrame(IplImage* inOutImage, IplImage* rightImage,
+                        RefTime capture_time)
+{
+  return hvProcessFrame(g_pContext, inOutImage, rightImage, capture_time);
+}
+
+bool hvIsActive()
+{
+  return hvIsActive(g_pContext);
+}
+
+void hvAsyncSetup(int num_buffers, void (*cb)(IplImage* img, hvAction action),
+                  bool pipelined)
+{
+  hvAsyncSetup(g_pContext, num_buffers, cb, pipelined);
+}
+
+void hvAsyncGetImageBuffer(IplImage** pImage, int* pBufferID)
+{
+  hvAsyncGetImageBuffer(g_pContext, pImage, pBufferID);
+}
+
+void hvAsyncRegisterBuffer(char* data, int widthStep, int origin,
+                           int* pBufferID)
+{
+  hvAsyncRegisterBuffer(g_pContext, data, widthStep, origin, pBufferID);
+}
+
+void hvAsyncSetReleaseCallback(void (*cb)(int bufferID))
+{
+  hvAsyncSetReleaseCallback(g_pContext, cb);
+}
+
+void hvAsyncSetDropPolicy(hvAsyncDropPolicy policy)
+{
+  hvAsyncSetDropPolicy(g_pContext, policy);
+}
+
+void hvAsyncProcessFrame(int bufferID)
+{
+  hvAsyncProcessFrame(g_pContext, bufferID);
+}
+
+void hvAsyncProcessFrame(int bufferID, RefTime capture_time)
+{
+  hvAsyncProcessFrame(g_pContext, bufferID, capture_time);
+}
+
+void hvGetState(int obj_id, hvState& state)
+{
+  hvGetState(g_pContext, obj_id, state);
+}
+
+void hvSetDetectionArea(int left, int top, int right, int bottom)
+{
+  hvSetDetectionArea(g_pContext, left, top, right, bottom);
+}
+
+void hvGetDetectionArea(int* pLeft, int* pTop, int* pRight, int* pBottom)
+{
+  hvGetDetectionArea(g_pContext, pLeft, pTop, pRight, pBottom);
+}
+
+void hvRecomputeNormalLatency()
+{
+  hvRecomputeNormalLatency(g_pContext);
+}
+
+void hvSetTargetFrameTime(RefTime usec)
+{
+  hvSetTargetFrameTime(g_pContext, usec);
+}
+
+void hvGetMetrics(hvMetrics& metrics)
+{
+  hvGetMetrics(g_pContext, metrics);
+}
+
+void hvResetMetrics()
+{
+  hvResetMetrics(g_pContext);
+}
+
+void hvSetOverlayLevel(int level)
+{
+  hvSetOverlayLevel(g_pContext, level);
+}
+
+int hvGetOverlayLevel()
+{
+  return hvGetOverlayLevel(g_pContext);
+}
+
+void hvCorrectDistortion(bool enable)
+{
+  hvCorrectDistortion(g_pContext, enable);
+}
+
+bool hvIsCorrectingDistortion()
+{
+  return hvIsCorrectingDistortion(g_pContext);
+}
+
+bool hvCanCorrectDistortion()
+{
+  return hvCanCorrectDistortion(g_pContext);
+}
+
+void hvSetAdjustExposure(bool enable)
+{
+  hvSetAdjustExposure(g_pContext, enable);
+}
+
+bool hvCanAdjustExposure()
+{
+  return hvCanAdjustExposure(g_pContext);
+}
+
+bool hvIsAdjustingExposure()
+{
+  return hvIsAdjustingExposure(g_pContext);
+}
+
+void hvSetLogfile(const string& filename)
+{
+  hvSetLogfile(g_pContext, filename);
+}
+
+void hvSaveScannedArea(IplImage* pImg, string& picfile)
+{
+  hvSaveScannedArea(g_pContext, pImg, picfile);
+}
+
+void hvSaveImageArea(IplImage* pImg, int left, int top, int right, int bottom,
+                     string& picfile)
+{
+  hvSaveImageArea(g_pContext, pImg, left, top, right, bottom, picfile);
+}
+
+void hvSetSaveFilenameRoot(const string& fname_root)
+{
+  hvSetSaveFilenameRoot(g_pContext, fname_root);
+}
+
+void hvSetDoTrack(bool do_track)
+{
+  hvSetDoTrack(g_pContext, do_track);
+}
+
+void hvStartGestureServer(int port, int max_num_clients)
+{
+  hvStartGestureServer(g_pContext, port, max_num_clients);
+}
+
+void hvStartOSCServer(const string& desthost, int destport)
+{
+  hvStartOSCServer(g_pContext, desthost, destport);
+}
+
+void hvStartMetricsServer(int port)
+{
+  hvStartMetricsServer(g_pContext, port);
+}
+
+void hvStopGestureServer(int port)
+{
+  hvStopGestureServer(g_pContext, port);
+}
+
+void hvStopOSCServer(const string& desthost, int destport)
+{
+  hvStopOSCServer(g_pContext, desthost, destport);
 }
 
 
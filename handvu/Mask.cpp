@@ -25,6 +25,7 @@
 #include "Mask.h"
 #include "Exceptions.h"
 #include <fstream>
+#include <algorithm>
 
 Mask::Mask()
 : m_width(-1),
@@ -103,3 +104,15 @@ double Mask::GetProb(int x, int y) const
   ASSERT(0<=y && y<m_height);
   return m_probs[y*m_width+x];
 }
+
+/** flips the mask horizontally, for the mirror images of the
+* objects that it was made for
+*/
+void Mask::Mirror()
+{
+  for (int row=0; row<m_height; row++) {
+    for (int col=0; col<m_width/2; col++) {
+      swap(m_probs[row*m_width+col], m_probs[row*m_width+m_width-1-col]);
+    }
+  }
+}
@@ -44,6 +44,7 @@ public:
   int GetHeight() const {return m_height;}
   double GetImageAreaRatio() const { return m_image_area_ratio; }
   void SetImageAreaRatio(double r) { m_image_area_ratio = r; }
+  void Mirror();
 
 protected:
   int               m_width, m_height;
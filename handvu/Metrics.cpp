@@ -0,0 +1,340 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+// Metrics.cpp: stage times, frame counts and frame rates
+//
+
+#include "Common.h"
+#include "Metrics.h"
+#include "Exceptions.h"
+#include <math.h>
+#include <algorithm>
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram()
+{
+  Clear();
+}
+
+void LatencyHistogram::Clear()
+{
+  for (int b=0; b<MS_NUM_BUCKETS; b++) {
+    m_buckets[b] = 0;
+  }
+  m_count = 0;
+  m_sum = 0;
+  m_max = 0;
+}
+
+void LatencyHistogram::Add(double usec)
+{
+  usec = max(0.0, usec);
+  m_buckets[BucketOf(usec)]++;
+  m_count++;
+  m_sum += usec;
+  m_max = max(m_max, usec);
+}
+
+/* the time that the given fraction of all times is at most, rounded
+* up to the end of its bucket; 0 if there are none
+*/
+double LatencyHistogram::GetPercentile(double fraction) const
+{
+  if (m_count==0) {
+    return 0;
+  }
+  double target = max(1.0, ceil(fraction*m_count));
+  double seen = 0;
+  for (int b=0; b<MS_NUM_BUCKETS; b++) {
+    seen += m_buckets[b];
+    if (seen>=target) {
+      if (b==MS_NUM_BUCKETS-1) {
+        // no upper bound
+        return m_max;
+      }
+      return min(UpperBoundOf(b), m_max);
+    }
+  }
+  return m_max;
+}
+
+int LatencyHistogram::BucketOf(double usec)
+{
+  if (usec<MS_SUB_BUCKETS) {
+    return (int) usec;
+  }
+  // usec = mantissa*2^exp with 0.5<=mantissa<1
+  int exp;
+  double mantissa = frexp(usec, &exp);
+  int e = exp-1;
+  if (e>MS_MAX_EXPONENT) {
+    return MS_NUM_BUCKETS-1;
+  }
+  int sub = (int) (mantissa*2*MS_SUB_BUCKETS) - MS_SUB_BUCKETS;
+  return (e-MS_SUB_BITS+1)*MS_SUB_BUCKETS + sub;
+}
+
+double LatencyHistogram::UpperBoundOf(int bucket)
+{
+  if (bucket<MS_SUB_BUCKETS) {
+    return bucket+1;
+  }
+  int e = bucket/MS_SUB_BUCKETS + MS_SUB_BITS-1;
+  int sub = bucket%MS_SUB_BUCKETS;
+  return ldexp((double) (MS_SUB_BUCKETS+sub+1), e-MS_SUB_BITS);
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Metrics
+
+Metrics::Metrics()
+{
+#if defined(WIN32)
+  m_mutex = CreateMutex(NULL, FALSE, NULL);
+  if (m_mutex==NULL) {
+    throw HVException("can not initialize WIN32 mutex");
+  }
+#else //WIN32
+  int err = pthread_mutex_init(&m_mutex, NULL);
+  if (err) throw HVException("can not initialize pthread mutex");
+#endif //WIN32
+  Reset();
+}
+
+Metrics::~Metrics()
+{
+#if defined(WIN32)
+  CloseHandle(m_mutex);
+#else //WIN32
+  pthread_mutex_destroy(&m_mutex);
+#endif //WIN32
+}
+
+void Metrics::Reset()
+{
+  Lock();
+  for (int s=0; s<MS_NUM_STAGES; s++) {
+    m_stages[s].Clear();
+  }
+  for (int c=0; c<MS_NUM_COUNTERS; c++) {
+    m_counts[c] = 0;
+  }
+  m_ring_next = 0;
+  m_ring_size = 0;
+  Unlock();
+}
+
+void Metrics::AddTime(Stage stage, double usec)
+{
+  ASSERT(0<=stage && stage<MS_NUM_STAGES);
+  Lock();
+  m_stages[stage].Add(usec);
+  Unlock();
+}
+
+/* a frame is done at time; prcs_time is -1 for dropped frames, the
+* MS_FRAME time of fully processed ones
+*/
+void Metrics::AddFrame(double time, double prcs_time, Counter counter)
+{
+  ASSERT(0<=counter && counter<MS_NUM_COUNTERS);
+  Lock();
+  m_counts[counter]++;
+  if (counter==MS_PROCESSED) {
+    m_stages[MS_FRAME].Add(prcs_time);
+  }
+  m_frame_times[m_ring_next] = time;
+  m_prcs_times[m_ring_next] = prcs_time;
+  m_processed[m_ring_next] = (counter==MS_PROCESSED);
+  m_ring_next = (m_ring_next+1) % MS_RING_SIZE;
+  m_ring_size = min(m_ring_size+1, MS_RING_SIZE);
+  Unlock();
+}
+
+/* for counts that are kept elsewhere
+*/
+void Metrics::SetCount(Counter counter, unsigned int count)
+{
+  ASSERT(0<=counter && counter<MS_NUM_COUNTERS);
+  Lock();
+  m_counts[counter] = count;
+  Unlock();
+}
+
+/* the frame rates start over, the totals do not
+*/
+void Metrics::ClearFrames()
+{
+  Lock();
+  m_ring_next = 0;
+  m_ring_size = 0;
+  Unlock();
+}
+
+void Metrics::GetStage(Stage stage, StageSummary& summary) const
+{
+  ASSERT(0<=stage && stage<MS_NUM_STAGES);
+  Lock();
+  const LatencyHistogram& hist = m_stages[stage];
+  summary.count = hist.GetCount();
+  summary.sum = hist.GetSum();
+  summary.max = hist.GetMax();
+  summary.p50 = hist.GetPercentile(0.5);
+  summary.p95 = hist.GetPercentile(0.95);
+  summary.p99 = hist.GetPercentile(0.99);
+  Unlock();
+}
+
+unsigned int Metrics::GetCount(Counter counter) const
+{
+  ASSERT(0<=counter && counter<MS_NUM_COUNTERS);
+  Lock();
+  unsigned int count = m_counts[counter];
+  Unlock();
+  return count;
+}
+
+/* frames and fully processed frames in the second before now, and
+* the range of processing times of those that were not dropped
+*/
+void Metrics::GetFrameRates(double now, int& fps, int& processed_fps,
+                            double& min_prcs_time,
+                            double& max_prcs_time) const
+{
+  fps = 0;
+  processed_fps = 0;
+  min_prcs_time = -1;
+  max_prcs_time = -1;
+  Lock();
+  for (int f=0; f<m_ring_size; f++) {
+    if (now-m_frame_times[f]>1000000) { // 1 second
+      continue;
+    }
+    fps++;
+    if (m_processed[f]) {
+      processed_fps++;
+    }
+    if (m_prcs_times[f]==-1) {
+      continue;
+    }
+    if (m_prcs_times[f]<min_prcs_time || min_prcs_time==-1) {
+      min_prcs_time = m_prcs_times[f];
+    }
+    if (m_prcs_times[f]>max_prcs_time || max_prcs_time==-1) {
+      max_prcs_time = m_prcs_times[f];
+    }
+  }
+  Unlock();
+  if (min_prcs_time==-1) {
+    ASSERT(max_prcs_time==-1);
+    min_prcs_time = 0;
+    max_prcs_time = 0;
+  }
+}
+
+/* Prometheus text format, times in seconds
+*/
+void Metrics::WriteText(string& text) const
+{
+  char buf[256];
+  text = "# HELP handvu_frames_total Frames by what HandVu did with them.\n"
+    "# TYPE handvu_frames_total counter\n";
+  for (int c=0; c<MS_NUM_COUNTERS; c++) {
+    sprintf(buf, "handvu_frames_total{action=\"%s\"} %u\n",
+            GetCounterName((Counter) c), GetCount((Counter) c));
+    text += buf;
+  }
+
+  text += "# HELP handvu_stage_seconds Time per frame of each stage.\n"
+    "# TYPE handvu_stage_seconds summary\n";
+  for (int s=0; s<MS_NUM_STAGES; s++) {
+    StageSummary summary;
+    GetStage((Stage) s, summary);
+    const char* name = GetStageName((Stage) s);
+    sprintf(buf, "handvu_stage_seconds{stage=\"%s\",quantile=\"0.5\"} %g\n"
+            "handvu_stage_seconds{stage=\"%s\",quantile=\"0.95\"} %g\n"
+            "handvu_stage_seconds{stage=\"%s\",quantile=\"0.99\"} %g\n",
+            name, summary.p50/1000000.0, name, summary.p95/1000000.0,
+            name, summary.p99/1000000.0);
+    text += buf;
+    sprintf(buf, "handvu_stage_seconds_sum{stage=\"%s\"} %g\n"
+            "handvu_stage_seconds_count{stage=\"%s\"} %u\n",
+            name, summary.sum/1000000.0, name, summary.count);
+    text += buf;
+  }
+}
+
+const char* Metrics::GetStageName(Stage stage)
+{
+  switch (stage) {
+    case MS_CONVERT:        return "convert";
+    case MS_TRACK:          return "track";
+    case MS_DETECT:         return "detect";
+    case MS_RECOGNIZE:      return "recognize";
+    case MS_COLOR_LEARNING: return "color_learning";
+    case MS_OVERLAY:        return "overlay";
+    case MS_SEND:           return "send";
+    case MS_FRAME:          return "frame";
+    case MS_LATENCY:        return "latency";
+    default:                return "unknown";
+  }
+}
+
+const char* Metrics::GetCounterName(Counter counter)
+{
+  switch (counter) {
+    case MS_PROCESSED:      return "processed";
+    case MS_SKIPPED:        return "skipped";
+    case MS_DROPPED:        return "dropped";
+    case MS_QUEUE_DROPPED:  return "queue_dropped";
+    default:                return "unknown";
+  }
+}
+
+void Metrics::Lock() const
+{
+#if defined(WIN32)
+  DWORD result = WaitForSingleObject(m_mutex, INFINITE);
+  if (result!=WAIT_OBJECT_0) {
+    throw HVException("error locking mutex");
+  }
+#else //WIN32
+  int err = pthread_mutex_lock(&m_mutex);
+  if (err) throw HVException("error locking mutex");
+#endif //WIN32
+}
+
+void Metrics::Unlock() const
+{
+#if defined(WIN32)
+  ReleaseMutex(m_mutex);
+#else //WIN32
+  pthread_mutex_unlock(&m_mutex);
+#endif //WIN32
+}
@@ -0,0 +1,157 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+#ifndef __METRICS__INCLUDED_H_
+#define __METRICS__INCLUDED_H_
+
+#if defined(WIN32)
+#include <windows.h>
+#else //WIN32
+#include <pthread.h>
+#endif //WIN32
+
+#include <string>
+using namespace std;
+
+// histogram buckets: one per micro-second below 2^MS_SUB_BITS, above
+// that 2^MS_SUB_BITS per power of two, so that a bucket is at most
+// 1/16th wider than its values; the last bucket takes everything
+// from 2^MS_MAX_EXPONENT micro-seconds (19 hours) up
+#define MS_SUB_BITS 4
+#define MS_SUB_BUCKETS (1<<MS_SUB_BITS)
+#define MS_MAX_EXPONENT 36
+#define MS_NUM_BUCKETS ((MS_MAX_EXPONENT-MS_SUB_BITS+2)*MS_SUB_BUCKETS)
+
+// frames kept for the frame rates of the last second; more frames
+// per second than this are not counted
+#define MS_RING_SIZE 512
+
+// ----------------------------------------------------------------------
+// class LatencyHistogram
+// ----------------------------------------------------------------------
+
+/* counts times in log-linear buckets: fixed memory, and percentiles
+ * within the bucket width of the true ones
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Clear();
+  void Add(double usec);
+
+  unsigned int GetCount() const { return m_count; }
+  double GetSum() const { return m_sum; }
+  double GetMax() const { return m_max; }
+  double GetPercentile(double fraction) const;
+
+ protected:
+  static int BucketOf(double usec);
+  static double UpperBoundOf(int bucket);
+
+ protected:
+  unsigned int            m_buckets[MS_NUM_BUCKETS];
+  unsigned int            m_count;
+  double                  m_sum;
+  double                  m_max;
+};
+
+// ----------------------------------------------------------------------
+// class Metrics
+// ----------------------------------------------------------------------
+
+/* times of the processing stages and counts of what happened to the
+ * frames, since the start or the last Reset; all methods may be
+ * called from any thread.  Times are in micro-seconds.
+ */
+class Metrics {
+ public:
+  enum Stage {
+    MS_CONVERT = 0,         // gray scale conversion
+    MS_TRACK = 1,
+    MS_DETECT = 2,
+    MS_RECOGNIZE = 3,
+    MS_COLOR_LEARNING = 4,
+    MS_OVERLAY = 5,
+    MS_SEND = 6,
+    MS_FRAME = 7,           // all of a fully processed frame
+    MS_LATENCY = 8,         // capture to event
+    MS_NUM_STAGES = 9
+  };
+  enum Counter {
+    MS_PROCESSED = 0,
+    MS_SKIPPED = 1,
+    MS_DROPPED = 2,         // too late to process or display
+    MS_QUEUE_DROPPED = 3,   // async frames replaced before processing
+    MS_NUM_COUNTERS = 4
+  };
+  class StageSummary {
+   public:
+    unsigned int count;
+    double sum, max;
+    double p50, p95, p99;
+  };
+
+ public:
+  Metrics();
+  ~Metrics();
+
+  void Reset();
+  void AddTime(Stage stage, double usec);
+  void AddFrame(double time, double prcs_time, Counter counter);
+  void SetCount(Counter counter, unsigned int count);
+  void ClearFrames();
+
+  void GetStage(Stage stage, StageSummary& summary) const;
+  unsigned int GetCount(Counter counter) const;
+  void GetFrameRates(double now, int& fps, int& processed_fps,
+                     double& min_prcs_time, double& max_prcs_time) const;
+  void WriteText(string& text) const;
+
+  static const char* GetStageName(Stage stage);
+  static const char* GetCounterName(Counter counter);
+
+ protected:
+  void Lock() const;
+  void Unlock() const;
+
+ protected:
+  LatencyHistogram        m_stages[MS_NUM_STAGES];
+  unsigned int            m_counts[MS_NUM_COUNTERS];
+
+  // the last frames: when they were done, how long their processing
+  // took (-1 if dropped), and whether they were fully processed
+  double                  m_frame_times[MS_RING_SIZE];
+  double                  m_prcs_times[MS_RING_SIZE];
+  bool                    m_processed[MS_RING_SIZE];
+  int                     m_ring_next;
+  int                     m_ring_size;
+
+#if defined(WIN32)
+  HANDLE                  m_mutex;
+#else //WIN32
+  mutable pthread_mutex_t m_mutex;
+#endif //WIN32
+};
+
+#endif // __METRICS__INCLUDED_H_
@@ -229,6 +229,7 @@ void OpticalFlow::LKPyramids(IplImage* prevImage, IplImage* currImage,
   // them were lost?
   ASSERT((int)m_feature_status.size()>=m_target_num_features);
   if (m_target_num_features>0) {
+    CuTraceSpan span("lk_flow", "features", m_target_num_features);
     cvCalcOpticalFlowPyrLK(prevImage, // frame A
                            currImage,   // frame B
                            m_pyramids[prev_indx], // buffer for pyramid for A
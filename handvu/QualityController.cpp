@@ -0,0 +1,109 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+// QualityController.cpp: trades scan and tracking quality for
+// processing time
+//
+
+#include "Common.h"
+#include "QualityController.h"
+#include <math.h>
+#include <algorithm>
+using namespace std;
+
+
+QualityController::QualityController()
+  : m_target(0)
+{
+  Reset();
+}
+
+void QualityController::SetTargetFrameTime(double target)
+{
+  m_target = max(0.0, target);
+  Reset();
+}
+
+/* full quality, no measurements
+*/
+void QualityController::Reset()
+{
+  m_frame_time = -1;
+  m_scan_quality = 1.0;
+  m_track_quality = 1.0;
+  m_frames_to_skip = 0;
+}
+
+/* the times that the stages of a fully processed frame took
+*/
+void QualityController::Update(double scan_time, double track_time,
+                               double other_time)
+{
+  if (!IsOn()) {
+    return;
+  }
+  double frame_time = scan_time+track_time+other_time;
+  if (m_frame_time<0) {
+    m_frame_time = frame_time;
+  } else {
+    m_frame_time = QC_SMOOTHING*m_frame_time + (1.0-QC_SMOOTHING)*frame_time;
+  }
+
+  if (m_frame_time>m_target) {
+    // the quality of a stage is about proportional to its time, so
+    // scale the one that took longer by the missing fraction, or the
+    // other one if that one is at its minimum already
+    double factor = max(0.5, m_target/m_frame_time);
+    double* first = &m_scan_quality;
+    double* second = &m_track_quality;
+    if (track_time>scan_time) {
+      first = &m_track_quality;
+      second = &m_scan_quality;
+    }
+    if (*first>QC_MIN_QUALITY) {
+      *first = max(QC_MIN_QUALITY, *first*factor);
+    } else if (*second>QC_MIN_QUALITY) {
+      *second = max(QC_MIN_QUALITY, *second*factor);
+    } else {
+      // skip enough frames to get the average down to the target
+      m_frames_to_skip = (int) ceil(m_frame_time/m_target)-1;
+      VERBOSE2(3, "HandVu: at minimum quality, %dus for %dus target",
+               (int) m_frame_time, (int) m_target);
+    }
+
+  } else if (m_frame_time<QC_HEADROOM*m_target) {
+    m_scan_quality = min(1.0, m_scan_quality*QC_STEP_UP);
+    m_track_quality = min(1.0, m_track_quality*QC_STEP_UP);
+  }
+}
+
+/* true if a frame should be skipped rather than processed
+*/
+bool QualityController::SkipFrame()
+{
+  if (m_frames_to_skip>0) {
+    m_frames_to_skip--;
+    return true;
+  }
+  return false;
+}
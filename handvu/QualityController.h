@@ -0,0 +1,73 @@
+/**
+  * HandVu - a library for computer vision-based hand gesture
+  * recognition.
+  * Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+  *
+  * This program is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU General Public License
+  * as published by the Free Software Foundation; either version 2
+  * of the License, or (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program; if not, write to the Free Software
+  * Foundation, Inc., 59 Temple Place - Suite 330,
+  * Boston, MA  02111-1307, USA.
+  *
+  * $Id$
+**/
+
+#ifndef __QUALITYCONTROLLER__INCLUDED_H_
+#define __QUALITYCONTROLLER__INCLUDED_H_
+
+// the quality levels are fractions of the full-quality cost of a
+// stage, no lower than QC_MIN_QUALITY
+#define QC_MIN_QUALITY 0.125
+// weight of the previous frames in the smoothed frame time
+#define QC_SMOOTHING 0.7
+// raise the quality only if frames take less than this fraction of
+// the target time, so that it does not oscillate around the target
+#define QC_HEADROOM 0.8
+#define QC_STEP_UP 1.05
+
+// ----------------------------------------------------------------------
+// class QualityController
+// ----------------------------------------------------------------------
+
+/* keeps the processing time of a frame close to a target time by
+ * lowering the quality of scanning (detection and recognition) and
+ * of tracking, whichever took longer, and raising both again when
+ * there is time left.  Only if both are at their minimum and frames
+ * still take too long does it ask for frames to be skipped, as many
+ * as needed to meet the target on average.
+ * Times are in micro-seconds.
+ */
+class QualityController {
+ public:
+  QualityController();
+
+  void SetTargetFrameTime(double target);   // 0 turns it off
+  double GetTargetFrameTime() const { return m_target; }
+  bool IsOn() const { return m_target>0; }
+  void Reset();
+
+  void Update(double scan_time, double track_time, double other_time);
+  bool SkipFrame();
+
+  double GetScanQuality() const { return m_scan_quality; }
+  double GetTrackQuality() const { return m_track_quality; }
+  double GetFrameTime() const { return m_frame_time; }
+
+ protected:
+  double                  m_target;
+  double                  m_frame_time;     // smoothed, -1 if none yet
+  double                  m_scan_quality;
+  double                  m_track_quality;
+  int                     m_frames_to_skip;
+};
+
+#endif // __QUALITYCONTROLLER__INCLUDED_H_
@@ -48,6 +48,8 @@ class CRect {
 
 #endif // __ATLTYPES_H__
 
+typedef vector<CRect> CRectVector;
+
 #endif // __CRECT__INCLUDED_H_
 
 
@@ -26,6 +26,7 @@
 #include "Common.h"
 #include "Skincolor.h"
 #include "skinrgb.h"
+#include "ProbDistrProvider.h"
 
 //
 // Constructor
@@ -126,3 +127,125 @@ void Skincolor::DrawOverlay(IplImage* rgbImage, int overlay_level,
   }
 }
 
+
+
+/* find connected skin-colored areas within roi on a grid of cells
+* of cell_size by cell_size pixels, which is much faster than doing
+* it pixel by pixel.  A cell counts as skin if at least half of its
+* sampled pixels are skin-colored, either according to pColor or,
+* if pColor is NULL, according to the fixed lookup table.  Cells are
+* 8-connected; the bounding boxes (in pixels) of all blobs with at 
+* least min_cells cells are returned.
+*/
+void Skincolor::FindBlobs(const IplImage* rgbImage, const CRect& roi,
+                          const ProbDistrProvider* pColor,
+                          int cell_size, int min_cells, CRectVector& blobs)
+{
+  ASSERT(rgbImage && rgbImage->imageData);
+  ASSERT(cell_size>0);
+  blobs.clear();
+
+  int start_x = max(0, roi.left);
+  int start_y = max(0, roi.top);
+  int cols = (min(rgbImage->width, roi.right)-start_x)/cell_size;
+  int rows = (min(rgbImage->height, roi.bottom)-start_y)/cell_size;
+  if (cols<=0 || rows<=0) {
+    return;
+  }
+
+  // first pass: mark skin cells and assign provisional labels,
+  // remembering which labels are connected
+  int step = max(1, cell_size/2);
+  m_cell_labels.resize(cols*rows);
+  m_label_parents.clear();
+  for (int row=0; row<rows; row++) {
+    for (int col=0; col<cols; col++) {
+      int skin = 0;
+      int samples = 0;
+      int cell_x = start_x+col*cell_size;
+      int cell_y = start_y+row*cell_size;
+      for (int y=cell_y; y<cell_y+cell_size; y+=step) {
+        const ColorBGR* prgb = (const ColorBGR*)
+          (rgbImage->imageData + y*rgbImage->widthStep) + cell_x;
+        for (int x=0; x<cell_size; x+=step) {
+          if (pColor ? pColor->LookupProb(prgb[x])>=0.5 : IsSkin_RGB(prgb[x])) {
+            skin++;
+          }
+          samples++;
+        }
+      }
+
+      int& label = m_cell_labels[row*cols+col];
+      label = -1;
+      if (2*skin<samples) {
+        continue;
+      }
+      // previously labeled neighbors: left, upper left, up, upper right
+      int neighbors[4] = {-1, -1, -1, -1};
+      if (col>0) neighbors[0] = m_cell_labels[row*cols+col-1];
+      if (row>0) {
+        if (col>0) neighbors[1] = m_cell_labels[(row-1)*cols+col-1];
+        neighbors[2] = m_cell_labels[(row-1)*cols+col];
+        if (col+1<cols) neighbors[3] = m_cell_labels[(row-1)*cols+col+1];
+      }
+      for (int n=0; n<4; n++) {
+        if (neighbors[n]==-1) continue;
+        int root = FindLabelRoot(neighbors[n]);
+        if (label==-1) {
+          label = root;
+        } else if (root!=label) {
+          // merge into the smaller label
+          int lower = min(root, label);
+          m_label_parents[max(root, label)] = lower;
+          label = lower;
+        }
+      }
+      if (label==-1) {
+        label = (int) m_label_parents.size();
+        m_label_parents.push_back(label);
+      }
+    }
+  }
+
+  // second pass: collect cell counts and bounding boxes per blob
+  int num_labels = (int) m_label_parents.size();
+  m_label_cells.resize(num_labels);
+  m_label_boxes.resize(num_labels);
+  for (int lbl=0; lbl<num_labels; lbl++) {
+    m_label_cells[lbl] = 0;
+  }
+  for (int row=0; row<rows; row++) {
+    for (int col=0; col<cols; col++) {
+      int label = m_cell_labels[row*cols+col];
+      if (label==-1) continue;
+      int root = FindLabelRoot(label);
+      int left = start_x+col*cell_size;
+      int top = start_y+row*cell_size;
+      CRect& box = m_label_boxes[root];
+      if (m_label_cells[root]==0) {
+        box = CRect(left, top, left+cell_size, top+cell_size);
+      } else {
+        box.left = min(box.left, left);
+        box.top = min(box.top, top);
+        box.right = max(box.right, left+cell_size);
+        box.bottom = max(box.bottom, top+cell_size);
+      }
+      m_label_cells[root]++;
+    }
+  }
+  for (int lbl=0; lbl<num_labels; lbl++) {
+    if (m_label_cells[lbl]>=max(1, min_cells)) {
+      blobs.push_back(m_label_boxes[lbl]);
+    }
+  }
+}
+
+int Skincolor::FindLabelRoot(int label)
+{
+  while (m_label_parents[label]!=label) {
+    // path halving
+    m_label_parents[label] = m_label_parents[m_label_parents[label]];
+    label = m_label_parents[label];
+  }
+  return label;
+}
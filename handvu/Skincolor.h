@@ -28,6 +28,7 @@
 #include "Mask.h"
 #include "Rect.h"
 
+class ProbDistrProvider;
 
 #pragma warning (disable:4786)
 class Skincolor {
@@ -41,11 +42,23 @@ class Skincolor {
                      ConstMaskIt mask, bool backproject);
   void DrawOverlay(IplImage* rgbImage, int overlay_level, 
                    const CRect& roi);
+  void FindBlobs(const IplImage* rgbImage, const CRect& roi,
+                 const ProbDistrProvider* pColor,
+                 int cell_size, int min_cells, CRectVector& blobs);
   
+ protected:
+  int FindLabelRoot(int label);
+
  protected:
   bool                   m_draw_once;
   double                 m_last_coverage;
   ConstMaskIt            m_last_mask;
+
+  // blob labeling, kept to reuse their memory
+  vector<int>            m_cell_labels;
+  vector<int>            m_label_parents;
+  vector<int>            m_label_cells;
+  CRectVector            m_label_boxes;
 };
 
 
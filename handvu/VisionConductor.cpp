@@ -25,6 +25,10 @@
 #include "VisionConductor.h"
 #include "FileHandling.h"
 #include <fstream>
+#include <map>
+#if !defined(WIN32)
+#include <pthread.h>
+#endif //WIN32
 #ifdef HAVE_FLOAT_H
 #include <float.h>
 #endif
@@ -47,6 +51,28 @@ static char THIS_FILE[] = __FILE__;
 void ReplaceAll(string& mangle, const string what, const string with);
 #endif //WIN32
 
+/////////////////////////////////////////////////////////////////////////////
+// the loaded conductors, by file name
+
+typedef map<string, VisionConductor*> ConductorMap;
+static ConductorMap g_conductors;
+
+#if defined(WIN32)
+// initialized when the library is loaded, before any thread runs
+static class ConductorsLock {
+ public:
+  ConductorsLock() { InitializeCriticalSection(&section); }
+  CRITICAL_SECTION section;
+} g_conductors_lock;
+#define LOCK_CONDUCTORS() EnterCriticalSection(&g_conductors_lock.section)
+#define UNLOCK_CONDUCTORS() LeaveCriticalSection(&g_conductors_lock.section)
+#else //WIN32
+static pthread_mutex_t g_conductors_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CONDUCTORS() pthread_mutex_lock(&g_conductors_lock)
+#define UNLOCK_CONDUCTORS() pthread_mutex_unlock(&g_conductors_lock)
+#endif //WIN32
+
+
 /////////////////////////////////////////////////////////////////////////////
 // VisionConductor
 
@@ -61,6 +87,12 @@ VisionConductor::VisionConductor()
     m_dt_cascades_end(-1),
     m_dt_min_match_duration(-1),
     m_dt_min_color_coverage(-1),
+    m_dt_mode(VC_DM_SCAN),
+    m_dt_full_scan_interval(1),
+    m_dt_order(VC_DO_RASTER),
+    m_dt_max_matches(0),
+    m_dt_mirror(false),
+    m_dt_mirrored_start(-1),
     
     // tracking
     m_tr_num_KLT_features(-1),
@@ -77,7 +109,9 @@ VisionConductor::VisionConductor()
     m_rc_cascades_end(-1),
     m_rc_max_scan_width(-1),
     m_rc_max_scan_height(-1),
-    m_rc_scale_tolerance(-1)
+    m_rc_scale_tolerance(-1),
+
+    m_refcount(0)
 {
 }
 
@@ -85,6 +119,51 @@ VisionConductor::~VisionConductor()
 {
 }
 
+/** the conductor of the file, loaded only if nobody uses it yet;
+* Release it when done.  Loading is serialized since it changes
+* the working directory.
+*/
+VisionConductor* VisionConductor::Acquire(const string& filename)
+{
+  LOCK_CONDUCTORS();
+  VisionConductor* pConductor = NULL;
+  ConductorMap::iterator found = g_conductors.find(filename);
+  if (found!=g_conductors.end()) {
+    pConductor = found->second;
+    VERBOSE1(5, "HandVu: sharing conductor %s", filename.c_str());
+  } else {
+    pConductor = new VisionConductor();
+    try {
+      pConductor->Load(filename);
+    } catch (HVException&) {
+      delete pConductor;
+      UNLOCK_CONDUCTORS();
+      throw;
+    }
+    pConductor->m_filename = filename;
+    g_conductors[filename] = pConductor;
+  }
+  pConductor->m_refcount++;
+  UNLOCK_CONDUCTORS();
+  return pConductor;
+}
+
+/** pConductor may be NULL
+*/
+void VisionConductor::Release(VisionConductor* pConductor)
+{
+  if (pConductor==NULL) {
+    return;
+  }
+  LOCK_CONDUCTORS();
+  pConductor->m_refcount--;
+  if (pConductor->m_refcount==0) {
+    g_conductors.erase(pConductor->m_filename);
+    delete pConductor;
+  }
+  UNLOCK_CONDUCTORS();
+}
+
 void VisionConductor::Load(string pathfile)
 {
   // $IT_DATA environmet variable, NULL if not set
@@ -120,7 +199,10 @@ void VisionConductor::Load(string pathfile)
   }
 
   m_masks.clear();
+  m_mirrored_masks.clear();
   m_orig_areas.clear();
+  m_cascade_files.clear();
+  m_scanner_params.clear();
 
   try {
     // the actual parsing function
@@ -138,9 +220,45 @@ void VisionConductor::Load(string pathfile)
     SetCWD(old_cwd);
   }
 
+  m_is_loaded = true;
+}
+
+/** loads the cascades into the current cubicles context, replacing
+* any that it has, and sets up their scanners.  Every HandVu
+* instance calls this for its own context; the cascade files are
+* parsed only by the first one.
+*/
+void VisionConductor::LoadCascades() const
+{
+  cuReleaseCascades();
+  for (int fcnt=0; fcnt<m_dt_mirrored_start; fcnt++) {
+    LoadCascade(fcnt);
+  }
+  // mirrored copies go right after the detection cascades, so that
+  // they are detection cascades as well, for example for left hands
+  if (m_dt_mirror) {
+    for (int cc=m_dt_cascades_start; cc<m_dt_mirrored_start; cc++) {
+      CuCascadeID mirroredID;
+      cuLoadMirroredCascade((CuCascadeID)cc, &mirroredID);
+      ASSERT((int)mirroredID==m_dt_mirrored_start+cc-m_dt_cascades_start);
+    }
+  }
+  for (int fcnt=m_dt_mirrored_start; fcnt<(int)m_cascade_files.size(); fcnt++) {
+    LoadCascade(fcnt);
+  }
+  for (int cc=m_dt_cascades_start; cc<m_dt_cascades_end; cc++) {
+    cuSetScanOrder((CuCascadeID)cc, (CuScanOrder)m_dt_order, 
+                   m_dt_max_matches);
+  }
+
   SanityCheckMasks();
+}
 
-  m_is_loaded = true;
+void VisionConductor::LoadCascade(int file) const
+{
+  CuCascadeID cascadeID;
+  cuLoadCascade(m_cascade_files[file], &cascadeID);
+  cuSetScannerParameters(cascadeID, m_scanner_params[file]);
 }
 
 
@@ -244,10 +362,66 @@ void VisionConductor::ParseFromFile(const string& filename)
     }
     m_dt_radius = radius;
 
-    // tracking parameters
+    // detection mode and order, optional
     do {
       getline(file, line);
     } while (line=="" || line[0]=='#');
+    m_dt_mode = VC_DM_SCAN;
+    m_dt_full_scan_interval = 1;
+    m_dt_order = VC_DO_RASTER;
+    m_dt_max_matches = 0;
+    m_dt_mirror = false;
+    for (;;) {
+      if (line.find("detection mode: ")==0) {
+        string mode = line.substr(strlen("detection mode: "));
+        if (mode=="scan") {
+          m_dt_mode = VC_DM_SCAN;
+        } else {
+          scanned = sscanf(mode.c_str(), "skin_blobs, full_scan_every %d",
+                           &m_dt_full_scan_interval);
+          if (scanned!=1 || m_dt_full_scan_interval<1) {
+            throw HVEFile(filename, string("wrong detection mode: ")+mode);
+          }
+          m_dt_mode = VC_DM_SKIN_BLOBS;
+        }
+      } else if (line.find("detection order: ")==0) {
+        string order = line.substr(strlen("detection order: "));
+        string::size_type comma = order.find(',');
+        string name = order.substr(0, comma);
+        if (name=="raster") {
+          m_dt_order = VC_DO_RASTER;
+        } else if (name=="center_out") {
+          m_dt_order = VC_DO_CENTER_OUT;
+        } else if (name=="prior") {
+          m_dt_order = VC_DO_PRIOR;
+        } else {
+          throw HVEFile(filename, string("wrong detection order: ")+order);
+        }
+        if (comma!=string::npos) {
+          scanned = sscanf(order.c_str()+comma, ", max_matches %d",
+                           &m_dt_max_matches);
+          if (scanned!=1 || m_dt_max_matches<0) {
+            throw HVEFile(filename, string("wrong detection order: ")+order);
+          }
+        }
+      } else if (line.find("detection mirror: ")==0) {
+        string mirror = line.substr(strlen("detection mirror: "));
+        if (mirror=="yes") {
+          m_dt_mirror = true;
+        } else if (mirror=="no") {
+          m_dt_mirror = false;
+        } else {
+          throw HVEFile(filename, string("wrong detection mirror: ")+mirror);
+        }
+      } else {
+        break;
+      }
+      do {
+        getline(file, line);
+      } while (line=="" || line[0]=='#');
+    }
+
+    // tracking parameters
     float min_dist;
     float max_err;
     scanned = sscanf(line.c_str(), "tracking params: num_f %d, min_f %d, win_w %d, win_h %d, min_dist %f, max_err %f",
@@ -310,6 +484,16 @@ void VisionConductor::ParseFromFile(const string& filename)
     m_dt_cascades_start = 0;
     num = ReadScannerData(file, filename, "detection");
     m_dt_cascades_end = m_dt_cascades_start+num;
+    // mirrored copies go right after the detection cascades, so that
+    // they are detection cascades as well, for example for left hands
+    m_dt_mirrored_start = m_dt_cascades_end;
+    if (m_dt_mirror) {
+      for (int cc=m_dt_cascades_start; cc<m_dt_mirrored_start; cc++) {
+        CQuadruple orig_area = m_orig_areas[cc];
+        m_orig_areas.push_back(orig_area);
+        m_dt_cascades_end++;
+      }
+    }
 
     // tracking cascades
     m_tr_cascades_start = m_dt_cascades_end;
@@ -353,6 +537,10 @@ void VisionConductor::ParseFromFile(const string& filename)
         throw HVException(string("mask '")+mask.GetName()+string("' exists already!"));
       }
       m_masks[mask.GetName()] = mask;
+      if (m_dt_mirror) {
+        mask.Mirror();
+        m_mirrored_masks[mask.GetName()] = mask;
+      }
     }
 
   } else {
@@ -360,7 +548,7 @@ void VisionConductor::ParseFromFile(const string& filename)
   }
 }
 
-void VisionConductor::SanityCheckMasks()
+void VisionConductor::SanityCheckMasks() const
 {
   for (int cc=0; cc<m_rc_cascades_end; cc++) {
     CuCascadeProperties cp;
@@ -388,9 +576,9 @@ void VisionConductor::SanityCheckMasks()
   }
 }
 
-/* reads file names C and M and settings from the file, then
-* loads cascade and mask from the file corresponding to C and M;
-* adds the results to m_cascades and m_masks
+/* reads the cascade file names and scanner settings of one type
+* from the file; adds the full paths and the settings to
+* m_cascade_files and m_scanner_params
 */
 int VisionConductor::ReadScannerData(ifstream& file, const string filename, const string type) 
 {
@@ -415,7 +603,6 @@ int VisionConductor::ReadScannerData(ifstream& file, const string filename, cons
                   +type+string(" cascades, found: ")+line);
   }
   for (int cs=0; cs<num; cs++) {
-    CuCascadeID cascadeID;
     //
     // load cascade
     //
@@ -435,7 +622,8 @@ int VisionConductor::ReadScannerData(ifstream& file, const string filename, cons
         ReplaceAll(cascade_filename, "$IT_DATA", std_it_data);
       }
 
-      cuLoadCascade(ConvertPathToWindows(cascade_filename).c_str(), &cascadeID);
+      // LoadCascades runs in another working directory
+      m_cascade_files.push_back(GetFullPath(ConvertPathToWindows(cascade_filename)));
     }
 
     //
@@ -491,7 +679,7 @@ int VisionConductor::ReadScannerData(ifstream& file, const string filename, cons
       sp.translation_inc_x = translation_inc_x;
       sp.translation_inc_y = translation_inc_y;
       sp.post_process = (post_process==1);
-      cuSetScannerParameters(cascadeID, sp);
+      m_scanner_params.push_back(sp);
     }
   }
   return num;
@@ -511,6 +699,21 @@ ConstMaskIt VisionConductor::GetMask(const string& name) const
   }
   return it;
 }
+
+/** the mask for matches of the given cascade, mirrored if the
+* cascade is a mirrored copy
+*/
+ConstMaskIt VisionConductor::GetMask(const string& name, int cascadeID) const
+{
+  if (cascadeID<m_dt_mirrored_start || m_dt_cascades_end<=cascadeID) {
+    return GetMask(name);
+  }
+  ConstMaskIt it = m_mirrored_masks.find(name);
+  if (it==m_mirrored_masks.end()) {
+    throw HVException(string("no mirrored mask for name ")+name);
+  }
+  return it;
+}
 #pragma warning (default:4786)
 
 
@@ -35,6 +35,12 @@ using namespace std;
 #include "Mask.h"
 #include "Quadruple.h"
 
+/* the models of a conductor file: the cascades' files and scanner
+ * parameters, the masks, and the settings of detection, tracking and
+ * recognition.  It is loaded only once, however many HandVu
+ * instances use it, and does not change after that; each instance
+ * loads the cascades into its own cubicles context with LoadCascades.
+ */
 class VisionConductor 
 {
  public:
@@ -44,9 +50,13 @@ class VisionConductor
 public:
   // Operations
  public:
+  static VisionConductor* Acquire(const string& filename);
+  static void Release(VisionConductor* pConductor);
   void Load(string filename);
+  void LoadCascades() const;
   bool IsLoaded() const;
   ConstMaskIt GetMask(const string& name) const;
+  ConstMaskIt GetMask(const string& name, int cascadeID) const;
 
  protected:
 #pragma warning (disable: 4786)
@@ -54,7 +64,8 @@ public:
   int ReadScannerData(ifstream& file, const string filename, const string type);
 #pragma warning (default: 4786)
   void LoadMask();
-  void SanityCheckMasks();
+  void LoadCascade(int file) const;
+  void SanityCheckMasks() const;
 
 public:
   enum TrackingType {
@@ -68,11 +79,25 @@ public:
     VC_TT_CAMSHIFT = VC_TT_CAMSHIFT_HSV|VC_TT_CAMSHIFT_LEARNED,
     VC_TT_OPTICAL_FLOW = VC_TT_OPTICAL_FLOW_ONLY|VC_TT_OPTICAL_FLOW_FLOCK|VC_TT_OPTICAL_FLOW_COLORFLOCK
   };
+  enum DetectionMode {
+    VC_DM_SCAN = 0,         // scan the entire detection area
+    VC_DM_SKIN_BLOBS = 1    // scan only around skin-colored blobs
+  };
+  enum DetectionOrder {     // same values as CuScanOrder
+    VC_DO_RASTER = 0,
+    VC_DO_CENTER_OUT = 1,
+    VC_DO_PRIOR = 2         // where hands were detected before first
+  };
 
  protected:
   // general
   CQuadrupleVector        m_orig_areas;
+  // absolute, and the parameters of their scanners, in the order of
+  // the cascade IDs but without the mirrored copies
+  vector<string>          m_cascade_files;
+  vector<CuScannerParameters> m_scanner_params;
   MaskMap                 m_masks;
+  MaskMap                 m_mirrored_masks;
   bool                    m_is_loaded;
   string                  m_camera_calib;
   bool                    m_adjust_exposure;
@@ -83,6 +108,12 @@ public:
   long                    m_dt_min_match_duration;
   double                  m_dt_radius;
   double                  m_dt_min_color_coverage;
+  DetectionMode           m_dt_mode;
+  int                     m_dt_full_scan_interval; // frames, for VC_DM_SKIN_BLOBS
+  DetectionOrder          m_dt_order;
+  int                     m_dt_max_matches; // per cascade and scan, 0: all
+  bool                    m_dt_mirror;   // also detect mirror images
+  int                     m_dt_mirrored_start; // first mirrored cascade
 
   // tracking
   int                     m_tr_cascades_start;
@@ -102,6 +133,10 @@ public:
   double                  m_rc_max_scan_height;
   double                  m_rc_scale_tolerance;
 
+  // sharing, see Acquire
+  string                  m_filename;
+  int                     m_refcount;
+
  public:
   friend class HandVu;
 };
@@ -35,6 +35,7 @@
 
 
 IplImage *capture_image = 0;
+RefTime capture_time = 0;
 IplImage *display_image = 0;
 
 bool async_processing = false;
@@ -173,6 +174,7 @@ int main( int argc, char** argv )
   /* allocate all the buffers */
   CvSize size = cvGetSize(capture_image);
   hvInitialize(size.width, size.height);
+  capture_time = hvGetCurrentTime();
   hvLoadConductor(conductor_fname);
   hvStartRecognition();
   hvSetOverlayLevel(2);
@@ -200,7 +202,7 @@ int main( int argc, char** argv )
       // ------- main library call ---------
       hvAsyncGetImageBuffer(&m_async_image, &m_async_bufID);
       cvCopy(capture_image, m_async_image);
-      hvAsyncProcessFrame(m_async_bufID);
+      hvAsyncProcessFrame(m_async_bufID, capture_time);
       // -------
       
     } else {
@@ -208,7 +210,7 @@ int main( int argc, char** argv )
       
       // ------- main library call ---------
       hvAction action = HV_INVALID_ACTION;
-      action = hvProcessFrame(capture_image);
+      action = hvProcessFrame(capture_image, NULL, capture_time);
       // -------
       
       showFrame(capture_image, action);
@@ -248,6 +250,7 @@ int main( int argc, char** argv )
     
     // capture next image
     capture_image = cvQueryFrame( capture );
+    capture_time = hvGetCurrentTime();
     if ( !capture_image ) {
       fprintf(stderr,"Could not retrieve image through OpenCV.\n");
       break;
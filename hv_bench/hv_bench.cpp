@@ -0,0 +1,350 @@
+/**
+* HandVu - a library for computer vision-based hand gesture
+* recognition.
+* Copyright (C) 2004 Mathias Kolsch, matz@cs.ucsb.edu
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330,
+* Boston, MA  02111-1307, USA.
+*
+* $Id$
+**/
+
+/* hv_bench: replays recorded frames through HandVu without a camera
+ * or a window, on the recorded capture times, and reports the stage
+ * times, the frame rate and the gesture events.  The events depend
+ * only on the frames and their times, not on how fast they were
+ * processed, so that the event output of a recording can be kept as
+ * the expected output and compared against.  On the recorded times,
+ * no time passes while a frame is processed, hence no frames are
+ * skipped for being late and the latency is 0.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <cv.h>
+#include <highgui.h>
+
+#include "HandVu.h"
+
+
+string conductor_fname;
+string frames_name;         // video file, or printf pattern of images
+string times_fname;         // capture times in micro-seconds, one per line
+string events_fname;        // stdout if empty
+double fps = 30;            // if there is no times file
+int max_frames = -1;
+int num_objects = 1;
+int overlay_level = 0;
+bool realtime = false;
+
+CvCapture* capture = NULL;
+FILE* times_file = NULL;
+FILE* events_file = NULL;
+
+
+static struct option long_options[] = {
+  {"times", 1, NULL, 0},
+  {"fps", 1, NULL, 0},
+  {"frames", 1, NULL, 0},
+  {"objects", 1, NULL, 0},
+  {"overlay", 1, NULL, 0},
+  {"events", 1, NULL, 0},
+  {"realtime", 0, NULL, 0},
+  {"help", 0, NULL, 0},
+  {NULL, 0, 0, 0}
+};
+
+void usage(const char* name)
+{
+  printf("\n"
+         "        %s - replays recorded frames through HandVu\n\n"
+         "Usage:\n"
+         "        %s [options] conductor frames\n"
+         "             frames     - a video file, or the printf pattern of\n"
+         "                          numbered images, e.g. rec/%%05d.ppm\n"
+         "             --times    - file with the capture time of each frame\n"
+         "                          in micro-seconds, one per line\n"
+         "             --fps      - frame rate if there are no times,\n"
+         "                          default=30\n"
+         "             --frames   - replay at most this many frames\n"
+         "             --objects  - recognize this many objects, default=1\n"
+         "             --overlay  - overlay level, default=0\n"
+         "             --events   - write the events to this file rather\n"
+         "                          than to stdout\n"
+         "             --realtime - replay at the recorded pace rather than\n"
+         "                          as fast as possible\n"
+         "             --help     - prints this message\n\n"
+         "The events go to stdout, the report to stderr.\n", name, name);
+}
+
+void get_options(int argc, char *argv[])
+{
+  int option_index = 0;
+
+  while (getopt_long(argc, argv, "", long_options, &option_index) >= 0) {
+    if (optarg) {
+      switch (option_index) {
+        /* case values must match long_options */
+      case 0:
+        times_fname = optarg;
+        break;
+      case 1:
+        fps = atof(optarg);
+        break;
+      case 2:
+        max_frames = atoi(optarg);
+        break;
+      case 3:
+        num_objects = atoi(optarg);
+        break;
+      case 4:
+        overlay_level = atoi(optarg);
+        break;
+      case 5:
+        events_fname = optarg;
+        break;
+      }
+    }
+    if (option_index == 6) {
+      realtime = true;
+    }
+    if (option_index == 7) {
+      usage(argv[0]);
+      exit(0);
+    }
+  }
+  if (argc-optind!=2) {
+    usage(argv[0]);
+    exit(-1);
+  }
+  conductor_fname = argv[optind];
+  frames_name = argv[optind+1];
+}
+
+
+/* wall time for the pacing and the frame rate
+*/
+RefTime wall_time()
+{
+  return (RefTime) (cvGetTickCount()/cvGetTickFrequency());
+}
+
+void sleep_usec(RefTime usec)
+{
+  if (usec>0) {
+    usleep((useconds_t) usec);
+  }
+}
+
+
+/* the next frame and its capture time, NULL after the last one; the
+* image belongs to the capture or must be released by the caller
+*/
+IplImage* next_frame(int frame, RefTime& capture_time, bool& must_release)
+{
+  if (max_frames>=0 && frame>=max_frames) {
+    return NULL;
+  }
+
+  IplImage* img = NULL;
+  must_release = false;
+  if (capture) {
+    img = cvQueryFrame(capture);
+  } else {
+    char fname[1024];
+    snprintf(fname, sizeof(fname), frames_name.c_str(), frame);
+    img = cvLoadImage(fname, 1);
+    must_release = true;
+  }
+  if (!img) {
+    return NULL;
+  }
+
+  if (times_file) {
+    long long t;
+    if (fscanf(times_file, "%lld", &t)!=1) {
+      fprintf(stderr, "no capture time for frame %d in %s\n",
+              frame, times_fname.c_str());
+      if (must_release) {
+        cvReleaseImage(&img);
+      }
+      return NULL;
+    }
+    capture_time = (RefTime) t;
+  } else {
+    capture_time = (RefTime) (frame*1000000.0/fps);
+  }
+  return img;
+}
+
+
+/* one line per object and frame while the object is tracked, and one
+* when it changes otherwise
+*/
+class ObjectEvents {
+ public:
+  ObjectEvents() : written(false), tracked(false), recognized(false) {}
+  bool written, tracked, recognized;
+  string posture;
+};
+ObjectEvents last_events[HV_MAX_OBJECTS];
+
+void write_events(int frame)
+{
+  for (int obj=0; obj<num_objects; obj++) {
+    hvState state;
+    hvGetState(obj, state);
+    ObjectEvents& last = last_events[obj];
+    if (!state.tracked && last.written && !last.tracked
+        && state.recognized==last.recognized && state.posture==last.posture) {
+      continue;
+    }
+    fprintf(events_file, "%d %lld %d: %d, %d, \"%s\" (%f, %f) [%f]\n",
+            frame, (long long) state.tstamp, state.obj_id,
+            (int) state.tracked, (int) state.recognized,
+            state.posture.c_str(), (float) state.center_xpos,
+            (float) state.center_ypos, (float) state.scale);
+    last.written = true;
+    last.tracked = state.tracked;
+    last.recognized = state.recognized;
+    last.posture = state.posture;
+  }
+}
+
+
+void write_report(int num_frames, RefTime wall_usec)
+{
+  hvMetrics metrics;
+  hvGetMetrics(metrics);
+
+  fprintf(stderr, "%d frames in %.3fs: %.1f fps\n", num_frames,
+          wall_usec/1000000.0,
+          wall_usec>0 ? num_frames*1000000.0/wall_usec : 0.0);
+  fprintf(stderr, "processed %d, skipped %d, dropped %d\n",
+          metrics.frames_processed, metrics.frames_skipped,
+          metrics.frames_dropped);
+
+  // hvStage order
+  const char* stage_names[HV_NUM_STAGES] = {
+    "convert", "track", "detect", "recognize", "color_learning",
+    "overlay", "send", "frame", "latency"
+  };
+  fprintf(stderr, "%-16s %8s %9s %9s %9s %9s %9s\n", "stage (ms)",
+          "count", "mean", "p50", "p95", "p99", "max");
+  for (int s=0; s<HV_NUM_STAGES; s++) {
+    const hvStageMetrics& stage = metrics.stages[s];
+    fprintf(stderr, "%-16s %8d %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+            stage_names[s], stage.count, stage.mean/1000.0,
+            stage.p50/1000.0, stage.p95/1000.0, stage.p99/1000.0,
+            stage.max/1000.0);
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  get_options(argc, argv);
+  if (num_objects<1 || num_objects>HV_MAX_OBJECTS) {
+    fprintf(stderr, "--objects must be from 1 to %d\n", HV_MAX_OBJECTS);
+    return -1;
+  }
+  if (fps<=0) {
+    fprintf(stderr, "--fps must be positive\n");
+    return -1;
+  }
+
+  if (frames_name.find('%')==string::npos) {
+    capture = cvCaptureFromAVI(frames_name.c_str());
+    if (!capture) {
+      fprintf(stderr, "Could not open %s through OpenCV.\n",
+              frames_name.c_str());
+      return -1;
+    }
+  }
+  if (!times_fname.empty()) {
+    times_file = fopen(times_fname.c_str(), "r");
+    if (!times_file) {
+      fprintf(stderr, "Could not open %s.\n", times_fname.c_str());
+      return -1;
+    }
+  }
+  events_file = stdout;
+  if (!events_fname.empty()) {
+    events_file = fopen(events_fname.c_str(), "w");
+    if (!events_file) {
+      fprintf(stderr, "Could not open %s.\n", events_fname.c_str());
+      return -1;
+    }
+  }
+
+  RefTime capture_time = 0;
+  bool must_release = false;
+  IplImage* img = next_frame(0, capture_time, must_release);
+  if (!img) {
+    fprintf(stderr, "Could not read the first frame of %s.\n",
+            frames_name.c_str());
+    return -1;
+  }
+
+  // HandVu's clock stands at the capture time of the current frame
+  CvSize size = cvGetSize(img);
+  hvInitialize(size.width, size.height);
+  hvSetReplayTime(capture_time);
+  hvLoadConductor(conductor_fname);
+  for (int obj=0; obj<num_objects; obj++) {
+    hvStartRecognition(obj);
+  }
+  hvSetOverlayLevel(overlay_level);
+  hvResetMetrics();
+
+  RefTime first_capture_time = capture_time;
+  RefTime wall_start = wall_time();
+  int frame = 0;
+  while (img) {
+    if (realtime) {
+      RefTime due = wall_start + (capture_time-first_capture_time);
+      sleep_usec(due-wall_time());
+    }
+
+    hvSetReplayTime(capture_time);
+    hvProcessFrame(img, NULL, capture_time);
+    write_events(frame);
+
+    if (must_release) {
+      cvReleaseImage(&img);
+    }
+    frame++;
+    img = next_frame(frame, capture_time, must_release);
+  }
+  RefTime wall_usec = wall_time()-wall_start;
+
+  write_report(frame, wall_usec);
+
+  hvUninitialize();
+  if (capture) {
+    cvReleaseCapture(&capture);
+  }
+  if (times_file) {
+    fclose(times_file);
+  }
+  if (events_file!=stdout) {
+    fclose(events_file);
+  }
+
+  return 0;
+}
@@ -96,6 +96,7 @@ GC                        gc;
 /* declarations for OpenCV and HandVu */
 IplImage                 *iplImages[MAX_CAMERAS];
 IplImage                 *readOnlyImg = NULL;
+RefTime                   capture_time = 0;
 char* conductor_fname = "../config/default.conductor";
 
 bool async_processing = false;
@@ -268,6 +269,7 @@ capture_frame()
   static int                have_warned = 0;
 
   dc1394_dma_multi_capture(cameras, numCameras);
+  capture_time = hvGetCurrentTime();
 
   if (!freeze && adaptor >= 0) {
     for (int i = 0; i < numCameras; i++) {
@@ -338,9 +340,9 @@ void process_frame()
   if (!freeze && adaptor >= 0) {
     // main HandVu call
     if (async_processing) {
-      hvAsyncProcessFrame(m_async_bufID);
+      hvAsyncProcessFrame(m_async_bufID, capture_time);
     } else {
-      hvProcessFrame(iplImages[0], iplImages[1]);
+      hvProcessFrame(iplImages[0], iplImages[1], capture_time);
     }
   }
 }